@@ -0,0 +1,216 @@
+#include "adv_broadcast.h"
+
+#include <string.h>
+
+#include "adv_payload.h"
+#include "app_error.h"
+#include "app_timer.h"
+#include "nordic_common.h"
+#include "nrf_log.h"
+#include "timestamp.h"
+#include "variables.h"
+
+APP_TIMER_DEF(m_rotate_timer);
+
+static store_history m_recent[ADV_BROADCAST_MAX_RECORDS]; // El mas nuevo primero
+static uint8_t       m_count   = 0;
+static uint8_t       m_records = 0;     // Pedidos por el comando 28
+static bool          m_running = false; // Advertising encendido
+
+// Rotacion: paso 0 la trama de estado, luego dos partes por historial
+static uint8_t       m_step    = 0;
+static uint8_t       m_seq     = 0;
+static volatile bool m_advance = false;
+
+static void put_u16(uint8_t *p_buf, uint16_t value)
+{
+    p_buf[0] = MSB_16(value);
+    p_buf[1] = LSB_16(value);
+}
+
+static void put_u32(uint8_t *p_buf, uint32_t value)
+{
+    p_buf[0] = (value >> 24) & 0xFF;
+    p_buf[1] = (value >> 16) & 0xFF;
+    p_buf[2] = (value >> 8) & 0xFF;
+    p_buf[3] = (value & 0xFF);
+}
+
+static uint8_t broadcast_count(void)
+{
+    return MIN(m_records, m_count);
+}
+
+static void rotate_timer_handler(void *p_context)
+{
+    UNUSED_PARAMETER(p_context);
+
+    // El paso se avanza al armar la trama, en el lazo principal
+    m_advance = true;
+    adv_payload_changed();
+}
+
+static void timer_update(void)
+{
+    ret_code_t err_code;
+
+    (void)app_timer_stop(m_rotate_timer);
+    if (!m_running || m_records == 0)
+    {
+        return;
+    }
+    err_code = app_timer_start(m_rotate_timer, APP_TIMER_TICKS(ADV_BROADCAST_ROTATE_MS), NULL);
+    APP_ERROR_CHECK(err_code);
+}
+
+void adv_broadcast_init(void)
+{
+    ret_code_t err_code = app_timer_create(&m_rotate_timer,
+                                           APP_TIMER_MODE_REPEATED,
+                                           rotate_timer_handler);
+    APP_ERROR_CHECK(err_code);
+
+    // La rotacion arranca con el advertising (BLE_ADV_EVT_FAST)
+    m_running = false;
+    m_records = 0;
+    adv_broadcast_set(ADV_BROADCAST_DEFAULT_RECORDS);
+}
+
+void adv_broadcast_set(uint8_t records)
+{
+    records = MIN(records, ADV_BROADCAST_MAX_RECORDS);
+    if (records > 0 && m_records == 0)
+    {
+        // Mientras esta apagado no se siguen los historiales nuevos
+        m_count = history_read_latest(m_recent, ADV_BROADCAST_MAX_RECORDS);
+    }
+    m_records = records;
+    m_step    = 0;
+    m_advance = false;
+    timer_update();
+
+    NRF_LOG_RAW_INFO(LOG_INFO " Difusion por advertising: %u historiales (%u en memoria)",
+                     m_records,
+                     m_count);
+    adv_payload_changed();
+}
+
+uint8_t adv_broadcast_get(void)
+{
+    return m_records;
+}
+
+void adv_broadcast_resume(void)
+{
+    if (!m_running)
+    {
+        m_running = true;
+        timer_update();
+    }
+}
+
+void adv_broadcast_pause(void)
+{
+    // Al volver a encender se empieza por la trama de estado
+    m_running = false;
+    m_step    = 0;
+    m_advance = false;
+    timer_update();
+}
+
+bool adv_broadcast_frame(uint8_t *p_buf)
+{
+    uint8_t              count = broadcast_count();
+    uint8_t              steps = 1 + 2 * count;
+    uint8_t              slot;
+    uint8_t              part;
+    store_history const *p_record;
+
+    if (m_advance)
+    {
+        m_advance = false;
+        m_step    = (m_step + 1) % steps;
+        if (m_step != 0)
+        {
+            m_seq++;
+        }
+    }
+    if (m_step >= steps)
+    {
+        m_step = 0;
+    }
+    if (m_step == 0)
+    {
+        return false;
+    }
+
+    slot     = (m_step - 1) / 2;
+    part     = (m_step - 1) % 2;
+    p_record = &m_recent[slot];
+
+    memset(p_buf, 0xAB, ADV_PAYLOAD_SIZE);
+    p_buf[0] = ADV_BROADCAST_FRAME_TAG;
+    p_buf[1] = m_seq;
+    p_buf[2] = (part ? ADV_BROADCAST_PART_BIT : 0) |
+               ((slot << ADV_BROADCAST_SLOT_SHIFT) & ADV_BROADCAST_SLOT_MASK) |
+               (count & ADV_BROADCAST_COUNT_MASK);
+    put_u32(&p_buf[3], p_record->timestamp);
+    if (part == 0)
+    {
+        put_u32(&p_buf[7], p_record->contador);
+        put_u16(&p_buf[11], p_record->V1);
+        put_u16(&p_buf[13], p_record->V2);
+        put_u16(&p_buf[15], p_record->V3);
+        put_u16(&p_buf[17], p_record->V4);
+        p_buf[19] = p_record->temp;
+        p_buf[20] = p_record->battery;
+    }
+    else
+    {
+        put_u16(&p_buf[7], p_record->V5);
+        put_u16(&p_buf[9], p_record->V6);
+        put_u16(&p_buf[11], p_record->V7);
+        put_u16(&p_buf[13], p_record->V8);
+    }
+    return true;
+}
+
+void adv_broadcast_on_history(store_history const *p_record)
+{
+    uint8_t pos;
+
+    if (p_record == NULL)
+    {
+        m_count = 0;
+        m_step  = 0;
+        return;
+    }
+    if (m_records == 0 || p_record->timestamp == TIMESTAMP_INVALID)
+    {
+        return;
+    }
+
+    // Ordenados por fecha; una actualizacion reemplaza al de la misma fecha
+    for (pos = 0; pos < m_count; pos++)
+    {
+        if (m_recent[pos].timestamp == p_record->timestamp)
+        {
+            m_recent[pos] = *p_record;
+            return;
+        }
+        if (m_recent[pos].timestamp < p_record->timestamp)
+        {
+            break;
+        }
+    }
+    if (pos >= ADV_BROADCAST_MAX_RECORDS)
+    {
+        return;
+    }
+    if (m_count < ADV_BROADCAST_MAX_RECORDS)
+    {
+        m_count++;
+    }
+    memmove(&m_recent[pos + 1], &m_recent[pos], (m_count - 1 - pos) * sizeof(store_history));
+    m_recent[pos] = *p_record;
+}
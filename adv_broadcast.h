@@ -0,0 +1,66 @@
+#ifndef ADV_BROADCAST_H
+#define ADV_BROADCAST_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "filesystem.h"
+
+// Difusion de historiales por advertising, sin conexion (comando 28).
+//
+// Con el modo activo, el campo del fabricante (adv_payload.h) rota cada
+// ADV_BROADCAST_ROTATE_MS entre la trama de estado (0x30) y los N
+// historiales mas recientes del emisor principal. Un historial no entra en
+// los 24 bytes del campo, asi que cada uno va en dos partes:
+//
+//   [0]      0xB8
+//   [1]      seq: sube con cada trama de historial
+//   [2]      bit 7 parte, bits 6..4 posicion (0 = el mas reciente),
+//            bits 3..0 N
+//   [3..6]   Fecha, segundos desde 2000 (une las dos partes)
+//   parte 0: [7..10] contador, [11..18] V1..V4, [19] temp, [20] bateria
+//   parte 1: [7..14] V5..V8
+//   resto:   0xAB
+//
+// Multibyte en big-endian. Un celular que escanea en modo pasivo junta los
+// historiales sin conectarse; tools/adv_broadcast_decoder.c es el
+// decodificador de referencia. La rotacion solo corre con el advertising
+// encendido y el modo vuelve a ADV_BROADCAST_DEFAULT_RECORDS al reiniciar.
+
+#define ADV_BROADCAST_FRAME_TAG        0xB8
+#define ADV_BROADCAST_MAX_RECORDS      8
+#define ADV_BROADCAST_ROTATE_MS        1000
+
+#ifndef ADV_BROADCAST_DEFAULT_RECORDS
+#define ADV_BROADCAST_DEFAULT_RECORDS  0 // Apagado
+#endif
+
+#define ADV_BROADCAST_PART_BIT         0x80
+#define ADV_BROADCAST_SLOT_SHIFT       4
+#define ADV_BROADCAST_SLOT_MASK        0x70
+#define ADV_BROADCAST_COUNT_MASK       0x0F
+
+/**@brief Llamar despues de fds_initialize() y antes de adv_payload_init(). */
+void    adv_broadcast_init(void);
+
+/**@brief Cantidad de historiales a difundir; 0 apaga el modo. */
+void    adv_broadcast_set(uint8_t records);
+uint8_t adv_broadcast_get(void);
+
+/**@brief Rotacion mientras el advertising esta encendido (eventos de
+ *        ble_advertising, conexion del celular y advertising_stop()).
+ */
+void    adv_broadcast_resume(void);
+void    adv_broadcast_pause(void);
+
+/**@brief Arma la trama del paso actual de la rotacion en @p p_buf
+ *        (ADV_PAYLOAD_SIZE bytes).
+ *
+ * @return false si toca la trama de estado o el modo esta apagado.
+ */
+bool    adv_broadcast_frame(uint8_t *p_buf);
+
+/**@brief Historial del emisor principal guardado. NULL: se borraron todos. */
+void    adv_broadcast_on_history(store_history const *p_record);
+
+#endif // ADV_BROADCAST_H
@@ -0,0 +1,150 @@
+#include "adv_payload.h"
+
+#include <string.h>
+
+#include "adv_broadcast.h"
+#include "app_nus_server.h"
+#include "app_scheduler.h"
+#include "app_util_platform.h"
+#include "ble_gap.h"
+#include "nordic_common.h"
+#include "nrf_log.h"
+#include "timestamp.h"
+#include "variables.h"
+
+#define BATTERY_UNKNOWN  0xFF
+
+static uint8_t       m_buf[2][ADV_PAYLOAD_SIZE];
+static uint8_t       m_active         = 0;
+static bool          m_pending        = false;
+
+static uint32_t      m_last_timestamp = TIMESTAMP_INVALID;
+static uint8_t       m_last_battery   = BATTERY_UNKNOWN;
+
+static void put_u16(uint8_t *p_buf, uint16_t value)
+{
+    p_buf[0] = MSB_16(value);
+    p_buf[1] = LSB_16(value);
+}
+
+static void put_u32(uint8_t *p_buf, uint32_t value)
+{
+    p_buf[0] = (value >> 24) & 0xFF;
+    p_buf[1] = (value >> 16) & 0xFF;
+    p_buf[2] = (value >> 8) & 0xFF;
+    p_buf[3] = (value & 0xFF);
+}
+
+static void build(uint8_t *p_buf)
+{
+    uint8_t links = 0;
+
+    // Con la difusion de historiales activa, algunos pasos de la rotacion
+    // llevan un historial en lugar del estado
+    if (adv_broadcast_frame(p_buf))
+    {
+        return;
+    }
+
+    if (get_conn_handle() != BLE_CONN_HANDLE_INVALID)
+    {
+        links |= ADV_PAYLOAD_LINK_PHONE;
+    }
+    if (get_emisor_conn_handle() != BLE_CONN_HANDLE_INVALID)
+    {
+        links |= ADV_PAYLOAD_LINK_EMISOR;
+    }
+
+    memset(p_buf, 0xAB, ADV_PAYLOAD_SIZE);
+    // Un primer byte mayor a 0 para que la app lo procese
+    p_buf[0] = 0x30;
+    put_u16(&p_buf[1], (uint16_t)adc_values.contador);
+    put_u16(&p_buf[3], adc_values.V1);
+    put_u16(&p_buf[5], adc_values.V2);
+    put_u16(&p_buf[7], config_repeater.cantidad_historiales);
+    put_u32(&p_buf[9], m_last_timestamp);
+    p_buf[13] = m_last_battery;
+    p_buf[14] = links;
+    p_buf[ADV_PAYLOAD_SIZE - 1] = 0xFF;
+}
+
+static void sched_evt_handler(void *p_event_data, uint16_t event_size)
+{
+    UNUSED_PARAMETER(p_event_data);
+    UNUSED_PARAMETER(event_size);
+
+    m_pending = false;
+    (void)adv_payload_update();
+}
+
+void adv_payload_init(void)
+{
+    store_history record;
+
+    m_last_timestamp = TIMESTAMP_INVALID;
+    m_last_battery   = BATTERY_UNKNOWN;
+    if (history_read_latest(&record, 1) == 1)
+    {
+        m_last_timestamp = record.timestamp;
+        m_last_battery   = record.battery;
+    }
+
+    m_active = 0;
+    build(m_buf[m_active]);
+}
+
+uint8_t const *adv_payload_get(void)
+{
+    return m_buf[m_active];
+}
+
+bool adv_payload_update(void)
+{
+    uint8_t next = m_active ^ 1;
+
+    build(m_buf[next]);
+    if (memcmp(m_buf[next], m_buf[m_active], ADV_PAYLOAD_SIZE) == 0)
+    {
+        return false;
+    }
+
+    // El vigente queda intacto hasta que la SoftDevice tiene el nuevo
+    m_active = next;
+    advertising_payload_set(m_buf[m_active], ADV_PAYLOAD_SIZE);
+    return true;
+}
+
+void adv_payload_changed(void)
+{
+    bool post;
+
+    CRITICAL_REGION_ENTER();
+    post      = !m_pending;
+    m_pending = true;
+    CRITICAL_REGION_EXIT();
+
+    if (post && app_sched_event_put(NULL, 0, sched_evt_handler) != NRF_SUCCESS)
+    {
+        // Cola llena: se actualiza con el proximo cambio o al despertar
+        m_pending = false;
+    }
+}
+
+void adv_payload_on_history(store_history const *p_record)
+{
+    if (p_record == NULL)
+    {
+        m_last_timestamp = TIMESTAMP_INVALID;
+        m_last_battery   = BATTERY_UNKNOWN;
+    }
+    else if (p_record->timestamp != TIMESTAMP_INVALID &&
+             (m_last_timestamp == TIMESTAMP_INVALID || p_record->timestamp >= m_last_timestamp))
+    {
+        // Los historiales recuperados del emisor llegan viejos: queda el mas
+        // reciente
+        m_last_timestamp = p_record->timestamp;
+        m_last_battery   = p_record->battery;
+    }
+    adv_broadcast_on_history(p_record);
+    adv_payload_changed();
+}
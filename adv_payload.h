@@ -0,0 +1,60 @@
+#ifndef ADV_PAYLOAD_H
+#define ADV_PAYLOAD_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "filesystem.h"
+
+// Payload del fabricante (company ID 0x2233) en el advertising del repetidor.
+// Alcanza para que el celular decida desde el escaneo si vale la pena
+// conectarse:
+//
+//   [0]      0x30
+//   [1..2]   Contador del emisor (16 bits bajos)
+//   [3..4]   V1
+//   [5..6]   V2
+//   [7..8]   Historiales guardados
+//   [9..12]  Fecha del historial mas reciente, segundos desde 2000
+//            (FFFFFFFF sin historiales)
+//   [13]     Bateria de ese historial en % (FF sin historiales)
+//   [14]     Enlaces: bit 0 celular conectado, bit 1 emisor conectado
+//   [15..22] Reservados (AB)
+//   [23]     FF
+//
+// Multibyte en big-endian. Con la difusion de historiales (adv_broadcast.h)
+// esta trama se alterna con las de historial. Se arma en el buffer que no
+// esta en uso y solo se entrega a la SoftDevice si difiere del vigente; el
+// advertising sigue corriendo mientras tanto. Los cambios se avisan desde cualquier contexto y
+// la actualizacion corre en el lazo principal (app_scheduler).
+
+#define ADV_PAYLOAD_SIZE        24
+
+#define ADV_PAYLOAD_LINK_PHONE  0x01
+#define ADV_PAYLOAD_LINK_EMISOR 0x02
+
+/**@brief Toma la fecha y bateria del historial mas reciente guardado. Llamar
+ *        despues de cargar la configuracion y antes de advertising_init().
+ */
+void           adv_payload_init(void);
+
+/**@brief Payload vigente (ADV_PAYLOAD_SIZE bytes). */
+uint8_t const *adv_payload_get(void);
+
+/**@brief Arma el payload y lo entrega al advertising si cambio.
+ *
+ * @return true si se actualizo.
+ */
+bool           adv_payload_update(void);
+
+/**@brief Pide una actualizacion en el lazo principal. Los pedidos que llegan
+ *        antes de atenderla se juntan en uno.
+ */
+void           adv_payload_changed(void);
+
+/**@brief Historial del emisor principal guardado en flash. NULL: se borraron
+ *        todos.
+ */
+void           adv_payload_on_history(store_history const *p_record);
+
+#endif // ADV_PAYLOAD_H
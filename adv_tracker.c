@@ -0,0 +1,204 @@
+#include "adv_tracker.h"
+
+#include "app_error.h"
+#include "app_nus_client.h"
+#include "app_timer.h"
+#include "nordic_common.h"
+#include "nrf_log.h"
+#include "variables.h"
+
+#define TICKS_PER_SEC (APP_TIMER_CLOCK_FREQ / (APP_TIMER_CONFIG_RTC_FREQUENCY + 1))
+#define MS_TO_TICKS(ms) ((uint64_t)(ms) * TICKS_PER_SEC / 1000)
+#define TICKS_TO_MS(t)  ((uint32_t)((uint64_t)(t) * 1000 / TICKS_PER_SEC))
+
+APP_TIMER_DEF(m_ext_timer);    // Mantiene el RTC1 andando y extiende el contador
+APP_TIMER_DEF(m_window_timer); // Apertura de la proxima ventana
+
+static uint64_t m_ticks_hi     = 0; // Ticks acumulados hasta m_last_cnt
+static uint32_t m_last_cnt     = 0;
+
+static bool     m_has_sample   = false;
+static bool     m_locked       = false;
+static uint64_t m_last_time    = 0; // Marca del ultimo ADV (ticks)
+static uint16_t m_last_counter = 0;
+static uint32_t m_period       = 0; // Intervalo de advertising (ticks)
+static uint32_t m_jitter       = 0; // Desvio medio respecto de lo previsto (ticks)
+static uint8_t  m_misses       = 0;
+static bool     m_searching    = false;
+static bool     m_window_heard = false; // La ventana en curso recibio algun ADV
+
+static uint64_t now_ticks(void)
+{
+    uint32_t cnt = app_timer_cnt_get();
+
+    m_ticks_hi += app_timer_cnt_diff_compute(cnt, m_last_cnt);
+    m_last_cnt  = cnt;
+    return m_ticks_hi;
+}
+
+static void ext_timer_handler(void *p_context)
+{
+    UNUSED_PARAMETER(p_context);
+    (void)now_ticks();
+}
+
+static uint32_t window_ticks(void)
+{
+    uint64_t window = MS_TO_TICKS(ADV_TRACK_MIN_WINDOW_MS) + 4 * (uint64_t)m_jitter;
+
+    window <<= m_misses;
+    return (uint32_t)MIN(window, MS_TO_TICKS(ADV_TRACK_MAX_WINDOW_MS));
+}
+
+// Programa la ventana centrada en la proxima llegada prevista
+static void schedule_window(void)
+{
+    uint64_t now  = now_ticks();
+    uint32_t half = window_ticks() / 2;
+    uint64_t next = m_last_time + m_period;
+
+    if (next < now + half + APP_TIMER_MIN_TIMEOUT_TICKS)
+    {
+        uint64_t n = (now + half + APP_TIMER_MIN_TIMEOUT_TICKS - m_last_time) / m_period + 1;
+        next       = m_last_time + n * m_period;
+    }
+
+    ret_code_t err_code =
+        app_timer_start(m_window_timer, (uint32_t)(next - half - now), NULL);
+    APP_ERROR_CHECK(err_code);
+}
+
+static void window_timer_handler(void *p_context)
+{
+    UNUSED_PARAMETER(p_context);
+
+    if (m_searching)
+    {
+        m_window_heard = false;
+        scan_start_passive_window(TICKS_TO_MS(window_ticks()));
+    }
+}
+
+static void unlock(void)
+{
+    m_locked     = false;
+    m_has_sample = false;
+    m_misses     = 0;
+    m_jitter     = 0;
+}
+
+void adv_tracker_init(void)
+{
+    ret_code_t err_code;
+
+    err_code = app_timer_create(&m_ext_timer, APP_TIMER_MODE_REPEATED, ext_timer_handler);
+    APP_ERROR_CHECK(err_code);
+    err_code =
+        app_timer_create(&m_window_timer, APP_TIMER_MODE_SINGLE_SHOT, window_timer_handler);
+    APP_ERROR_CHECK(err_code);
+
+    m_last_cnt = app_timer_cnt_get();
+    err_code   = app_timer_start(m_ext_timer, APP_TIMER_TICKS(ADV_TRACK_EXT_PERIOD_MS), NULL);
+    APP_ERROR_CHECK(err_code);
+}
+
+void adv_tracker_start_search(void)
+{
+    m_searching = true;
+
+    if (!m_locked)
+    {
+        scan_start_passive_mode();
+        return;
+    }
+
+    NRF_LOG_RAW_INFO(LOG_INFO " Intervalo del emisor: %u ms, ventanas de %u ms",
+                     TICKS_TO_MS(m_period),
+                     TICKS_TO_MS(window_ticks()));
+    schedule_window();
+}
+
+void adv_tracker_stop(void)
+{
+    m_searching = false;
+    (void)app_timer_stop(m_window_timer);
+}
+
+void adv_tracker_on_report(uint16_t adv_counter)
+{
+    uint64_t now = now_ticks();
+
+    m_window_heard = true;
+
+    if (m_has_sample)
+    {
+        uint16_t count_gap = (uint16_t)(adv_counter - m_last_counter);
+        uint64_t elapsed   = now - m_last_time;
+
+        if (count_gap == 0)
+        {
+            // El mismo evento de advertising llega en varios paquetes (un
+            // canal por paquete): la marca valida es la del primero
+            return;
+        }
+        if (count_gap > ADV_TRACK_MAX_COUNT_GAP || elapsed < count_gap)
+        {
+            // Contador hacia atras (emisor reiniciado) o salto imposible:
+            // empezar de nuevo
+            unlock();
+        }
+        else
+        {
+            uint32_t sample = (uint32_t)(elapsed / count_gap);
+
+            if (m_locked)
+            {
+                uint64_t predicted = m_last_time + (uint64_t)count_gap * m_period;
+                uint32_t error     = (uint32_t)((now > predicted) ? now - predicted
+                                                                  : predicted - now);
+                // Promedios moviles con peso 1/4
+                m_jitter = (uint32_t)((int32_t)m_jitter + ((int32_t)error - (int32_t)m_jitter) / 4);
+                m_period = (uint32_t)((int32_t)m_period + ((int32_t)sample - (int32_t)m_period) / 4);
+            }
+            else
+            {
+                m_period = sample;
+                m_locked = true;
+            }
+            m_misses = 0;
+        }
+    }
+
+    m_has_sample   = true;
+    m_last_time    = now;
+    m_last_counter = adv_counter;
+}
+
+void adv_tracker_on_window_timeout(void)
+{
+    if (!m_searching)
+    {
+        return;
+    }
+
+    // Con un ADV repetido el emisor estuvo en la ventana: no es una perdida
+    if (!m_window_heard && ++m_misses > ADV_TRACK_MAX_MISSES)
+    {
+        NRF_LOG_RAW_INFO(LOG_WARN " ADV del emisor fuera de lo previsto, escaneo continuo");
+        unlock();
+        scan_start_passive_mode();
+        return;
+    }
+
+    schedule_window();
+}
+
+bool adv_tracker_is_locked(void)
+{
+    return m_locked;
+}
+
+uint32_t adv_tracker_interval_ms(void)
+{
+    return m_locked ? TICKS_TO_MS(m_period) : 0;
+}
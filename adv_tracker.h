@@ -0,0 +1,48 @@
+#ifndef ADV_TRACKER_H
+#define ADV_TRACKER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Escaneo sincronizado con el advertising del emisor principal.
+//
+// Cada ADV del emisor trae un contador que avanza en 1 por evento de
+// advertising. Con la marca de tiempo (app_timer, extendida a 64 bits) y el
+// contador de dos ADV se obtiene el intervalo exacto aunque entre ellos haya
+// pasado un ciclo de sleep completo; el ultimo ADV fija la fase.
+//
+// Con el intervalo aprendido, la busqueda extendida no escanea de forma
+// continua: abre ventanas cortas centradas en la proxima llegada prevista. El
+// ancho de la ventana es el jitter observado mas un margen; cada ventana sin
+// ADV la duplica y despues de ADV_TRACK_MAX_MISSES se vuelve al escaneo
+// continuo hasta volver a aprender el intervalo.
+
+#define ADV_TRACK_MIN_WINDOW_MS  20    // advDelay de BLE (0-10 ms) + margen
+#define ADV_TRACK_MAX_WINDOW_MS  500
+#define ADV_TRACK_MAX_MISSES     4
+#define ADV_TRACK_MAX_COUNT_GAP  30000 // Mas ADV perdidos que esto: no confiar
+#define ADV_TRACK_EXT_PERIOD_MS  120000 // Extiende el contador de 24 bits
+
+void     adv_tracker_init(void);
+
+/**@brief Inicia la busqueda del emisor: ventanas si el intervalo es
+ *        conocido, escaneo continuo si no.
+ */
+void     adv_tracker_start_search(void);
+
+/**@brief Detiene las ventanas programadas (fin de la busqueda). */
+void     adv_tracker_stop(void);
+
+/**@brief ADV del emisor principal recibido, con su contador de advertising.
+ *        Se llama con todos los paquetes; los de un contador ya visto no
+ *        mueven la fase.
+ */
+void     adv_tracker_on_report(uint16_t adv_counter);
+
+/**@brief La ventana de escaneo termino sin recibir el ADV. */
+void     adv_tracker_on_window_timeout(void);
+
+bool     adv_tracker_is_locked(void);
+uint32_t adv_tracker_interval_ms(void);
+
+#endif // ADV_TRACKER_H
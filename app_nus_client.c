@@ -1,10 +1,16 @@
 #include "app_nus_client.h"
 
+#include "adv_tracker.h"
 #include "app_error.h"
 #include "app_nus_server.h"
+#include "app_timer.h"
 #include "ble_db_discovery.h"
 #include "ble_nus_c.h"
 #include "bsp_btn_ble.h"
+#include "cmd_sequencer.h"
+#include "emisor_table.h"
+#include "energy.h"
+#include "history_sync.h"
 #include "fds.h"
 #include "nordic_common.h"
 #include "nrf_ble_gatt.h"
@@ -13,6 +19,10 @@
 #include "nrf_log.h"
 #include "nrf_log_ctrl.h"
 #include "nrf_log_default_backends.h"
+#include "power_fsm.h"
+#include "relay.h"
+#include "rendezvous.h"
+#include "time_sync.h"
 #include "variables.h"
 
 #define NUS_SERVICE_UUID_TYPE BLE_UUID_TYPE_VENDOR_BEGIN
@@ -32,6 +42,33 @@ static ble_uuid_t const m_nus_uuid = {.uuid = BLE_UUID_NUS_SERVICE, .type = NUS_
 
 static bool             m_rssi_requested = false;
 
+// Cache de handles NUS del emisor (evita el descubrimiento GATT en cada ciclo)
+static gatt_cache_t     m_gatt_cache;
+static bool             m_gatt_cache_valid   = false;
+static bool             m_using_cached_gatt  = false;
+static ble_gap_addr_t   m_emisor_peer_addr;
+static uint16_t         m_emisor_conn_handle = BLE_CONN_HANDLE_INVALID;
+
+// Escaneo pasivo de la busqueda extendida: solo direcciones de la whitelist
+static ble_gap_scan_params_t const m_scan_param_whitelist = {
+    .active        = 0,
+    .interval      = NRF_BLE_SCAN_SCAN_INTERVAL,
+    .window        = NRF_BLE_SCAN_SCAN_WINDOW,
+    .timeout       = NRF_BLE_SCAN_SCAN_DURATION,
+    .filter_policy = BLE_GAP_SCAN_FP_WHITELIST,
+    .scan_phys     = BLE_GAP_PHY_1MBPS,
+};
+
+static bool m_scan_window_mode = false; // Ventana de adv_tracker en curso
+
+// Plazo para encontrar al emisor objetivo antes de pasar al siguiente
+APP_TIMER_DEF(m_target_timer);
+
+// El modulo de escaneo queda configurado en modo activo entre ciclos: al
+// despertar solo se cambia el filtro si cambio el emisor objetivo
+static bool           m_scan_active_ready = false;
+static ble_gap_addr_t m_scan_filter_addr;   // Direccion cargada en el filtro
+
 // Forward declaration
 static void scan_evt_handler(scan_evt_t const *p_scan_evt);
 
@@ -79,6 +116,74 @@ void target_periph_addr_init(void)
     NRF_LOG_RAW_INFO(LOG_OK " Filtrado configurado correctamente.\033[0m\n");
 }
 
+static void target_timer_start(void)
+{
+    ret_code_t err_code;
+
+    (void)app_timer_stop(m_target_timer);
+    if (emisor_table_count() < 2)
+    {
+        return; // Con un solo emisor se lo busca toda la ventana
+    }
+    err_code = app_timer_start(m_target_timer, APP_TIMER_TICKS(EMISOR_CONNECT_TIMEOUT_MS), NULL);
+    APP_ERROR_CHECK(err_code);
+}
+
+// El emisor objetivo no aparecio: se lo saltea para que uno fuera de alcance
+// no ocupe toda la ventana
+static void target_timer_handler(void *p_context)
+{
+    power_state_t state = power_fsm_state();
+
+    UNUSED_PARAMETER(p_context);
+
+    if (m_emisor_conn_handle != BLE_CONN_HANDLE_INVALID)
+    {
+        return;
+    }
+    if ((state != PWR_STATE_ACTIVE && state != PWR_STATE_EXTENDED_ACTIVE) || m_scan_window_mode)
+    {
+        // Busqueda extendida o ventana predicha en curso: se espera a que
+        // vuelva el escaneo activo
+        target_timer_start();
+        return;
+    }
+
+    NRF_LOG_RAW_INFO(LOG_WARN " Emisor sin respuesta en %u ms, pasando al siguiente",
+                     EMISOR_CONNECT_TIMEOUT_MS);
+    if (emisor_table_advance(false))
+    {
+        app_nus_client_search_current();
+    }
+}
+
+void app_nus_client_search_current(void)
+{
+    emisor_entry_t const *p_emisor = emisor_table_current();
+
+    NRF_LOG_RAW_INFO(LOG_EXEC " Buscando emisor %02X:%02X:%02X:%02X:%02X:%02X",
+                     p_emisor->mac[0],
+                     p_emisor->mac[1],
+                     p_emisor->mac[2],
+                     p_emisor->mac[3],
+                     p_emisor->mac[4],
+                     p_emisor->mac[5]);
+    app_nus_client_set_target(p_emisor->mac);
+    scan_start_active_mode();
+    target_timer_start();
+}
+
+// Cambia el emisor objetivo del escaneo activo (MAC con el MSB primero, igual
+// que en la configuracion). Se aplica en el proximo scan_start_active_mode().
+void app_nus_client_set_target(uint8_t const *p_mac)
+{
+    for (int i = 0; i < 6; i++)
+    {
+        m_target_periph_addr.addr[i] = p_mac[5 - i];
+    }
+    m_target_periph_addr.addr_type = BLE_GAP_ADDR_TYPE_RANDOM_STATIC;
+}
+
 static void nus_error_handler(uint32_t nrf_error)
 {
     APP_ERROR_HANDLER(nrf_error);
@@ -110,73 +215,129 @@ void scan_start(void)
 
     ret = nrf_ble_scan_start(&m_scan);
     APP_ERROR_CHECK(ret);
+    energy_radio_on(ENERGY_RADIO_SCAN);
 
     ret = bsp_indication_set(BSP_INDICATE_SCANNING);
     APP_ERROR_CHECK(ret);
 }
 
 
-void scan_start_passive_mode(void)
+// Reinicia el modulo de escaneo en modo pasivo con la whitelist de emisores
+static void scan_start_passive(ble_gap_scan_params_t const *p_scan_param)
 {
-    ret_code_t err_code;
-    
-    // Detener el escaneo actual
-    scan_stop();
-    nrf_delay_ms(50);
-    
-    // Reconfigurar el escaneo sin auto-conexión
+    ret_code_t          err_code;
     nrf_ble_scan_init_t init_scan;
+
     memset(&init_scan, 0, sizeof(init_scan));
-    
-    init_scan.connect_if_match = false;  // ¡IMPORTANTE! No conectar automáticamente
+
+    init_scan.connect_if_match = false; // ¡IMPORTANTE! No conectar automáticamente
     init_scan.conn_cfg_tag     = APP_BLE_CONN_CFG_TAG;
-    
-    err_code = nrf_ble_scan_init(&m_scan, &init_scan, scan_evt_handler);
+    init_scan.p_scan_param     = p_scan_param;
+
+    err_code                   = nrf_ble_scan_init(&m_scan, &init_scan, scan_evt_handler);
     APP_ERROR_CHECK(err_code);
-    
-    // NO usar filtros del módulo scan para modo pasivo
-    // El filtrado se hará manualmente en BLE_GAP_EVT_ADV_REPORT
-    // Esto asegura que TODOS los ADV reports lleguen al handler
-    
-    // Iniciar escaneo pasivo SIN filtros
+    m_scan_active_ready        = false;
+
+    // Filtro por hardware: la SoftDevice solo entrega los ADV de las
+    // direcciones de la whitelist (los emisores de la tabla). La whitelist se
+    // carga en NRF_BLE_SCAN_EVT_WHITELIST_REQUEST al iniciar el escaneo.
     err_code = nrf_ble_scan_start(&m_scan);
     APP_ERROR_CHECK(err_code);
-    
+    energy_radio_on(ENERGY_RADIO_SCAN);
+
     err_code = bsp_indication_set(BSP_INDICATE_SCANNING);
     APP_ERROR_CHECK(err_code);
-    
-    NRF_LOG_RAW_INFO(LOG_OK " Escaneo PASIVO activado (escuchando TODOS los ADV)");
 }
 
-
-void scan_start_active_mode(void)
+void scan_start_passive_mode(void)
 {
-    ret_code_t err_code;
-    
     // Detener el escaneo actual
     scan_stop();
-    nrf_delay_ms(10);
-    
-    // Reconfigurar el escaneo CON auto-conexión
-    nrf_ble_scan_init_t init_scan;
-    memset(&init_scan, 0, sizeof(init_scan));
-    
-    init_scan.connect_if_match = true;  // Conectar automáticamente
-    init_scan.conn_cfg_tag     = APP_BLE_CONN_CFG_TAG;
-    
-    err_code = nrf_ble_scan_init(&m_scan, &init_scan, scan_evt_handler);
+    nrf_delay_ms(50);
+
+    m_scan_window_mode = false;
+    scan_start_passive(&m_scan_param_whitelist);
+
+    NRF_LOG_RAW_INFO(LOG_OK " Escaneo PASIVO activado (whitelist de emisores)");
+}
+
+void scan_start_passive_window(uint32_t window_ms)
+{
+    // Una sola ventana: intervalo = ventana (escaneo continuo mientras dura)
+    // y timeout de la SoftDevice para cerrarla
+    static ble_gap_scan_params_t scan_param;
+
+    scan_param               = m_scan_param_whitelist;
+    scan_param.interval      = (uint16_t)MSEC_TO_UNITS(window_ms, UNIT_0_625_MS);
+    scan_param.window        = scan_param.interval;
+    scan_param.timeout       = (uint16_t)((window_ms + 9) / 10); // Unidades de 10 ms
+
+    scan_stop();
+    m_scan_window_mode = true;
+    scan_start_passive(&scan_param);
+}
+
+
+// Carga el emisor objetivo en el filtro por direccion si no es el que ya esta
+static void scan_filter_update(void)
+{
+    ret_code_t err_code;
+
+    if (memcmp(m_scan_filter_addr.addr, m_target_periph_addr.addr, BLE_GAP_ADDR_LEN) == 0)
+    {
+        return;
+    }
+
+    err_code = nrf_ble_scan_all_filter_remove(&m_scan);
     APP_ERROR_CHECK(err_code);
-    
-    // Mantener el filtro por MAC del emisor
+
     err_code = nrf_ble_scan_filter_set(&m_scan, NRF_BLE_SCAN_ADDR_FILTER, m_target_periph_addr.addr);
     APP_ERROR_CHECK(err_code);
+    m_scan_filter_addr = m_target_periph_addr;
+}
+
+void scan_start_active_mode(void)
+{
+    ret_code_t err_code;
     
-    err_code = nrf_ble_scan_filters_enable(&m_scan, NRF_BLE_SCAN_ALL_FILTER, false);
-    APP_ERROR_CHECK(err_code);
+    // Detener el escaneo actual
+    scan_stop();
+    m_scan_window_mode = false;
+
+    if (m_scan_active_ready)
+    {
+        // Ya configurado en modo activo: sin reiniciar el modulo ni esperar
+        scan_filter_update();
+    }
+    else
+    {
+        nrf_delay_ms(10);
+
+        // Reconfigurar el escaneo CON auto-conexión
+        nrf_ble_scan_init_t init_scan;
+        memset(&init_scan, 0, sizeof(init_scan));
+
+        init_scan.connect_if_match = true;  // Conectar automáticamente
+        init_scan.conn_cfg_tag     = APP_BLE_CONN_CFG_TAG;
+
+        err_code = nrf_ble_scan_init(&m_scan, &init_scan, scan_evt_handler);
+        APP_ERROR_CHECK(err_code);
+
+        // Mantener el filtro por MAC del emisor
+        err_code = nrf_ble_scan_filter_set(&m_scan, NRF_BLE_SCAN_ADDR_FILTER,
+                                           m_target_periph_addr.addr);
+        APP_ERROR_CHECK(err_code);
+        m_scan_filter_addr = m_target_periph_addr;
+
+        err_code = nrf_ble_scan_filters_enable(&m_scan, NRF_BLE_SCAN_ALL_FILTER, false);
+        APP_ERROR_CHECK(err_code);
+        m_scan_active_ready = true;
+    }
     
     // Iniciar escaneo activo
     err_code = nrf_ble_scan_start(&m_scan);
     APP_ERROR_CHECK(err_code);
+    energy_radio_on(ENERGY_RADIO_SCAN);
     
     err_code = bsp_indication_set(BSP_INDICATE_SCANNING);
     APP_ERROR_CHECK(err_code);
@@ -184,6 +345,39 @@ void scan_start_active_mode(void)
     NRF_LOG_RAW_INFO(LOG_OK " Escaneo ACTIVO restaurado (con auto-conexion)");
 }
 
+/**@brief Carga en la SoftDevice la whitelist con los emisores de la tabla. */
+static void scan_whitelist_set(void)
+{
+    static ble_gap_addr_t  addrs[EMISOR_TABLE_MAX];
+    ble_gap_addr_t const  *p_addrs[EMISOR_TABLE_MAX];
+    uint8_t                count = 0;
+    ret_code_t             err_code;
+
+    for (uint8_t i = 0; i < EMISOR_TABLE_MAX; i++)
+    {
+        emisor_entry_t const *p_emisor = emisor_table_get(i);
+        if (p_emisor == NULL)
+        {
+            continue;
+        }
+        // BLE usa little-endian, la tabla guarda el MSB primero
+        for (uint8_t j = 0; j < 6; j++)
+        {
+            addrs[count].addr[j] = p_emisor->mac[5 - j];
+        }
+        addrs[count].addr_id_peer = 0;
+        addrs[count].addr_type    = BLE_GAP_ADDR_TYPE_RANDOM_STATIC;
+        p_addrs[count]            = &addrs[count];
+        count++;
+    }
+
+    err_code = sd_ble_gap_whitelist_set(p_addrs, count);
+    if (err_code != NRF_SUCCESS)
+    {
+        NRF_LOG_RAW_INFO(LOG_FAIL " No se pudo cargar la whitelist: 0x%X", err_code);
+    }
+}
+
 /**@brief Function for handling Scanning Module events.
  */
 static void scan_evt_handler(scan_evt_t const *p_scan_evt)
@@ -213,11 +407,23 @@ static void scan_evt_handler(scan_evt_t const *p_scan_evt)
     break;
 
     case NRF_BLE_SCAN_EVT_SCAN_TIMEOUT: {
+        energy_radio_off(ENERGY_RADIO_SCAN);
+        if (m_scan_window_mode)
+        {
+            // Ventana cerrada sin ADV del emisor
+            m_scan_window_mode = false;
+            adv_tracker_on_window_timeout();
+            break;
+        }
         NRF_LOG_INFO("Scan timed out.");
         scan_start();
     }
     break;
 
+    case NRF_BLE_SCAN_EVT_WHITELIST_REQUEST:
+        scan_whitelist_set();
+        break;
+
     case NRF_BLE_SCAN_EVT_FILTER_MATCH:
         break;
 
@@ -242,9 +448,142 @@ static void scan_init(void)
     err_code =
         nrf_ble_scan_filter_set(&m_scan, NRF_BLE_SCAN_ADDR_FILTER, m_target_periph_addr.addr);
     APP_ERROR_CHECK(err_code);
+    m_scan_filter_addr = m_target_periph_addr;
 
     err_code = nrf_ble_scan_filters_enable(&m_scan, NRF_BLE_SCAN_ALL_FILTER, false);
     APP_ERROR_CHECK(err_code);
+    m_scan_active_ready = true;
+}
+
+/**@brief Encola los comandos de cada ciclo para el emisor (hora, 96 y 08).
+ *
+ * El secuenciador los envia de a uno y espera la respuesta de cada uno.
+ */
+static void emisor_send_initial_commands(void)
+{
+    ret_code_t err_code;
+
+    //============================================================
+    //                         COMANDOS
+    //============================================================
+
+    uint8_t cmd_id[2] = {0};
+
+    //
+    // Sincronizar la hora del emisor con la del repetidor
+    //
+    time_sync_start();
+
+    //
+    // Solicitar los valores de los ADC y contador
+    //
+    cmd_id[0] = '9';
+    cmd_id[1] = '6';
+
+    NRF_LOG_RAW_INFO(LOG_EXEC " Enviando comando 96");
+    err_code = cmd_seq_push(cmd_id, 2, 0x96, CMD_SEQ_DEFAULT_TIMEOUT_MS, CMD_SEQ_DEFAULT_RETRIES);
+    if (err_code != NRF_SUCCESS)
+    {
+        NRF_LOG_RAW_INFO(LOG_FAIL " Fallo al solicitar datos de ADC y contador: %d", err_code);
+    }
+
+    //
+    // Solicitar el ultimo historial
+    //
+    cmd_id[0] = '0';
+    cmd_id[1] = '8';
+
+    err_code  = cmd_seq_push(cmd_id, 2, 0x08, CMD_SEQ_DEFAULT_TIMEOUT_MS, CMD_SEQ_DEFAULT_RETRIES);
+    if (err_code != NRF_SUCCESS)
+    {
+        NRF_LOG_RAW_INFO(LOG_FAIL " Fallo al solicitar el ultimo historial: %d", err_code);
+    }
+
+    //============================================================
+    //                  AQUI TERMINAN LOS COMANDOS
+    //============================================================
+}
+
+/**@brief Guarda en flash los handles descubiertos si cambiaron. */
+static void gatt_cache_store(ble_nus_c_handles_t const *p_handles)
+{
+    ble_gap_addr_t const *p_peer_addr = &m_emisor_peer_addr;
+
+    // Solo se guarda la cache del emisor principal: con varios emisores se
+    // reescribiria la flash en cada conexion
+    if (emisor_table_find_by_addr(p_peer_addr) != 0)
+    {
+        return;
+    }
+
+    if (m_gatt_cache_valid && memcmp(m_gatt_cache.mac, p_peer_addr->addr, 6) == 0 &&
+        m_gatt_cache.nus_rx_handle == p_handles->nus_rx_handle &&
+        m_gatt_cache.nus_tx_handle == p_handles->nus_tx_handle &&
+        m_gatt_cache.nus_tx_cccd_handle == p_handles->nus_tx_cccd_handle)
+    {
+        return; // Sin cambios, no gastar escrituras de flash
+    }
+
+    memcpy(m_gatt_cache.mac, p_peer_addr->addr, 6);
+    m_gatt_cache.nus_rx_handle      = p_handles->nus_rx_handle;
+    m_gatt_cache.nus_tx_handle      = p_handles->nus_tx_handle;
+    m_gatt_cache.nus_tx_cccd_handle = p_handles->nus_tx_cccd_handle;
+
+    m_gatt_cache_valid = (save_gatt_cache(&m_gatt_cache) == NRF_SUCCESS);
+}
+
+/**@brief Intenta usar los handles guardados para el emisor recien conectado.
+ *
+ * @return true si se asignaron los handles de la cache.
+ */
+static bool gatt_cache_apply(uint16_t conn_handle, ble_gap_addr_t const *p_peer_addr)
+{
+    ret_code_t          err_code;
+    ble_nus_c_handles_t handles;
+
+    if (!m_gatt_cache_valid || memcmp(m_gatt_cache.mac, p_peer_addr->addr, 6) != 0)
+    {
+        return false;
+    }
+
+    handles.nus_rx_handle      = m_gatt_cache.nus_rx_handle;
+    handles.nus_tx_handle      = m_gatt_cache.nus_tx_handle;
+    handles.nus_tx_cccd_handle = m_gatt_cache.nus_tx_cccd_handle;
+
+    err_code                   = ble_nus_c_handles_assign(&m_ble_nus_c, conn_handle, &handles);
+    if (err_code != NRF_SUCCESS)
+    {
+        return false;
+    }
+
+    err_code = ble_nus_c_tx_notif_enable(&m_ble_nus_c);
+    if (err_code != NRF_SUCCESS)
+    {
+        return false;
+    }
+
+    NRF_LOG_RAW_INFO(LOG_INFO " Usando handles NUS en cache (sin descubrimiento)");
+    return true;
+}
+
+/**@brief La cache no corresponde al servidor GATT del emisor: borrarla y
+ *        descubrir de nuevo en esta misma conexion.
+ */
+static void gatt_cache_invalidate_and_discover(uint16_t conn_handle)
+{
+    ret_code_t err_code;
+
+    NRF_LOG_RAW_INFO(LOG_WARN " Handles en cache no validos, redescubriendo...");
+
+    m_using_cached_gatt = false;
+    m_gatt_cache_valid  = false;
+    delete_gatt_cache();
+
+    err_code = ble_nus_c_handles_assign(&m_ble_nus_c, conn_handle, NULL);
+    APP_ERROR_CHECK(err_code);
+
+    err_code = ble_db_discovery_start(&m_db_disc, conn_handle);
+    APP_ERROR_CHECK(err_code);
 }
 
 static void ble_nus_c_evt_handler(ble_nus_c_t *p_ble_nus_c, ble_nus_c_evt_t const *p_ble_nus_evt)
@@ -263,63 +602,34 @@ static void ble_nus_c_evt_handler(ble_nus_c_t *p_ble_nus_c, ble_nus_c_evt_t cons
         err_code = ble_nus_c_tx_notif_enable(p_ble_nus_c);
         APP_ERROR_CHECK(err_code);
 
-        //============================================================
-        //                         COMANDOS
-        //============================================================
-
-        uint8_t cmd_id[2] = {0};
-
-        //
-        // Enviar la hora actual del repetidor al emisor
-        //
-
-        char cmd_enviar_hora_a_emisor[24] = {0};
-        snprintf(cmd_enviar_hora_a_emisor,
-                 sizeof(cmd_enviar_hora_a_emisor),
-                 "060%04u.%02u.%02u %02u.%02u.%02u",
-                 m_time.year,
-                 m_time.month,
-                 m_time.day,
-                 m_time.hour,
-                 m_time.minute,
-                 m_time.second);
-        app_nus_client_send_data((uint8_t *)cmd_enviar_hora_a_emisor,
-                                 strlen((const char *)cmd_enviar_hora_a_emisor));
-
-        //
-        // Solicitar los valores de los ADC y contador
-        //
-        cmd_id[0] = '9';
-        cmd_id[1] = '6';
-
-        NRF_LOG_RAW_INFO(LOG_EXEC " Enviando comando 96");
-        err_code = app_nus_client_send_data(cmd_id, 2);
-        if (err_code != NRF_SUCCESS)
-        {
-            NRF_LOG_RAW_INFO(LOG_FAIL " Fallo al solicitar datos de ADC y contador: %d", err_code);
-        }
+        // Guardar los handles para los proximos ciclos
+        m_using_cached_gatt = false;
+        gatt_cache_store(&p_ble_nus_evt->handles);
 
-        cmd_id[0] = '0';
-        cmd_id[1] = '8';
-
-        err_code  = app_nus_client_send_data(cmd_id, 2);
-        if (err_code != NRF_SUCCESS)
-        {
-            NRF_LOG_RAW_INFO(LOG_FAIL " Fallo al solicitar el ultimo historial: %d", err_code);
-        }
-
-        //============================================================
-        //                  AQUI TERMINAN LOS COMANDOS
-        //============================================================
+        emisor_send_initial_commands();
 
         break;
 
     case BLE_NUS_C_EVT_NUS_TX_EVT:
+        // Llegaron datos por la notificacion: los handles en cache son validos
+        m_using_cached_gatt = false;
+        // Liberar el comando en curso antes de procesar la respuesta
+        cmd_seq_on_response(p_ble_nus_evt->p_data, p_ble_nus_evt->data_len);
         if (m_on_data_received)
         {
 
             m_on_data_received(p_ble_nus_evt->p_data, p_ble_nus_evt->data_len);
         }
+
+        // Con varios emisores se libera el enlace en cuanto este emisor no
+        // tiene nada pendiente, para atender al siguiente en la misma ventana
+        if (emisor_table_count() > 1 && cmd_seq_is_idle() && !history_sync_is_active() &&
+            m_emisor_conn_handle != BLE_CONN_HANDLE_INVALID)
+        {
+            NRF_LOG_RAW_INFO(LOG_INFO " Emisor atendido, liberando el enlace");
+            (void)sd_ble_gap_disconnect(m_emisor_conn_handle,
+                                        BLE_HCI_REMOTE_USER_TERMINATED_CONNECTION);
+        }
         // Imprime los datos recibidos
 
         // NRF_LOG_RAW_INFO("\nClient data received: ");
@@ -358,6 +668,11 @@ uint32_t app_nus_client_send_data(const uint8_t *data_array, uint16_t length)
     return ble_nus_c_string_send(&m_ble_nus_c, (uint8_t *)data_array, length);
 }
 
+bool app_nus_client_is_connected(void)
+{
+    return m_emisor_conn_handle != BLE_CONN_HANDLE_INVALID;
+}
+
 void app_nus_client_ble_evt_handler(ble_evt_t const *p_ble_evt)
 {
     ret_code_t           err_code;
@@ -369,6 +684,10 @@ void app_nus_client_ble_evt_handler(ble_evt_t const *p_ble_evt)
     case BLE_GAP_EVT_CONNECTED:
         if (p_gap_evt->params.connected.role == BLE_GAP_ROLE_CENTRAL)
         {
+            // La SoftDevice detiene el escaneo al conectar
+            energy_radio_off(ENERGY_RADIO_SCAN);
+            (void)app_timer_stop(m_target_timer);
+
             if (!m_rssi_requested)
             {
                 ret_code_t err_code = sd_ble_gap_rssi_start(conn_handle, 0, 0);
@@ -379,22 +698,56 @@ void app_nus_client_ble_evt_handler(ble_evt_t const *p_ble_evt)
                 }
             }
 
-            restart_on_rtc();
-            m_connected_this_cycle = true;
-            m_extended_mode_on     = false;
+            // Vuelve la ventana ON normal (power_fsm)
+            power_fsm_post(PWR_EVT_EMISOR_CONTACT);
 
-            err_code =
-                ble_nus_c_handles_assign(&m_ble_nus_c, p_ble_evt->evt.gap_evt.conn_handle, NULL);
+            err_code = bsp_indication_set(BSP_INDICATE_CONNECTED);
             APP_ERROR_CHECK(err_code);
 
-            err_code = bsp_indication_set(BSP_INDICATE_CONNECTED);
+            m_emisor_peer_addr   = p_gap_evt->params.connected.peer_addr;
+            m_emisor_conn_handle = conn_handle;
+            int8_t emisor_index = emisor_table_find_by_addr(&m_emisor_peer_addr);
+            emisor_table_on_connected(emisor_index, conn_handle);
+            if (emisor_index == 0)
+            {
+                rendezvous_on_contact();
+            }
+
+            // Con handles en cache se evita el descubrimiento de servicios
+            m_using_cached_gatt = gatt_cache_apply(conn_handle, &m_emisor_peer_addr);
+            if (m_using_cached_gatt)
+            {
+                emisor_send_initial_commands();
+                break;
+            }
+
+            err_code = ble_nus_c_handles_assign(&m_ble_nus_c, conn_handle, NULL);
             APP_ERROR_CHECK(err_code);
 
-            err_code = ble_db_discovery_start(&m_db_disc, p_ble_evt->evt.gap_evt.conn_handle);
+            err_code = ble_db_discovery_start(&m_db_disc, conn_handle);
             APP_ERROR_CHECK(err_code);
         }
         break;
 
+    case BLE_GATTC_EVT_WRITE_RSP:
+        // Un error al habilitar las notificaciones con handles en cache indica
+        // que la tabla GATT del emisor cambio
+        if (m_using_cached_gatt &&
+            p_ble_evt->evt.gattc_evt.gatt_status != BLE_GATT_STATUS_SUCCESS &&
+            p_ble_evt->evt.gattc_evt.params.write_rsp.handle == m_gatt_cache.nus_tx_cccd_handle)
+        {
+            gatt_cache_invalidate_and_discover(p_ble_evt->evt.gattc_evt.conn_handle);
+        }
+        break;
+
+    case BLE_GATTC_EVT_WRITE_CMD_TX_COMPLETE:
+        // El stack libero buffers de escritura: reintentar lo pendiente
+        if (p_ble_evt->evt.gattc_evt.conn_handle == m_emisor_conn_handle)
+        {
+            relay_on_emisor_tx_complete();
+        }
+        break;
+
     case BLE_GAP_EVT_RSSI_CHANGED: {
         int8_t rssi = p_gap_evt->params.rssi_changed.rssi;
         NRF_LOG_RAW_INFO(LOG_INFO " RSSI Emisor: %d [dbm]", rssi);
@@ -404,6 +757,20 @@ void app_nus_client_ble_evt_handler(ble_evt_t const *p_ble_evt)
     case BLE_GAP_EVT_DISCONNECTED:
 
         m_rssi_requested = false;
+        if (conn_handle == m_emisor_conn_handle)
+        {
+            m_emisor_conn_handle = BLE_CONN_HANDLE_INVALID;
+            m_using_cached_gatt  = false;
+            history_sync_reset();
+            cmd_seq_reset();
+            relay_on_emisor_disconnected();
+
+            // Pasar al siguiente emisor pendiente de esta ventana
+            if (power_fsm_is_active() && emisor_table_advance(true))
+            {
+                app_nus_client_search_current();
+            }
+        }
         // NRF_LOG_RAW_INFO("\nBuscando emisor...");
         // scan_start();
         break;
@@ -413,15 +780,23 @@ void app_nus_client_ble_evt_handler(ble_evt_t const *p_ble_evt)
 void scan_stop(void)
 {
     nrf_ble_scan_stop();
+    energy_radio_off(ENERGY_RADIO_SCAN);
 }
 
 void app_nus_client_init(app_nus_client_on_data_received_t on_data_received)
 {
+    ret_code_t err_code;
+
     m_on_data_received = on_data_received;
 
+    err_code = app_timer_create(&m_target_timer, APP_TIMER_MODE_SINGLE_SHOT, target_timer_handler);
+    APP_ERROR_CHECK(err_code);
+
     target_periph_addr_init();
+    m_gatt_cache_valid = (load_gatt_cache(&m_gatt_cache) == NRF_SUCCESS);
     db_discovery_init();
     nus_c_init();
+    cmd_seq_init();
     scan_init();
     scan_start();
 }
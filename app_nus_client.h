@@ -1,6 +1,7 @@
 #ifndef __APP_NUS_CLIENT_H
 #define __APP_NUS_CLIENT_H
 
+#include <stdbool.h>
 #include <stdint.h>
 
 #include "ble.h"
@@ -11,12 +12,16 @@ typedef void (*app_nus_client_on_data_received_t)(const uint8_t *data_ptr,
                                                   uint16_t       data_length);
 
 uint32_t app_nus_client_send_data(const uint8_t *data_array, uint16_t length);
+bool     app_nus_client_is_connected(void); // Hay enlace con un emisor
 void     app_nus_client_ble_evt_handler(ble_evt_t const *p_ble_evt);
 void     app_nus_client_init(app_nus_client_on_data_received_t on_data_received);
 void     scan_stop(void);
 void     scan_start(void);
 void     scan_start_passive_mode(void);  // Escaneo pasivo (solo escucha ADV, sin conectar)
+void     scan_start_passive_window(uint32_t window_ms); // Una ventana pasiva corta
 void     scan_start_active_mode(void);   // Escaneo activo (con auto-conexión)
 void     target_periph_addr_init(void);  // Actualizar filtro BLE con nueva MAC
+void     app_nus_client_set_target(uint8_t const *p_mac); // Emisor objetivo (MSB primero)
+void     app_nus_client_search_current(void); // Escaneo activo del emisor actual de la tabla
 
 #endif
@@ -1,4 +1,6 @@
 #include "app_nus_server.h"
+#include "adv_payload.h"
+#include "adv_broadcast.h"
 #include "app_nus_client.h"
 #include "app_timer.h"
 #include "app_uart.h"
@@ -8,6 +10,8 @@
 #include "ble_nus.h"
 #include "bsp_btn_ble.h"
 #include "calendar.h"
+#include "emisor_table.h"
+#include "energy.h"
 #include "fds.h"
 #include "leds.h"
 #include "filesystem.h"
@@ -21,6 +25,10 @@
 #include "nrf_sdh.h"
 #include "nrf_sdh_ble.h"
 #include "nrf_sdh_soc.h"
+#include "power_fsm.h"
+#include "relay.h"
+#include "relay_queue.h"
+#include "telemetry.h"
 #include "variables.h"
 
 #define APP_BLE_CONN_CFG_TAG           1
@@ -37,9 +45,6 @@
 #define NEXT_CONN_PARAMS_UPDATE_DELAY  APP_TIMER_TICKS(30000)
 #define MAX_CONN_PARAMS_UPDATE_COUNT   3
 #define DEAD_BEEF                      0xDEADBEEF
-#define LARGO_ADVERTISING              0x18 // Largo_Advertising  10 son 16 y 18 son 24
-
-uint8_t m_beacon_info[LARGO_ADVERTISING];
 
 BLE_NUS_DEF(m_nus, NRF_SDH_BLE_TOTAL_LINK_COUNT);
 NRF_BLE_QWR_DEF(m_qwr);
@@ -56,6 +61,13 @@ static ble_gap_addr_t m_target_periph_addr;
 static ble_uuid_t     m_adv_uuids[] = {
            {BLE_UUID_NUS_SERVICE, NUS_SERVICE_UUID_TYPE}};
 
+// Totales de energia (comando 27) en partes del largo negociado
+static uint8_t        m_energy_frame[ENERGY_FRAME_SIZE];
+static uint8_t        m_energy_part   = 0;
+static uint8_t        m_energy_parts  = 0; // 0 = nada pendiente
+static uint8_t        m_energy_chunk  = 0; // Bytes de datos por parte
+static bool           m_energy_reset  = false;
+
 /**@brief Function for handling Queued Write Module errors.
  *
  * @details A pointer to this function will be passed to each service which may
@@ -69,6 +81,55 @@ static void nrf_qwr_error_handler(uint32_t nrf_error)
     APP_ERROR_HANDLER(nrf_error);
 }
 
+/**@brief Envia las partes pendientes de los totales de energia. Cada parte
+ *        es [E7][parte][partes] + datos; sin buffers se sigue en el TX_RDY.
+ */
+static void energy_frame_send_next(void)
+{
+    uint8_t fragment[ENERGY_PART_HEADER_SIZE + ENERGY_FRAME_SIZE];
+
+    while (m_energy_part < m_energy_parts) {
+        uint16_t offset = 1 + m_energy_part * m_energy_chunk; // Despues del E7
+        uint16_t length = MIN(m_energy_chunk, ENERGY_FRAME_SIZE - offset);
+        uint32_t err_code;
+
+        fragment[0] = ENERGY_FRAME_TAG;
+        fragment[1] = m_energy_part;
+        fragment[2] = m_energy_parts;
+        memcpy(&fragment[ENERGY_PART_HEADER_SIZE], &m_energy_frame[offset], length);
+
+        err_code = app_nus_server_send_data(fragment, ENERGY_PART_HEADER_SIZE + length);
+        if (err_code == NRF_ERROR_RESOURCES) {
+            return; // Esperar al próximo TX_RDY
+        }
+        if (err_code != NRF_SUCCESS) {
+            NRF_LOG_RAW_INFO(LOG_FAIL " No se pudieron enviar los totales de energia: 0x%X",
+                             err_code);
+            m_energy_parts = 0;
+            return;
+        }
+        m_energy_part++;
+    }
+
+    if (m_energy_parts != 0 && m_energy_reset) {
+        energy_totals_reset();
+        NRF_LOG_RAW_INFO(LOG_OK " Totales de energia reiniciados");
+    }
+    m_energy_parts = 0;
+}
+
+static void energy_frame_start(bool reset)
+{
+    uint16_t data_len = energy_encode_totals(m_energy_frame) - 1;
+
+    m_energy_chunk = (uint8_t)MIN(app_nus_server_max_data_len() - ENERGY_PART_HEADER_SIZE,
+                                  data_len);
+    m_energy_parts = (uint8_t)((data_len + m_energy_chunk - 1) / m_energy_chunk);
+    m_energy_part  = 0;
+    m_energy_reset = reset;
+    energy_frame_send_next();
+}
+
 /**@brief Function for handling the data from the Nordic UART Service.
  *
  * @details This function will process the data received from the Nordic UART
@@ -441,7 +502,8 @@ static void nus_data_handler(ble_nus_evt_t *p_evt)
 
                             // Actualizar la estructura de configuración con la
                             // nueva fecha
-                            config_repeater.fecha = dt;
+                            config_repeater.fecha =
+                                       timestamp_from_datetime(&dt);
                             NRF_LOG_RAW_INFO(
                                        LOG_OK " Estructura config_repeater "
                                               "actualizada");
@@ -733,20 +795,9 @@ static void nus_data_handler(ble_nus_evt_t *p_evt)
                                 data_array[position++] = 0x08;
 
                                 // Bytes 1-7: Fecha y hora
-                                data_array[position++] = registro_historial.day;
-                                data_array[position++] =
-                                           registro_historial.month;
-                                data_array[position++] =
-                                           (registro_historial.year >> 8) &
-                                           0xFF;
-                                data_array[position++] =
-                                           (registro_historial.year & 0xFF);
-                                data_array[position++] =
-                                           registro_historial.hour;
-                                data_array[position++] =
-                                           registro_historial.minute;
-                                data_array[position++] =
-                                           registro_historial.second;
+                                position += history_put_ble_date(
+                                           &data_array[position],
+                                           registro_historial.timestamp);
 
                                 // Bytes 8-11: Contador (4 bytes) - convertir a
                                 // big-endian
@@ -1055,6 +1106,227 @@ static void nus_data_handler(ble_nus_evt_t *p_evt)
                     break;
                 }
 
+                case 21: // Comando 21: Negociar exportacion comprimida del
+                         // historial para esta sesion
+                {
+                    NRF_LOG_RAW_INFO(
+                               "\n\n\x1b[1;36m--- Comando 21 recibido: "
+                               "Exportacion comprimida de historial\x1b[0m");
+
+                    // "11121" o "111211" habilita, "111210" deshabilita
+                    bool enable = true;
+                    if (p_evt->params.rx_data.length > 5) {
+                        enable = (message[5] != '0');
+                    }
+
+                    if (history_send_is_active()) {
+                        NRF_LOG_RAW_INFO(
+                                   LOG_WARN " Envio de historial en curso, "
+                                            "modo sin cambios");
+                    }
+                    else {
+                        history_set_compression(enable);
+                    }
+
+                    NRF_LOG_RAW_INFO(
+                               LOG_INFO " Exportacion comprimida %s",
+                               history_compression_is_enabled()
+                                          ? "HABILITADA"
+                                          : "DESHABILITADA");
+
+                    err_code = history_send_compression_ack();
+                    if (err_code != NRF_SUCCESS) {
+                        NRF_LOG_RAW_INFO(
+                                   LOG_FAIL " No se pudo confirmar el modo: "
+                                            "0x%X",
+                                   err_code);
+                    }
+                    break;
+                }
+
+                case 22: // Comando 22: Leer campos seleccionados de la
+                         // configuracion (TLV)
+                {
+                    NRF_LOG_RAW_INFO(
+                               "\n\n\x1b[1;36m--- Comando 22 recibido: Leer "
+                               "campos de configuracion\x1b[0m");
+
+                    // "11122" + etiquetas en hex, ej: "111220104" -> MAC
+                    // emisor y tiempo encendido. Sin etiquetas se envian
+                    // todos los campos.
+                    uint8_t tags[CONFIG_TLV_BUFFER_SIZE / CONFIG_TLV_MAX_FIELD_SIZE];
+                    uint8_t tag_count = 0;
+                    size_t  tag_chars = p_evt->params.rx_data.length - 5;
+
+                    for (size_t i = 0;
+                         i + 1 < tag_chars && tag_count < sizeof(tags);
+                         i += 2) {
+                        char byte_str[3] = {
+                                   message[5 + i], message[6 + i], '\0'};
+                        tags[tag_count++] =
+                                   (uint8_t)strtol(byte_str, NULL, 16);
+                    }
+
+                    err_code = send_config_fields_via_ble(tags, tag_count);
+                    if (err_code != NRF_SUCCESS) {
+                        NRF_LOG_RAW_INFO(
+                                   LOG_FAIL " No se pudo enviar la "
+                                            "configuracion: 0x%X",
+                                   err_code);
+                    }
+                    break;
+                }
+
+                case 23: // Comando 23: Suscripcion a telemetria en vivo
+                {
+                    NRF_LOG_RAW_INFO(
+                               "\n\n\x1b[1;36m--- Comando 23 recibido: "
+                               "Suscripcion a telemetria\x1b[0m");
+
+                    // "11123" + modo (0 apagado, 1 periodico, 2 por cambio)
+                    // + periodo opcional en segundos. Ej: "111231005"
+                    uint8_t  mode     = TELEMETRY_MODE_PERIODIC;
+                    uint16_t period_s = TELEMETRY_DEFAULT_PERIOD_S;
+
+                    if (p_evt->params.rx_data.length > 5) {
+                        mode = (uint8_t)(message[5] - '0');
+                    }
+                    if (p_evt->params.rx_data.length > 6) {
+                        period_s = (uint16_t)atoi(&message[6]);
+                    }
+
+                    if (mode > TELEMETRY_MODE_ON_CHANGE) {
+                        NRF_LOG_RAW_INFO(
+                                   LOG_WARN " Modo de telemetria invalido: %c",
+                                   message[5]);
+                        break;
+                    }
+
+                    telemetry_subscribe((telemetry_mode_t)mode, period_s);
+                    break;
+                }
+
+                case 24: // Comando 24: Agregar emisor a la tabla
+                case 25: // Comando 25: Quitar emisor de la tabla
+                {
+                    uint8_t    mac[6];
+                    bool       agregar = (atoi(command) == 24);
+                    size_t     mac_length = p_evt->params.rx_data.length - 5;
+
+                    NRF_LOG_RAW_INFO(
+                               "\n\n\x1b[1;36m--- Comando %s recibido: %s "
+                               "emisor\x1b[0m",
+                               agregar ? "24" : "25",
+                               agregar ? "Agregar" : "Quitar");
+
+                    // "11124" / "11125" + MAC en hex, ej: "11124aabbccddeeff"
+                    if (mac_length != 12) {
+                        NRF_LOG_RAW_INFO(
+                                   LOG_WARN " Longitud de MAC invalida: %u",
+                                   mac_length);
+                        break;
+                    }
+                    for (size_t i = 0; i < 6; i++) {
+                        char byte_str[3] = {
+                                   message[5 + i * 2], message[6 + i * 2], '\0'};
+                        mac[i] = (uint8_t)strtol(byte_str, NULL, 16);
+                    }
+
+                    err_code = agregar ? emisor_table_add(mac)
+                                       : emisor_table_remove(mac);
+                    if (err_code == NRF_SUCCESS) {
+                        NRF_LOG_RAW_INFO(
+                                   LOG_OK " Emisor %02X:%02X:%02X:%02X:%02X:%02X "
+                                          "%s (%u registrados)",
+                                   mac[0],
+                                   mac[1],
+                                   mac[2],
+                                   mac[3],
+                                   mac[4],
+                                   mac[5],
+                                   agregar ? "agregado" : "quitado",
+                                   emisor_table_count());
+                    }
+                    else {
+                        NRF_LOG_RAW_INFO(
+                                   LOG_FAIL " No se pudo actualizar la tabla "
+                                            "de emisores: 0x%X",
+                                   err_code);
+                    }
+                    break;
+                }
+
+                case 26: // Comando 26: Listar emisores
+                {
+                    NRF_LOG_RAW_INFO(
+                               "\n\n\x1b[1;36m--- Comando 26 recibido: "
+                               "Listar emisores\x1b[0m");
+
+                    // [E6][n] + por emisor [indice][MAC 6 bytes][estado]
+                    static uint8_t lista[2 + EMISOR_TABLE_MAX * 8];
+                    uint16_t       position = 2;
+
+                    lista[0] = 0xE6;
+                    lista[1] = 0;
+                    for (uint8_t i = 0; i < EMISOR_TABLE_MAX; i++) {
+                        emisor_entry_t const *p_emisor = emisor_table_get(i);
+                        if (p_emisor == NULL) {
+                            continue;
+                        }
+                        lista[position++] = i;
+                        memcpy(&lista[position], p_emisor->mac, 6);
+                        position += 6;
+                        lista[position++] = p_emisor->state;
+                        lista[1]++;
+                    }
+
+                    err_code = app_nus_server_send_data(lista, position);
+                    if (err_code != NRF_SUCCESS) {
+                        NRF_LOG_RAW_INFO(
+                                   LOG_FAIL " No se pudo enviar la lista de "
+                                            "emisores: 0x%X",
+                                   err_code);
+                    }
+                    break;
+                }
+
+                case 27: // Comando 27: Totales de energia
+                {
+                    NRF_LOG_RAW_INFO(
+                               "\n\n\x1b[1;36m--- Comando 27 recibido: "
+                               "Totales de energia\x1b[0m");
+
+                    // "111270": enviar y reiniciar los totales (una vez
+                    // aceptada la ultima parte)
+                    energy_frame_start(p_evt->params.rx_data.length > 5 &&
+                                       message[5] == '0');
+                    break;
+                }
+
+                case 28: // Comando 28: Difusion de historiales por advertising
+                {
+                    NRF_LOG_RAW_INFO(
+                               "\n\n\x1b[1;36m--- Comando 28 recibido: "
+                               "Difusion por advertising\x1b[0m");
+
+                    // "11128" + cantidad de historiales (0 apaga). Ej: "111284"
+                    int records = 0;
+
+                    if (p_evt->params.rx_data.length > 5) {
+                        records = atoi(&message[5]);
+                    }
+                    if (records < 0 || records > ADV_BROADCAST_MAX_RECORDS) {
+                        NRF_LOG_RAW_INFO(
+                                   LOG_WARN " Cantidad invalida: %d (maximo %u)",
+                                   records,
+                                   ADV_BROADCAST_MAX_RECORDS);
+                        break;
+                    }
+
+                    adv_broadcast_set((uint8_t)records);
+                    break;
+                }
+
                 case 99: // Comando para borrar todos los historiales
                 {
                     NRF_LOG_RAW_INFO(
@@ -1084,11 +1356,19 @@ static void nus_data_handler(ble_nus_evt_t *p_evt)
             NRF_LOG_WARNING("Mensaje demasiado largo para procesar.");
         }
     }
+    else if (p_evt->type == BLE_NUS_EVT_COMM_STARTED) {
+        // El celular habilito las notificaciones: entregar lo que quedo
+        // pendiente de ciclos sin celular conectado
+        relay_queue_drain();
+    }
     else if (p_evt->type == BLE_NUS_EVT_TX_RDY) {
         // El buffer de transmisión está listo - enviar siguiente paquete del
         // comando 15/16 si está activo También manejar el envío asíncrono de
         // historial
+        relay_on_phone_tx_ready();
+        energy_frame_send_next();
         history_send_next_packet();
+        relay_queue_drain();
     }
 }
 
@@ -1183,10 +1463,14 @@ static void on_adv_evt(ble_adv_evt_t ble_adv_evt)
 
     switch (ble_adv_evt) {
     case BLE_ADV_EVT_FAST:
+        energy_radio_on(ENERGY_RADIO_ADV);
+        adv_broadcast_resume();
         err_code = bsp_indication_set(BSP_INDICATE_ADVERTISING);
         APP_ERROR_CHECK(err_code);
         break;
     case BLE_ADV_EVT_IDLE:
+        energy_radio_off(ENERGY_RADIO_ADV);
+        adv_broadcast_pause();
         // sleep_mode_enter();
         break;
     default:
@@ -1201,32 +1485,39 @@ void app_nus_server_ble_evt_handler(ble_evt_t const *p_ble_evt)
 
     switch (p_ble_evt->header.evt_id) {
     case BLE_GAP_EVT_CONNECTED:
+        energy_radio_on(ENERGY_RADIO_CONN);
         if (p_gap_evt->params.connected.role == BLE_GAP_ROLE_PERIPH) {
+            // El advertising se detiene al conectarse
+            energy_radio_off(ENERGY_RADIO_ADV);
+            adv_broadcast_pause();
             NRF_LOG_RAW_INFO(LOG_INFO " Celular conectado");
             m_conn_handle = p_ble_evt->evt.gap_evt.conn_handle;
             nrf_gpio_pin_set(LED2_PIN);
-            restart_extended_on_rtc();
+            power_fsm_post(PWR_EVT_PHONE_CONNECTED);
         }
         else if (p_gap_evt->params.connected.role == BLE_GAP_ROLE_CENTRAL) {
             NRF_LOG_RAW_INFO(LOG_INFO " Emisor conectado");
             m_emisor_conn_handle = p_ble_evt->evt.gap_evt.conn_handle;
             nrf_gpio_pin_set(LED3_PIN);
-
-            m_connected_this_cycle = true;
-            m_extended_mode_on     = false;
-
-            restart_on_rtc(); // Cambiar a tiempo normal
         }
+        adv_payload_changed();
 
         break;
 
     case BLE_GAP_EVT_DISCONNECTED:
+        energy_radio_off(ENERGY_RADIO_CONN);
         if (p_gap_evt->conn_handle == m_conn_handle) {
             ble_advertising_start(&m_advertising, BLE_ADV_MODE_FAST);
             NRF_LOG_RAW_INFO(LOG_INFO " Celular desconectado");
             nrf_gpio_pin_clear(LED2_PIN);
             m_conn_handle = BLE_CONN_HANDLE_INVALID; // Invalida el handle del
                                                      // celular
+            m_ble_nus_max_data_len = BLE_GATT_ATT_MTU_DEFAULT - 3;
+            m_energy_parts         = 0;
+            // La exportacion comprimida y la telemetria son por sesion
+            history_set_compression(false);
+            telemetry_unsubscribe();
+            relay_on_phone_disconnected();
         }
         else if (p_gap_evt->conn_handle == m_emisor_conn_handle) {
             NRF_LOG_RAW_INFO(LOG_INFO " Emisor desconectado");
@@ -1236,6 +1527,7 @@ void app_nus_server_ble_evt_handler(ble_evt_t const *p_ble_evt)
                        BLE_CONN_HANDLE_INVALID; // Invalida el handle del emisor
             scan_start();
         }
+        adv_payload_changed();
         break;
 
     case BLE_GAP_EVT_PHY_UPDATE_REQUEST:
@@ -1289,6 +1581,29 @@ void app_nus_server_ble_evt_handler(ble_evt_t const *p_ble_evt)
     }
 }
 
+uint16_t get_conn_handle(void)
+{
+    return m_conn_handle;
+}
+
+uint16_t get_emisor_conn_handle(void)
+{
+    return m_emisor_conn_handle;
+}
+
+uint16_t app_nus_server_max_data_len(void)
+{
+    return m_ble_nus_max_data_len;
+}
+
+void app_nus_server_on_mtu(uint16_t conn_handle, uint16_t max_data_len)
+{
+    // El intercambio de MTU con el emisor no cambia lo que admite el celular
+    if (conn_handle == m_conn_handle) {
+        m_ble_nus_max_data_len = max_data_len;
+    }
+}
+
 uint32_t app_nus_server_send_data(const uint8_t *data_array, uint16_t length)
 {
     return ble_nus_data_send(
@@ -1298,59 +1613,40 @@ uint32_t app_nus_server_send_data(const uint8_t *data_array, uint16_t length)
                m_conn_handle);
 }
 
+// Datos de advertising y de respuesta al escaneo. Quedan armados desde
+// advertising_init() para poder recodificarlos con cada despertar.
+static ble_advdata_manuf_data_t m_manuf_specific_data;
+static ble_advdata_t            m_advdata;
+static ble_advdata_t            m_srdata;
+
 /**@brief Function for initializing the Advertising functionality.
  */
 
 void advertising_init(void)
 {
-    uint32_t                 err_code;
-    ble_advertising_init_t   init;
-    ble_advdata_manuf_data_t manuf_specific_data;
-
-    memset(&m_beacon_info, 0, sizeof(m_beacon_info));
-    // Se modifica para tener un numero de advertising mayor a 0
-    // y poder ser procesado por la app
-    m_beacon_info[0]  = 0x30;
-    m_beacon_info[1]  = MSB_16(adc_values.contador);
-    m_beacon_info[2]  = LSB_16(adc_values.contador);
-    m_beacon_info[3]  = MSB_16(adc_values.V1); // LSB_16(adc_values.V1);
-    m_beacon_info[4]  = LSB_16(adc_values.V1);
-    m_beacon_info[5]  = MSB_16(adc_values.V2);                  // LSB_16(adc_values.V2);
-    m_beacon_info[6]  = LSB_16(adc_values.V2); 
-    m_beacon_info[7]  = 0xAB; // MSB Num. Historiales 
-    m_beacon_info[8]  = 0xAB; // LSB Num. Historiales
-    m_beacon_info[9]  = 0xAB;
-    m_beacon_info[10] = 0xAB;
-    m_beacon_info[11] = 0xAB;
-    m_beacon_info[12] = 0xAB;
-    m_beacon_info[13] = 0xAB;
-    m_beacon_info[14] = 0xAB;
-    m_beacon_info[15] = 0xAB;
-    m_beacon_info[16] = 0xAB;
-    m_beacon_info[17] = 0xAB;
-    m_beacon_info[18] = 0xAB;
-    m_beacon_info[19] = 0xAB;
-    m_beacon_info[20] = 0xAB;
-    m_beacon_info[21] = 0xAB;
-    m_beacon_info[22] = 0xAB;
-    m_beacon_info[23] = 0xFF;
+    uint32_t               err_code;
+    ble_advertising_init_t init;
 
     // Indentificador
-    manuf_specific_data.company_identifier = 0x2233;
-    manuf_specific_data.data.p_data        = (uint8_t *)m_beacon_info;
-    manuf_specific_data.data.size          = sizeof(m_beacon_info);
+    m_manuf_specific_data.company_identifier = 0x2233;
+    m_manuf_specific_data.data.p_data        = (uint8_t *)adv_payload_get();
+    m_manuf_specific_data.data.size          = ADV_PAYLOAD_SIZE;
+
+    memset(&m_advdata, 0, sizeof(m_advdata));
+    m_advdata.name_type             = BLE_ADVDATA_NO_NAME; // BLE_ADVDATA_FULL_NAME;
+    m_advdata.include_appearance    = false;
+    m_advdata.flags                 = BLE_GAP_ADV_FLAGS_LE_ONLY_LIMITED_DISC_MODE;
+    m_advdata.p_manuf_specific_data = &m_manuf_specific_data;
+
+    memset(&m_srdata, 0, sizeof(m_srdata));
+    m_srdata.uuids_complete.uuid_cnt = sizeof(m_adv_uuids) / sizeof(m_adv_uuids[0]);
+    m_srdata.uuids_complete.p_uuids  = m_adv_uuids;
 
     memset(&init, 0, sizeof(init));
 
-    init.advdata.name_type = BLE_ADVDATA_NO_NAME; // BLE_ADVDATA_FULL_NAME;
-    init.advdata.include_appearance = false;
-    init.advdata.flags = BLE_GAP_ADV_FLAGS_LE_ONLY_LIMITED_DISC_MODE;
+    init.advdata                               = m_advdata;
+    init.srdata                                = m_srdata;
     init.config.ble_adv_on_disconnect_disabled = true;
-    init.advdata.p_manuf_specific_data         = &manuf_specific_data;
-
-    init.srdata.uuids_complete.uuid_cnt =
-               sizeof(m_adv_uuids) / sizeof(m_adv_uuids[0]);
-    init.srdata.uuids_complete.p_uuids = m_adv_uuids;
 
     init.config.ble_adv_fast_enabled   = true;
     init.config.ble_adv_fast_interval  = APP_ADV_INTERVAL;
@@ -1363,6 +1659,23 @@ void advertising_init(void)
     ble_advertising_conn_cfg_tag_set(&m_advertising, APP_BLE_CONN_CFG_TAG);
 }
 
+void advertising_payload_set(uint8_t const *p_data, uint16_t size)
+{
+    ret_code_t err_code;
+
+    m_manuf_specific_data.data.p_data = (uint8_t *)p_data;
+    m_manuf_specific_data.data.size   = size;
+
+    // La libreria codifica en el buffer que no esta en uso y lo entrega a la
+    // SoftDevice: no hace falta volver a ble_advertising_init(). Se pasan
+    // ambos bloques porque un NULL deja sin respuesta al escaneo.
+    err_code = ble_advertising_advdata_update(&m_advertising, &m_advdata, &m_srdata);
+    if (err_code != NRF_SUCCESS) {
+        NRF_LOG_RAW_INFO(LOG_FAIL " No se pudo actualizar el advertising: 0x%08X",
+                         err_code);
+    }
+}
+
 /**@brief Function for starting advertising.
  */
 void advertising_start(void)
@@ -1381,6 +1694,8 @@ void advertising_start(void)
 void advertising_stop(void)
 {
     sd_ble_gap_adv_stop(m_advertising.adv_handle);
+    energy_radio_off(ENERGY_RADIO_ADV);
+    adv_broadcast_pause();
 }
 
 void disconnect_all_devices(void)
@@ -1392,9 +1707,12 @@ void disconnect_all_devices(void)
                    m_conn_handle,
                    BLE_HCI_REMOTE_USER_TERMINATED_CONNECTION);
         APP_ERROR_CHECK(err_code);
-        m_conn_handle = BLE_CONN_HANDLE_INVALID;
+        m_conn_handle          = BLE_CONN_HANDLE_INVALID;
+        m_ble_nus_max_data_len = BLE_GATT_ATT_MTU_DEFAULT - 3;
         NRF_LOG_RAW_INFO(LOG_INFO " Celular desconectado");
         nrf_gpio_pin_clear(LED2_PIN);
+        history_set_compression(false);
+        telemetry_unsubscribe();
     }
 
     if (m_emisor_conn_handle != BLE_CONN_HANDLE_INVALID) {
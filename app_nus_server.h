@@ -8,12 +8,16 @@
 
 typedef void (*app_nus_server_on_data_received_t)(const uint8_t *data_ptr, uint16_t data_length);
 uint32_t app_nus_server_send_data(const uint8_t *data_array, uint16_t length);
+uint16_t app_nus_server_max_data_len(void); // Bytes por notificacion al celular
+void     app_nus_server_on_mtu(uint16_t conn_handle, uint16_t max_data_len);
 void     app_nus_server_ble_evt_handler(ble_evt_t const *p_ble_evt);
 void     app_nus_server_init(app_nus_server_on_data_received_t on_data_received);
 void     advertising_stop(void);
 void     advertising_init(void);
+void     advertising_payload_set(uint8_t const *p_data, uint16_t size); // Sin reiniciar
 void     advertising_start(void);
 void     disconnect_all_devices(void);
 uint16_t get_conn_handle(void);
+uint16_t get_emisor_conn_handle(void);
 
 #endif
\ No newline at end of file
@@ -1,106 +1,124 @@
 #include "calendar.h"
+#include "duty_adapt.h"
 #include "filesystem.h"
+#include "rendezvous.h"
+#include "rtc_timer.h"
 
-static volatile bool m_tick_flag   = false;
-static volatile bool m_initialized = false;
-datetime_t           m_time        = {0};
+// Hora = m_base_seconds + (ticks de rtc_timer - m_base_ticks) / RTC_TIMER_FREQ_HZ
+static volatile bool m_initialized  = false;
+static bool          m_time_valid   = false;
+static uint32_t      m_base_seconds = 0; // Segundos desde 2000 en m_base_ticks
+static uint64_t      m_base_ticks   = 0;
+static uint8_t       m_tick_users   = 0;
 
 void                 restart_sleep_rtc(void)
 {
-    uint32_t current_counter = nrfx_rtc_counter_get(&m_rtc);
     uint32_t sleep_time_from_flash =
         read_time_from_flash(TIEMPO_SLEEP, DEFAULT_DEVICE_SLEEP_TIME_MS);
-    uint32_t next_event = (current_counter + (sleep_time_from_flash / 1000) * 8) & 0xFFFFFF;
-    nrfx_rtc_cc_set(&m_rtc, 1, next_event, true);
+    rtc_timer_start(RTC_TIMER_SLEEP,
+                    rendezvous_sleep_ms(sleep_time_from_flash) + duty_adapt_take_shift_ms());
 }
 
 void restart_on_rtc(void)
 {
-    uint32_t current_counter = nrfx_rtc_counter_get(&m_rtc);
-    uint32_t read_time       = read_time_from_flash(TIEMPO_ENCENDIDO, DEFAULT_DEVICE_ON_TIME_MS);
-    uint32_t next_event = (current_counter + (read_time / 1000) * 8) & 0xFFFFFF;
-    nrfx_rtc_cc_set(&m_rtc, 0, next_event, true);
+    uint32_t read_time = read_time_from_flash(TIEMPO_ENCENDIDO, DEFAULT_DEVICE_ON_TIME_MS);
+    rtc_timer_start(RTC_TIMER_ON, read_time);
+}
+
+void restart_wake_on_rtc(void)
+{
+    rtc_timer_start(RTC_TIMER_ON, duty_adapt_on_ms());
 }
 
 void restart_extended_on_rtc(void)
 {
-    uint32_t current_counter = nrfx_rtc_counter_get(&m_rtc);
     uint32_t read_time =
         read_time_from_flash(TIEMPO_EXTENDED_ENCENDIDO, DEFAULT_DEVICE_EXTENDED_ON_TIME_MS);
-    uint32_t next_event = (current_counter + (read_time / 1000) * 8) & 0xFFFFFF;
-    nrfx_rtc_cc_set(&m_rtc, 0, next_event, true);
+    rtc_timer_start(RTC_TIMER_ON, read_time);
 }
 
 void restart_extended_sleep_rtc(void)
 {
-    uint32_t current_counter = nrfx_rtc_counter_get(&m_rtc);
     uint32_t extended_sleep_time_from_flash =
         read_time_from_flash(TIEMPO_EXTENDED_SLEEP, DEFAULT_DEVICE_EXTENDED_SLEEP_TIME_MS);
     // NRF_LOG_RAW_INFO("\n\t>> Tiempo de sleep: %u ms", sleep_time_from_flash);
-    uint32_t next_event =
-        (current_counter + (extended_sleep_time_from_flash / 1000) * 8) & 0xFFFFFF;
-    nrfx_rtc_cc_set(&m_rtc, 1, next_event, true);
+    rtc_timer_start(RTC_TIMER_SLEEP, rendezvous_sleep_ms(extended_sleep_time_from_flash));
 }
 
-static inline bool is_leap_year(uint16_t year)
+// Segundos desde 2000 y octavos de segundo a partir de una sola lectura del RTC
+static uint32_t calendar_now(uint8_t *p_eighths)
 {
-    return ((year % 4 == 0) && (year % 100 != 0)) || (year % 400 == 0);
+    uint64_t elapsed = rtc_timer_ticks() - m_base_ticks;
+
+    if (p_eighths != NULL)
+    {
+        *p_eighths = (uint8_t)((elapsed % RTC_TIMER_FREQ_HZ) * 8 / RTC_TIMER_FREQ_HZ);
+    }
+    return m_base_seconds + (uint32_t)(elapsed / RTC_TIMER_FREQ_HZ);
 }
 
-static const uint8_t days_in_month[12] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+uint32_t calendar_get_timestamp(uint8_t *p_eighths)
+{
+    if (!m_time_valid)
+    {
+        if (p_eighths != NULL)
+        {
+            *p_eighths = 0;
+        }
+        return TIMESTAMP_INVALID;
+    }
+    return calendar_now(p_eighths);
+}
 
-static bool is_valid_datetime(const datetime_t *dt)
+void calendar_tick_request(void)
 {
-    if (dt == NULL) return false;
-    
-    // Verificar rangos básicos
-    if (dt->year < 2000 || dt->year > 2099) return false;
-    if (dt->month < 1 || dt->month > 12) return false;
-    if (dt->hour > 23 || dt->minute > 59 || dt->second > 59) return false;
-    
-    // Verificar día válido para el mes
-    uint8_t max_day = (dt->month == 2) ? (is_leap_year(dt->year) ? 29 : 28) : days_in_month[dt->month - 1];
-    if (dt->day < 1 || dt->day > max_day) return false;
-    
-    return true;
+    if (m_tick_users++ == 0)
+    {
+        // Primer tick en el proximo cambio de segundo
+        uint64_t elapsed = rtc_timer_ticks() - m_base_ticks;
+
+        rtc_timer_start_periodic(
+            RTC_TIMER_SECOND,
+            1000 - (uint32_t)RTC_TIMER_TICKS_TO_MS(elapsed % RTC_TIMER_FREQ_HZ),
+            1000);
+    }
 }
 
-void                 calendar_rtc_handler(void)
+void calendar_tick_release(void)
 {
-    m_tick_flag  = true;
-    uint32_t cnt = nrfx_rtc_counter_get(&m_rtc);
-    nrfx_rtc_cc_set(&m_rtc, RTC_CHANNEL, (cnt + 8) & RTC_COUNTER_COUNTER_Msk, true);
+    if (m_tick_users > 0 && --m_tick_users == 0)
+    {
+        rtc_timer_stop(RTC_TIMER_SECOND);
+    }
 }
 
 bool calendar_set_time(const datetime_t *now)
 {
+    uint32_t seconds;
+
     if (!m_initialized || now == NULL)
     {
         return false;
     }
-    // Validate fields
-    uint8_t max_day =
-        (now->month == 2) ? (is_leap_year(now->year) ? 29 : 28) : days_in_month[now->month - 1];
-    if (now->month < 1 || now->month > 12 || now->day < 1 || now->day > max_day || now->hour > 23 ||
-        now->minute > 59 || now->second > 59)
+    seconds = timestamp_from_datetime(now); // Valida la fecha
+    if (seconds == TIMESTAMP_INVALID)
     {
         return false;
     }
 
-    nrfx_rtc_disable(&m_rtc);
-    memcpy(&m_time, now, sizeof(m_time));
-    nrfx_rtc_counter_clear(&m_rtc);
-    nrfx_rtc_cc_set(&m_rtc, RTC_CHANNEL, 1, true);
-    nrfx_rtc_enable(&m_rtc);
+    // Solo se guarda la base; la hora se calcula al pedirla. El contador del
+    // RTC no se toca para no mover los plazos del ciclo de encendido.
+    m_base_seconds = seconds;
+    m_base_ticks   = rtc_timer_ticks();
+    m_time_valid   = true;
 
-    return true;
+    return m_time_valid;
 }
 
 bool calendar_init(void)
 {
 
     NRF_LOG_RAW_INFO(LOG_EXEC " Iniciando modulo RTC...");
-    ret_code_t err_code;
 
     if (m_initialized)
     {
@@ -110,10 +128,8 @@ bool calendar_init(void)
         return false;
     }
 
-    nrfx_rtc_cc_set(&m_rtc, RTC_CHANNEL, 8, true);
-
-    memset(&m_time, 0, sizeof(m_time));
-
+    m_time_valid  = false;
+    m_tick_users  = 0;
     m_initialized = true;
 
     NRF_LOG_RAW_INFO(LOG_OK " Modulo RTC inicializado correctamente");
@@ -128,46 +144,13 @@ bool calendar_get_time(datetime_t *now)
     {
         return false;
     }
-    memcpy(now, &m_time, sizeof(m_time));
-    return true;
-}
-
-void calendar_update(void)
-{
-    if (!m_initialized || !m_tick_flag)
-    {
-        return;
-    }
-    m_tick_flag = false;
-
-    // Increment seconds
-    if (++m_time.second > 59)
+    if (!m_time_valid)
     {
-        m_time.second = 0;
-
-        if (++m_time.minute > 59)
-        {
-
-            m_time.minute = 0;
-
-            if (++m_time.hour > 23)
-            {
-                m_time.hour = 0;
-                // Day rollover
-                uint8_t dim = (m_time.month == 2) ? (is_leap_year(m_time.year) ? 29 : 28)
-                                                  : days_in_month[m_time.month - 1];
-                if (++m_time.day > dim)
-                {
-                    m_time.day = 1;
-                    if (++m_time.month > 12)
-                    {
-                        m_time.month = 1;
-                        m_time.year++;
-                    }
-                }
-            }
-        }
+        memset(now, 0, sizeof(datetime_t));
+        return true;
     }
+    timestamp_to_datetime(calendar_now(NULL), now);
+    return true;
 }
 
 bool calendar_set_datetime(void)
@@ -177,9 +160,9 @@ bool calendar_set_datetime(void)
     const char* source = "";
 
     // Prioridad 1: Intentar usar config_repeater.fecha si es válida
-    if (is_valid_datetime(&config_repeater.fecha))
+    if (config_repeater.fecha != TIMESTAMP_INVALID)
     {
-        dt = config_repeater.fecha;
+        timestamp_to_datetime(config_repeater.fecha, &dt);
         source = "config_repeater";
         success = calendar_set_time(&dt);
         
@@ -200,7 +183,7 @@ bool calendar_set_datetime(void)
         source = "memoria flash";
         
         // read_date_from_flash() retorna una fecha válida si existe, o valores cero si no existe
-        if (is_valid_datetime(&dt))
+        if (timestamp_is_valid(&dt))
         {
             success = calendar_set_time(&dt);
             
@@ -8,35 +8,36 @@
 #include "fds.h"
 // #include "filesystem.h"
 #include "nrf_drv_clock.h"
-#include "nrfx_rtc.h"
+#include "timestamp.h"
 #include "variables.h"
 #include <stdbool.h>
 #include <string.h>
 
-#define RTC_CHANNEL 2
-
-typedef struct {
-  uint16_t year;
-  uint8_t month;
-  uint8_t day;
-  uint8_t hour;
-  uint8_t minute;
-  uint8_t second;
-} datetime_t;
-
-extern datetime_t m_time;
-extern nrfx_rtc_t m_rtc;
-
 bool calendar_init(void);
 bool calendar_set_time(const datetime_t *now);
 bool calendar_get_time(datetime_t *now);
-void calendar_update(void);
-void calendar_rtc_handler(void);
 bool calendar_set_datetime(void);
 
+// La hora no se lleva con una interrupcion por segundo: calendar_set_time()
+// guarda la base y cada consulta la calcula desde el contador de rtc_timer.
+
+/**@brief Segundos desde 2000 (TIMESTAMP_INVALID sin hora cargada).
+ *
+ * @param[out] p_eighths  Octavos del segundo actual (0..7), puede ser NULL.
+ */
+uint32_t calendar_get_timestamp(uint8_t *p_eighths);
+
+// Tick de 1 Hz alineado con el segundo del calendario (RTC_TIMER_SECOND),
+// armado solo mientras alguien lo pida
+void calendar_tick_request(void);
+void calendar_tick_release(void);
+
 void restart_on_rtc(void);
 void restart_sleep_rtc(void);
 
+// Ventana ON al despertar en modo normal (adaptativa, ver duty_adapt.h)
+void restart_wake_on_rtc(void);
+
 
 void restart_extended_on_rtc(void);
 void restart_extended_sleep_rtc(void);
@@ -0,0 +1,234 @@
+#include "cmd_sequencer.h"
+
+#include <string.h>
+
+#include "app_error.h"
+#include "app_nus_client.h"
+#include "app_timer.h"
+#include "nrf_log.h"
+#include "variables.h"
+
+APP_TIMER_DEF(m_cmd_seq_timer);
+
+typedef struct
+{
+    uint8_t                cmd[CMD_SEQ_MAX_CMD_LEN];
+    uint8_t                length;
+    uint8_t                expected_tag;
+    uint8_t                retries_left;
+    uint16_t               timeout_ms;
+    cmd_seq_fail_handler_t fail_handler; // NULL: ninguna
+    uint16_t               context;
+} cmd_seq_entry_t;
+
+static cmd_seq_entry_t m_queue[CMD_SEQ_QUEUE_SIZE];
+static uint8_t         m_head      = 0;
+static uint8_t         m_count     = 0;
+static bool            m_in_flight = false; // Comando enviado, esperando respuesta
+static uint32_t        m_failed    = 0;
+
+static void cmd_seq_timer_start(uint16_t ms)
+{
+    (void)app_timer_stop(m_cmd_seq_timer);
+    ret_code_t err_code = app_timer_start(m_cmd_seq_timer, APP_TIMER_TICKS(ms), NULL);
+    APP_ERROR_CHECK(err_code);
+}
+
+static void cmd_seq_pop(void)
+{
+    m_head      = (m_head + 1) % CMD_SEQ_QUEUE_SIZE;
+    m_count--;
+    m_in_flight = false;
+}
+
+// Envia el comando en la cabeza de la cola. Los comandos sin respuesta se
+// liberan en cuanto el stack los acepta.
+static void cmd_seq_send_head(void)
+{
+    while (m_count > 0 && !m_in_flight)
+    {
+        cmd_seq_entry_t *p_entry  = &m_queue[m_head];
+        ret_code_t       err_code = app_nus_client_send_data(p_entry->cmd, p_entry->length);
+
+        if (err_code == NRF_SUCCESS)
+        {
+            if (p_entry->expected_tag == CMD_SEQ_NO_RESPONSE)
+            {
+                cmd_seq_pop();
+                continue;
+            }
+            m_in_flight = true;
+            cmd_seq_timer_start(p_entry->timeout_ms);
+        }
+        else if (err_code == NRF_ERROR_BUSY || err_code == NRF_ERROR_RESOURCES ||
+                 err_code == NRF_ERROR_NO_MEM)
+        {
+            // El stack esta ocupado: reintentar en breve sin gastar intentos
+            cmd_seq_timer_start(CMD_SEQ_BUSY_RETRY_MS);
+        }
+        else
+        {
+            // Rechazo definitivo: se descarta solo este comando, los demas
+            // siguen en la cola (la desconexion los limpia con cmd_seq_reset)
+            cmd_seq_fail_handler_t handler = p_entry->fail_handler;
+            uint16_t               context = p_entry->context;
+
+            NRF_LOG_RAW_INFO(LOG_FAIL " Comando al emisor rechazado: 0x%X", err_code);
+            m_failed++;
+            cmd_seq_pop();
+            if (handler != NULL)
+            {
+                handler(context);
+            }
+            continue;
+        }
+        break;
+    }
+}
+
+static void cmd_seq_timer_handler(void *p_context)
+{
+    UNUSED_PARAMETER(p_context);
+
+    if (m_count == 0)
+    {
+        return;
+    }
+
+    if (m_in_flight)
+    {
+        cmd_seq_entry_t *p_entry = &m_queue[m_head];
+
+        m_in_flight              = false;
+        if (p_entry->retries_left > 0)
+        {
+            p_entry->retries_left--;
+            NRF_LOG_RAW_INFO(LOG_WARN " Sin respuesta 0x%02X del emisor, reintentando",
+                             p_entry->expected_tag);
+        }
+        else
+        {
+            cmd_seq_fail_handler_t handler = p_entry->fail_handler;
+            uint16_t               context = p_entry->context;
+
+            m_failed++;
+            NRF_LOG_RAW_INFO(LOG_FAIL " Sin respuesta 0x%02X del emisor, comando descartado",
+                             p_entry->expected_tag);
+            cmd_seq_pop();
+            if (handler != NULL)
+            {
+                handler(context);
+            }
+        }
+    }
+
+    cmd_seq_send_head();
+}
+
+void cmd_seq_init(void)
+{
+    ret_code_t err_code =
+        app_timer_create(&m_cmd_seq_timer, APP_TIMER_MODE_SINGLE_SHOT, cmd_seq_timer_handler);
+    APP_ERROR_CHECK(err_code);
+}
+
+ret_code_t cmd_seq_push(uint8_t const *p_cmd,
+                        uint16_t       length,
+                        uint8_t        expected_tag,
+                        uint16_t       timeout_ms,
+                        uint8_t        retries)
+{
+    return cmd_seq_push_with_handler(p_cmd, length, expected_tag, timeout_ms, retries, NULL, 0);
+}
+
+ret_code_t cmd_seq_push_with_handler(uint8_t const         *p_cmd,
+                                     uint16_t               length,
+                                     uint8_t                expected_tag,
+                                     uint16_t               timeout_ms,
+                                     uint8_t                retries,
+                                     cmd_seq_fail_handler_t fail_handler,
+                                     uint16_t               context)
+{
+    if (p_cmd == NULL || length == 0 || length > CMD_SEQ_MAX_CMD_LEN)
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+    if (!app_nus_client_is_connected())
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    if (m_count >= CMD_SEQ_QUEUE_SIZE)
+    {
+        return NRF_ERROR_NO_MEM;
+    }
+
+    cmd_seq_entry_t *p_entry = &m_queue[(m_head + m_count) % CMD_SEQ_QUEUE_SIZE];
+    memcpy(p_entry->cmd, p_cmd, length);
+    p_entry->length       = (uint8_t)length;
+    p_entry->expected_tag = expected_tag;
+    p_entry->retries_left = retries;
+    p_entry->timeout_ms   = timeout_ms;
+    p_entry->fail_handler = fail_handler;
+    p_entry->context      = context;
+    m_count++;
+
+    // Si la cola estaba vacia se envia de inmediato
+    if (m_count == 1)
+    {
+        cmd_seq_send_head();
+    }
+
+    return NRF_SUCCESS;
+}
+
+void cmd_seq_on_response(uint8_t const *p_data, uint16_t length)
+{
+    if (!m_in_flight || m_count == 0 || length == 0)
+    {
+        return;
+    }
+
+    if (p_data[0] == m_queue[m_head].expected_tag)
+    {
+        (void)app_timer_stop(m_cmd_seq_timer);
+        cmd_seq_pop();
+        cmd_seq_send_head();
+    }
+}
+
+void cmd_seq_reset(void)
+{
+    (void)app_timer_stop(m_cmd_seq_timer);
+    m_head      = 0;
+    m_count     = 0;
+    m_in_flight = false;
+}
+
+bool cmd_seq_is_idle(void)
+{
+    return m_count == 0;
+}
+
+bool cmd_seq_is_pending(uint8_t expected_tag)
+{
+    return cmd_seq_pending_count(expected_tag) > 0;
+}
+
+uint8_t cmd_seq_pending_count(uint8_t expected_tag)
+{
+    uint8_t pending = 0;
+
+    for (uint8_t i = 0; i < m_count; i++)
+    {
+        if (m_queue[(m_head + i) % CMD_SEQ_QUEUE_SIZE].expected_tag == expected_tag)
+        {
+            pending++;
+        }
+    }
+    return pending;
+}
+
+uint32_t cmd_seq_failed_count(void)
+{
+    return m_failed;
+}
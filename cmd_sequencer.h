@@ -0,0 +1,73 @@
+#ifndef CMD_SEQUENCER_H
+#define CMD_SEQUENCER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "sdk_errors.h"
+
+// Secuenciador de comandos repetidor -> emisor.
+//
+// Los comandos se encolan y se envian de a uno: el siguiente sale recien
+// cuando llega la respuesta esperada del anterior (primer byte de la trama,
+// ej. 0x96 o 0x08) o cuando se agotan sus reintentos. Los rechazos del stack
+// (NRF_ERROR_BUSY / NRF_ERROR_RESOURCES) se reintentan sin consumir intentos.
+//
+// El temporizador (app_timer) y los eventos BLE corren con la misma prioridad
+// de interrupcion, por lo que no hace falta proteger el estado.
+
+#define CMD_SEQ_QUEUE_SIZE         8
+#define CMD_SEQ_MAX_CMD_LEN        24  // "060YYYY.MM.DD HH.MM.SS"
+#define CMD_SEQ_NO_RESPONSE        0x00 // El comando no tiene respuesta
+#define CMD_SEQ_DEFAULT_TIMEOUT_MS 1000
+#define CMD_SEQ_DEFAULT_RETRIES    2
+#define CMD_SEQ_BUSY_RETRY_MS      20   // Espera ante BUSY/RESOURCES
+
+/**@brief Se llama cuando el comando se descarta, por agotar sus reintentos
+ *        (ej. emisor con firmware que no lo soporta) o por un rechazo
+ *        definitivo del stack, con el contexto que se paso al encolarlo. El
+ *        rechazo puede ocurrir dentro de cmd_seq_push_with_handler.
+ */
+typedef void (*cmd_seq_fail_handler_t)(uint16_t context);
+
+void       cmd_seq_init(void);
+
+/**@brief Encola un comando para el emisor y lo envia si la cola estaba libre.
+ *
+ * @param[in] expected_tag Primer byte de la respuesta que cierra el comando,
+ *                         o CMD_SEQ_NO_RESPONSE.
+ *
+ * @retval NRF_ERROR_INVALID_STATE Sin conexion con un emisor.
+ * @retval NRF_ERROR_NO_MEM        Cola llena.
+ */
+ret_code_t cmd_seq_push(uint8_t const *p_cmd,
+                        uint16_t       length,
+                        uint8_t        expected_tag,
+                        uint16_t       timeout_ms,
+                        uint8_t        retries);
+
+/**@brief Igual que cmd_seq_push, con una funcion propia del comando para
+ *        cuando se descarta. Se puede encolar otro comando desde ella.
+ */
+ret_code_t cmd_seq_push_with_handler(uint8_t const         *p_cmd,
+                                     uint16_t               length,
+                                     uint8_t                expected_tag,
+                                     uint16_t               timeout_ms,
+                                     uint8_t                retries,
+                                     cmd_seq_fail_handler_t fail_handler,
+                                     uint16_t               context);
+
+/**@brief Notifica una trama recibida del emisor. Si es la respuesta esperada
+ *        se libera el comando en curso y se envia el siguiente.
+ */
+void       cmd_seq_on_response(uint8_t const *p_data, uint16_t length);
+
+/**@brief Descarta los comandos pendientes (desconexion del emisor). */
+void       cmd_seq_reset(void);
+
+bool       cmd_seq_is_idle(void);
+bool       cmd_seq_is_pending(uint8_t expected_tag);
+uint8_t    cmd_seq_pending_count(uint8_t expected_tag);
+uint32_t   cmd_seq_failed_count(void);
+
+#endif // CMD_SEQUENCER_H
@@ -0,0 +1,180 @@
+#include "duty_adapt.h"
+
+#include <string.h>
+
+#include "filesystem.h"
+#include "nordic_common.h"
+#include "nrf_log.h"
+#include "rendezvous.h"
+#include "rtc_timer.h"
+#include "variables.h"
+
+#define OUTCOME_CONN  0x01
+#define OUTCOME_ADV   0x02
+
+typedef struct
+{
+    uint8_t  flags;
+    uint32_t ttc_ms; // Despertar -> primer contacto
+} outcome_t;
+
+static outcome_t m_window[DUTY_ADAPT_WINDOW];
+static uint8_t   m_head      = 0;
+static uint8_t   m_count     = 0;
+
+// Ciclo en curso
+static uint64_t  m_wake_tick = 0;
+static bool      m_extended  = false;
+static uint8_t   m_flags     = 0;
+static uint32_t  m_ttc_ms    = 0;
+
+static uint32_t  m_on_ms     = 0; // 0: tiempo configurado
+static uint32_t  m_cfg_on_ms = 0; // Configurado cuando se decidio m_on_ms
+static uint32_t  m_shift_ms  = 0;
+
+static uint32_t configured_on_ms(void)
+{
+    return read_time_from_flash(TIEMPO_ENCENDIDO, DEFAULT_DEVICE_ON_TIME_MS);
+}
+
+static void window_clear(void)
+{
+    m_head  = 0;
+    m_count = 0;
+}
+
+static void window_push(uint8_t flags, uint32_t ttc_ms)
+{
+    m_window[m_head].flags  = flags;
+    m_window[m_head].ttc_ms = ttc_ms;
+    m_head                  = (m_head + 1) % DUTY_ADAPT_WINDOW;
+    m_count                 = MIN(m_count + 1, DUTY_ADAPT_WINDOW);
+}
+
+// Contactos en la ventana y su tiempo minimo y maximo
+static uint8_t window_contacts(uint32_t *p_min_ms, uint32_t *p_max_ms)
+{
+    uint8_t contacts = 0;
+
+    *p_min_ms = UINT32_MAX;
+    *p_max_ms = 0;
+    for (uint8_t i = 0; i < m_count; i++)
+    {
+        if (m_window[i].flags == 0)
+        {
+            continue;
+        }
+        contacts++;
+        *p_min_ms = MIN(*p_min_ms, m_window[i].ttc_ms);
+        *p_max_ms = MAX(*p_max_ms, m_window[i].ttc_ms);
+    }
+    return contacts;
+}
+
+void duty_adapt_init(void)
+{
+    window_clear();
+    m_flags    = 0;
+    m_on_ms    = 0;
+    m_shift_ms = 0;
+    duty_adapt_on_wake(false);
+}
+
+void duty_adapt_on_wake(bool extended)
+{
+    m_wake_tick = rtc_timer_ticks();
+    m_extended  = extended;
+    m_flags     = 0;
+    m_ttc_ms    = 0;
+}
+
+void duty_adapt_on_contact(duty_adapt_contact_t contact)
+{
+    if (m_flags == 0)
+    {
+        m_ttc_ms = (uint32_t)RTC_TIMER_TICKS_TO_MS(rtc_timer_ticks() - m_wake_tick);
+    }
+    m_flags |= (contact == DUTY_ADAPT_CONTACT_CONN) ? OUTCOME_CONN : OUTCOME_ADV;
+}
+
+void duty_adapt_on_cycle_end(void)
+{
+    uint32_t           on_ms  = m_extended ? 0 : duty_adapt_on_ms();
+    uint32_t           before = duty_adapt_on_ms();
+    uint32_t           min_ttc;
+    uint32_t           max_ttc;
+    uint8_t            contacts;
+    char               decision = '=';
+    rendezvous_stats_t rdv;
+
+    window_push(m_flags, m_ttc_ms);
+    contacts = window_contacts(&min_ttc, &max_ttc);
+    rendezvous_stats_get(&rdv);
+
+    if (m_flags == 0)
+    {
+        m_on_ms  = 0;
+        decision = 'M';
+    }
+    else if (on_ms > 0 && m_ttc_ms > on_ms / 100 * DUTY_ADAPT_LATE_PCT)
+    {
+        uint32_t max_on = MAX(configured_on_ms(),
+                              read_time_from_flash(TIEMPO_EXTENDED_ENCENDIDO,
+                                                   DEFAULT_DEVICE_EXTENDED_ON_TIME_MS));
+
+        m_on_ms  = MIN(on_ms + on_ms / 2, max_on);
+        decision = 'L';
+    }
+    else if (on_ms > 0 && m_count == DUTY_ADAPT_WINDOW && contacts >= DUTY_ADAPT_MIN_SUCCESS)
+    {
+        uint32_t target = max_ttc + MAX(DUTY_ADAPT_MARGIN_MS, max_ttc / 2);
+
+        if (!rdv.locked && min_ttc > 2 * DUTY_ADAPT_MARGIN_MS)
+        {
+            // El emisor llega siempre tarde: despertar despues. Los tiempos
+            // guardados quedan corridos, se empieza de nuevo.
+            m_shift_ms = min_ttc - DUTY_ADAPT_MARGIN_MS;
+            window_clear();
+            decision = 'D';
+        }
+        else if (target < on_ms)
+        {
+            m_on_ms  = MAX(MAX(target, on_ms - on_ms / 4), DUTY_ADAPT_ON_MIN_MS);
+            decision = (m_on_ms < on_ms) ? 'S' : '=';
+        }
+    }
+    m_cfg_on_ms = configured_on_ms();
+
+    NRF_LOG_RAW_INFO(LOG_INFO " Adapt %c: con=%u adv=%u t=%u ms, %u/%u contactos, "
+                              "ON %u->%u ms, corrimiento %u ms",
+                     decision,
+                     (m_flags & OUTCOME_CONN) ? 1 : 0,
+                     (m_flags & OUTCOME_ADV) ? 1 : 0,
+                     m_ttc_ms,
+                     contacts,
+                     m_count,
+                     before,
+                     duty_adapt_on_ms(),
+                     m_shift_ms);
+}
+
+uint32_t duty_adapt_on_ms(void)
+{
+    uint32_t configured = configured_on_ms();
+
+    // Un cambio de configuracion (comando 04) descarta lo aprendido
+    if (m_on_ms != 0 && configured != m_cfg_on_ms)
+    {
+        m_on_ms = 0;
+        window_clear();
+    }
+    return (m_on_ms != 0) ? m_on_ms : configured;
+}
+
+uint32_t duty_adapt_take_shift_ms(void)
+{
+    uint32_t shift = m_shift_ms;
+
+    m_shift_ms = 0;
+    return shift;
+}
@@ -0,0 +1,61 @@
+#ifndef DUTY_ADAPT_H
+#define DUTY_ADAPT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Ventana ON adaptativa segun el historial de contactos con el emisor.
+//
+// De cada ciclo se guarda si hubo conexion, si se capturo un ADV y el tiempo
+// desde el despertar hasta el primer contacto, en una ventana deslizante de
+// DUTY_ADAPT_WINDOW ciclos. Al cerrar cada ciclo se decide la ventana ON del
+// proximo despertar en modo normal:
+//
+//   M  sin contacto: vuelve al tiempo configurado (comando 04)
+//   L  contacto tardio (pasado DUTY_ADAPT_LATE_PCT de la ventana): se alarga
+//      un 50%, hasta el tiempo extendido configurado (comando 10)
+//   D  contactos confiables pero siempre tarde y sin cita con el emisor
+//      (rendezvous): el proximo sleep se alarga para correr la ventana
+//   S  contactos confiables y tempranos: se acorta hasta un 25% por ciclo,
+//      sin bajar de DUTY_ADAPT_ON_MIN_MS ni del contacto mas tardio mas
+//      un margen
+//   =  sin cambios
+//
+// Cada decision deja una linea en el log con esa letra. La ventana que se
+// reinicia con cada conexion y los tiempos del modo extendido no cambian.
+
+#define DUTY_ADAPT_WINDOW       8
+#define DUTY_ADAPT_MIN_SUCCESS  7     // Contactos en la ventana para acortar o correr
+#define DUTY_ADAPT_MARGIN_MS    2000
+// La busqueda extendida (power_fsm) ocupa los ultimos EXTENDED_SEARCH_MS
+// (variables.h) de la ventana; con una ventana mas corta no se programa y un
+// ciclo sin contacto se queda sin ese respaldo
+#define DUTY_ADAPT_ON_MIN_MS    (EXTENDED_SEARCH_MS + DUTY_ADAPT_MARGIN_MS)
+#define DUTY_ADAPT_LATE_PCT     75
+
+typedef enum
+{
+    DUTY_ADAPT_CONTACT_CONN = 0, // Conexion con el emisor
+    DUTY_ADAPT_CONTACT_ADV,      // ADV capturado en la busqueda extendida
+} duty_adapt_contact_t;
+
+void     duty_adapt_init(void);
+
+/**@brief Inicio de la ventana ON. */
+void     duty_adapt_on_wake(bool extended);
+
+/**@brief Contacto con el emisor. Solo cuenta el primero de cada tipo por
+ *        ciclo; el tiempo hasta el contacto se mide con el primero.
+ */
+void     duty_adapt_on_contact(duty_adapt_contact_t contact);
+
+/**@brief Fin de la ventana ON: registra el ciclo y decide la proxima. */
+void     duty_adapt_on_cycle_end(void);
+
+/**@brief Ventana ON para el despertar en modo normal (ms). */
+uint32_t duty_adapt_on_ms(void);
+
+/**@brief Sleep adicional pedido por una decision D. Se consume al leerlo. */
+uint32_t duty_adapt_take_shift_ms(void);
+
+#endif // DUTY_ADAPT_H
@@ -0,0 +1,286 @@
+#include "emisor_table.h"
+
+#include <string.h>
+
+#include "fds.h"
+#include "filesystem.h"
+#include "nrf_log.h"
+#include "variables.h"
+
+// Registro en flash: solo las MACs de los emisores secundarios (slots 1..N).
+// Un slot vacio tiene la MAC en cero. Los slots no se compactan para que cada
+// emisor conserve su FILE_ID de historiales.
+typedef struct
+{
+    uint16_t magic;
+    uint16_t reserved;
+    uint8_t  mac[EMISOR_TABLE_MAX - 1][6];
+} emisor_table_record_t;
+
+static emisor_entry_t        m_entries[EMISOR_TABLE_MAX];
+static bool                  m_used[EMISOR_TABLE_MAX];
+static uint8_t               m_current      = 0;
+static uint8_t               m_window_start = 0; // Primer emisor de la ventana
+static emisor_table_record_t m_record; // Buffer estático para la escritura en FDS
+
+static bool mac_is_empty(uint8_t const *p_mac)
+{
+    for (uint8_t i = 0; i < 6; i++)
+    {
+        if (p_mac[i] != 0)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void entry_set(uint8_t slot, uint8_t const *p_mac)
+{
+    memset(&m_entries[slot], 0, sizeof(emisor_entry_t));
+    memcpy(m_entries[slot].mac, p_mac, 6);
+    m_entries[slot].history_file_id =
+        (slot == 0) ? HISTORY_FILE_ID : (uint16_t)(EMISOR_HISTORY_FILE_ID_BASE + slot);
+    m_entries[slot].last_contador = 0;
+    m_entries[slot].conn_handle   = BLE_CONN_HANDLE_INVALID;
+    m_entries[slot].state         = EMISOR_STATE_PENDING;
+    m_used[slot]                  = true;
+}
+
+static ret_code_t emisor_table_save(void)
+{
+    fds_record_desc_t desc  = {0};
+    fds_find_token_t  token = {0};
+    ret_code_t        ret;
+
+    memset(&m_record, 0, sizeof(m_record));
+    m_record.magic = MAGIC_PASSWORD;
+    for (uint8_t slot = 1; slot < EMISOR_TABLE_MAX; slot++)
+    {
+        if (m_used[slot])
+        {
+            memcpy(m_record.mac[slot - 1], m_entries[slot].mac, 6);
+        }
+    }
+
+    fds_record_t record = {
+        .file_id           = EMISOR_TABLE_FILE_ID,
+        .key               = EMISOR_TABLE_RECORD_KEY,
+        .data.p_data       = &m_record,
+        .data.length_words = BYTES_TO_WORDS(sizeof(emisor_table_record_t))};
+
+    if (fds_record_find(EMISOR_TABLE_FILE_ID, EMISOR_TABLE_RECORD_KEY, &desc, &token) ==
+        NRF_SUCCESS)
+    {
+        ret = fds_record_update(&desc, &record);
+    }
+    else
+    {
+        ret = fds_record_write(&desc, &record);
+    }
+
+    if (ret != NRF_SUCCESS)
+    {
+        NRF_LOG_RAW_INFO(LOG_FAIL " Error al guardar la tabla de emisores: 0x%X", ret);
+    }
+    return ret;
+}
+
+void emisor_table_init(void)
+{
+    fds_record_desc_t desc  = {0};
+    fds_find_token_t  token = {0};
+
+    memset(m_used, 0, sizeof(m_used));
+
+    // Emisor principal, desde la configuracion
+    entry_set(0, config_repeater.mac_emisor);
+
+    if (fds_record_find(EMISOR_TABLE_FILE_ID, EMISOR_TABLE_RECORD_KEY, &desc, &token) ==
+        NRF_SUCCESS)
+    {
+        fds_flash_record_t flash_record = {0};
+        if (fds_record_open(&desc, &flash_record) == NRF_SUCCESS)
+        {
+            emisor_table_record_t const *p_record = flash_record.p_data;
+            if (flash_record.p_header->length_words ==
+                    BYTES_TO_WORDS(sizeof(emisor_table_record_t)) &&
+                p_record->magic == MAGIC_PASSWORD)
+            {
+                for (uint8_t slot = 1; slot < EMISOR_TABLE_MAX; slot++)
+                {
+                    if (!mac_is_empty(p_record->mac[slot - 1]))
+                    {
+                        entry_set(slot, p_record->mac[slot - 1]);
+                    }
+                }
+            }
+            fds_record_close(&desc);
+        }
+    }
+
+    NRF_LOG_RAW_INFO(LOG_INFO " Emisores registrados: %u", emisor_table_count());
+}
+
+uint8_t emisor_table_count(void)
+{
+    uint8_t count = 0;
+    for (uint8_t slot = 0; slot < EMISOR_TABLE_MAX; slot++)
+    {
+        count += m_used[slot] ? 1 : 0;
+    }
+    return count;
+}
+
+emisor_entry_t *emisor_table_get(uint8_t index)
+{
+    if (index >= EMISOR_TABLE_MAX || !m_used[index])
+    {
+        return NULL;
+    }
+    return &m_entries[index];
+}
+
+static int8_t find_by_mac(uint8_t const *p_mac)
+{
+    for (uint8_t slot = 0; slot < EMISOR_TABLE_MAX; slot++)
+    {
+        if (m_used[slot] && memcmp(m_entries[slot].mac, p_mac, 6) == 0)
+        {
+            return (int8_t)slot;
+        }
+    }
+    return -1;
+}
+
+ret_code_t emisor_table_add(uint8_t const *p_mac)
+{
+    if (p_mac == NULL || mac_is_empty(p_mac))
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+    if (find_by_mac(p_mac) >= 0)
+    {
+        return NRF_SUCCESS; // Ya registrado
+    }
+
+    for (uint8_t slot = 1; slot < EMISOR_TABLE_MAX; slot++)
+    {
+        if (!m_used[slot])
+        {
+            entry_set(slot, p_mac);
+            // Se atiende recien desde la proxima ventana
+            m_entries[slot].state = EMISOR_STATE_SERVED;
+            return emisor_table_save();
+        }
+    }
+
+    return NRF_ERROR_NO_MEM;
+}
+
+ret_code_t emisor_table_remove(uint8_t const *p_mac)
+{
+    int8_t slot = find_by_mac(p_mac);
+
+    if (slot < 0)
+    {
+        return NRF_ERROR_NOT_FOUND;
+    }
+    if (slot == 0)
+    {
+        // El principal se cambia con el comando 01
+        return NRF_ERROR_FORBIDDEN;
+    }
+
+    m_used[slot] = false;
+    (void)fds_file_delete(m_entries[slot].history_file_id);
+
+    return emisor_table_save();
+}
+
+int8_t emisor_table_find_by_addr(ble_gap_addr_t const *p_addr)
+{
+    uint8_t mac[6];
+
+    // BLE entrega la direccion con el LSB primero
+    for (uint8_t i = 0; i < 6; i++)
+    {
+        mac[i] = p_addr->addr[5 - i];
+    }
+    return find_by_mac(mac);
+}
+
+static uint8_t next_used_slot(uint8_t slot)
+{
+    for (uint8_t step = 1; step <= EMISOR_TABLE_MAX; step++)
+    {
+        uint8_t next = (slot + step) % EMISOR_TABLE_MAX;
+        if (m_used[next])
+        {
+            return next;
+        }
+    }
+    return 0; // El principal siempre esta
+}
+
+void emisor_table_begin_window(void)
+{
+    uint8_t start = next_used_slot(m_window_start);
+
+    // La MAC principal puede haber cambiado con el comando 01
+    memcpy(m_entries[0].mac, config_repeater.mac_emisor, 6);
+
+    // Si la ventana anterior no llego a buscar a todos, se retoma por el
+    // primero que quedo pendiente; si no, se rota el primero
+    for (uint8_t step = 0; step < EMISOR_TABLE_MAX; step++)
+    {
+        uint8_t slot = (m_current + step) % EMISOR_TABLE_MAX;
+        if (m_used[slot] && m_entries[slot].state == EMISOR_STATE_PENDING)
+        {
+            start = slot;
+            break;
+        }
+    }
+
+    for (uint8_t slot = 0; slot < EMISOR_TABLE_MAX; slot++)
+    {
+        m_entries[slot].state       = EMISOR_STATE_PENDING;
+        m_entries[slot].conn_handle = BLE_CONN_HANDLE_INVALID;
+    }
+    m_current      = start;
+    m_window_start = start;
+}
+
+emisor_entry_t *emisor_table_current(void)
+{
+    return &m_entries[m_current];
+}
+
+void emisor_table_on_connected(int8_t index, uint16_t conn_handle)
+{
+    if (index < 0 || !m_used[index])
+    {
+        return;
+    }
+    m_current                       = (uint8_t)index;
+    m_entries[index].conn_handle    = conn_handle;
+    m_entries[index].state          = EMISOR_STATE_CONNECTED;
+}
+
+bool emisor_table_advance(bool served)
+{
+    m_entries[m_current].state       = served ? EMISOR_STATE_SERVED : EMISOR_STATE_MISSED;
+    m_entries[m_current].conn_handle = BLE_CONN_HANDLE_INVALID;
+
+    for (uint8_t step = 1; step < EMISOR_TABLE_MAX; step++)
+    {
+        uint8_t slot = (m_current + step) % EMISOR_TABLE_MAX;
+        if (m_used[slot] && m_entries[slot].state == EMISOR_STATE_PENDING)
+        {
+            m_current = slot;
+            return true;
+        }
+    }
+
+    return false;
+}
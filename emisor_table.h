@@ -0,0 +1,76 @@
+#ifndef EMISOR_TABLE_H
+#define EMISOR_TABLE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "ble_gap.h"
+#include "sdk_errors.h"
+
+// Tabla de emisores atendidos por el repetidor.
+//
+// La entrada 0 es siempre el emisor principal (config_repeater.mac_emisor) y
+// guarda sus historiales en HISTORY_FILE_ID, como antes. Los emisores
+// agregados con el comando 24 usan EMISOR_HISTORY_FILE_ID_BASE + indice.
+//
+// En cada ventana activa se atienden en orden: se conecta al primero, al
+// terminar sus comandos se desconecta y se pasa al siguiente. El nRF52832 usa
+// un solo enlace central (RAM), por lo que las conexiones son sucesivas. Un
+// emisor que no aparece en EMISOR_CONNECT_TIMEOUT_MS se saltea, y cada ventana
+// empieza por el primero que la anterior no llego a buscar (o por el
+// siguiente al que empezo la anterior), para que ninguno quede sin turno.
+
+#define EMISOR_TABLE_MAX 8
+
+typedef enum
+{
+    EMISOR_STATE_PENDING   = 0, // Falta atenderlo en esta ventana
+    EMISOR_STATE_CONNECTED = 1,
+    EMISOR_STATE_SERVED    = 2, // Ya se atendio en esta ventana
+    EMISOR_STATE_MISSED    = 3  // No aparecio a tiempo en esta ventana
+} emisor_state_t;
+
+typedef struct
+{
+    uint8_t  mac[6];          // MAC del emisor, MSB primero (igual que la config)
+    uint16_t history_file_id; // FILE_ID de FDS para sus historiales
+    uint32_t last_contador;   // Ultimo contador de ADV visto
+    uint16_t conn_handle;
+    uint8_t  state;           // emisor_state_t
+
+    // Sincronizacion de hora (ver time_sync.h), en octavos de segundo
+    int32_t  clock_offset;    // Reloj del emisor - reloj del repetidor
+    int32_t  clock_residual;  // Offset que quedo despues del ultimo ajuste
+    int32_t  adjust_offset;   // Offset que corrigio el ultimo ajuste ("062")
+    int32_t  drift_ppm;       // Deriva estimada entre sincronizaciones
+    uint16_t rtt;             // Ultimo tiempo de ida y vuelta
+    uint32_t last_sync;       // Segundos desde 2000 (repetidor), 0 = nunca
+    uint32_t last_adjust;     // Hora del ultimo ajuste, 0 = nunca
+} emisor_entry_t;
+
+void            emisor_table_init(void);
+uint8_t         emisor_table_count(void);
+emisor_entry_t *emisor_table_get(uint8_t index);
+
+ret_code_t      emisor_table_add(uint8_t const *p_mac);
+ret_code_t      emisor_table_remove(uint8_t const *p_mac);
+
+/**@brief Busca un emisor por direccion BLE (orden little-endian del stack).
+ *
+ * @return Indice en la tabla, o -1 si no esta.
+ */
+int8_t          emisor_table_find_by_addr(ble_gap_addr_t const *p_addr);
+
+// Planificador round-robin de la ventana activa
+void            emisor_table_begin_window(void);
+emisor_entry_t *emisor_table_current(void);
+void            emisor_table_on_connected(int8_t index, uint16_t conn_handle);
+
+/**@brief Marca el emisor actual como atendido (o salteado, si no aparecio)
+ *        y avanza al siguiente.
+ *
+ * @return true si queda otro emisor por atender en esta ventana.
+ */
+bool            emisor_table_advance(bool served);
+
+#endif // EMISOR_TABLE_H
@@ -0,0 +1,286 @@
+#include "energy.h"
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "app_timer.h"
+#include "app_util_platform.h"
+#include "nordic_common.h"
+#include "nrf_log.h"
+#include "rtc_timer.h"
+#include "sdk_config.h"
+#include "variables.h"
+
+#define UAMS_PER_NAH  3600 // 1 nAh = 3.6 uA*s
+#define CPU_CNT_FREQ  (APP_TIMER_CLOCK_FREQ / (APP_TIMER_CONFIG_RTC_FREQUENCY + 1))
+
+static const uint32_t m_radio_ua[ENERGY_RADIO_COUNT] = {
+    [ENERGY_RADIO_ADV]  = ENERGY_ADV_UA,
+    [ENERGY_RADIO_SCAN] = ENERGY_SCAN_UA,
+    [ENERGY_RADIO_CONN] = ENERGY_CONN_UA,
+};
+
+// Ciclo en curso
+static uint64_t        m_cycle_start = 0;                     // Tick de rtc_timer
+static uint64_t        m_radio_start[ENERGY_RADIO_COUNT];     // Tick de encendido
+static uint64_t        m_radio_ticks[ENERGY_RADIO_COUNT];
+static uint8_t         m_radio_users[ENERGY_RADIO_COUNT];
+static bool            m_uart_on      = false;
+static uint64_t        m_uart_start   = 0;
+static uint64_t        m_uart_ticks   = 0;
+static uint32_t        m_wake_cnt    = 0;                     // Contador de app_timer
+static uint64_t        m_cpu_cnt     = 0;
+static uint32_t        m_flash_writes = 0;
+static uint32_t        m_flash_erases = 0;
+static uint32_t        m_wakeups      = 0;
+
+static energy_cycle_t  m_last_cycle;
+static energy_totals_t m_totals;
+
+// Suma lo transcurrido de las actividades abiertas y las reinicia en now.
+// Llamar con las interrupciones bloqueadas.
+static void accrue_locked(uint64_t now)
+{
+    for (uint8_t radio = 0; radio < ENERGY_RADIO_COUNT; radio++)
+    {
+        if (m_radio_users[radio] > 0)
+        {
+            m_radio_ticks[radio] += now - m_radio_start[radio];
+            m_radio_start[radio]  = now;
+        }
+    }
+    if (m_uart_on)
+    {
+        m_uart_ticks += now - m_uart_start;
+        m_uart_start  = now;
+    }
+}
+
+void energy_init(void)
+{
+    memset(m_radio_users, 0, sizeof(m_radio_users));
+    memset(m_radio_ticks, 0, sizeof(m_radio_ticks));
+    m_uart_on    = false;
+    m_uart_ticks = 0;
+    memset(&m_totals, 0, sizeof(m_totals));
+    memset(&m_last_cycle, 0, sizeof(m_last_cycle));
+
+    m_cycle_start = rtc_timer_ticks();
+    m_wake_cnt    = app_timer_cnt_get();
+    m_cpu_cnt     = 0;
+}
+
+void energy_radio_on(energy_radio_t radio)
+{
+    uint64_t now = rtc_timer_ticks();
+
+    CRITICAL_REGION_ENTER();
+    if (m_radio_users[radio] == 0)
+    {
+        m_radio_start[radio] = now;
+        m_radio_users[radio] = 1;
+    }
+    else if (radio == ENERGY_RADIO_CONN)
+    {
+        m_radio_users[radio]++;
+    }
+    CRITICAL_REGION_EXIT();
+}
+
+void energy_radio_off(energy_radio_t radio)
+{
+    uint64_t now = rtc_timer_ticks();
+
+    CRITICAL_REGION_ENTER();
+    if (m_radio_users[radio] > 0)
+    {
+        accrue_locked(now);
+        m_radio_users[radio]--;
+    }
+    CRITICAL_REGION_EXIT();
+}
+
+void energy_uart_on(void)
+{
+    uint64_t now = rtc_timer_ticks();
+
+    CRITICAL_REGION_ENTER();
+    if (!m_uart_on)
+    {
+        m_uart_start = now;
+        m_uart_on    = true;
+    }
+    CRITICAL_REGION_EXIT();
+}
+
+void energy_uart_off(void)
+{
+    uint64_t now = rtc_timer_ticks();
+
+    CRITICAL_REGION_ENTER();
+    if (m_uart_on)
+    {
+        accrue_locked(now);
+        m_uart_on = false;
+    }
+    CRITICAL_REGION_EXIT();
+}
+
+void energy_cpu_sleep(void)
+{
+    // Las esperas y los tramos despiertos son cortos: el contador de 24 bits
+    // de app_timer no llega a dar la vuelta entre dos lecturas
+    m_cpu_cnt += app_timer_cnt_diff_compute(app_timer_cnt_get(), m_wake_cnt);
+}
+
+void energy_cpu_wake(void)
+{
+    m_wake_cnt = app_timer_cnt_get();
+    m_wakeups++;
+}
+
+void energy_flash_write(void)
+{
+    CRITICAL_REGION_ENTER();
+    m_flash_writes++;
+    CRITICAL_REGION_EXIT();
+}
+
+void energy_flash_erase(void)
+{
+    CRITICAL_REGION_ENTER();
+    m_flash_erases++;
+    CRITICAL_REGION_EXIT();
+}
+
+void energy_cycle_close(void)
+{
+    energy_cycle_t cycle;
+    uint64_t       now = rtc_timer_ticks();
+    uint64_t       charge_uams;
+    uint32_t       wake_cnt;
+
+    // Se cierra despierto: el tramo de CPU en curso cuenta hasta ahora
+    wake_cnt   = app_timer_cnt_get();
+    m_cpu_cnt += app_timer_cnt_diff_compute(wake_cnt, m_wake_cnt);
+    m_wake_cnt = wake_cnt;
+
+    CRITICAL_REGION_ENTER();
+    accrue_locked(now);
+    for (uint8_t radio = 0; radio < ENERGY_RADIO_COUNT; radio++)
+    {
+        cycle.radio_ms[radio] = (uint32_t)RTC_TIMER_TICKS_TO_MS(m_radio_ticks[radio]);
+        m_radio_ticks[radio]  = 0;
+    }
+    cycle.uart_ms      = (uint32_t)RTC_TIMER_TICKS_TO_MS(m_uart_ticks);
+    m_uart_ticks       = 0;
+    cycle.flash_writes = m_flash_writes;
+    cycle.flash_erases = m_flash_erases;
+    m_flash_writes     = 0;
+    m_flash_erases     = 0;
+    CRITICAL_REGION_EXIT();
+
+    cycle.duration_ms = (uint32_t)RTC_TIMER_TICKS_TO_MS(now - m_cycle_start);
+    cycle.cpu_us      = (uint32_t)(m_cpu_cnt * 1000000 / CPU_CNT_FREQ);
+    cycle.wakeups     = m_wakeups;
+    m_cycle_start     = now;
+    m_cpu_cnt         = 0;
+    m_wakeups         = 0;
+
+    charge_uams = (uint64_t)ENERGY_BASE_UA * cycle.duration_ms +
+                  (uint64_t)ENERGY_CPU_UA * cycle.cpu_us / 1000 +
+                  (uint64_t)ENERGY_UART_UA * cycle.uart_ms +
+                  (uint64_t)ENERGY_FLASH_WRITE_UAMS * cycle.flash_writes +
+                  (uint64_t)ENERGY_FLASH_ERASE_UAMS * cycle.flash_erases;
+    for (uint8_t radio = 0; radio < ENERGY_RADIO_COUNT; radio++)
+    {
+        charge_uams += (uint64_t)m_radio_ua[radio] * cycle.radio_ms[radio];
+    }
+    cycle.charge_nah = (uint32_t)(charge_uams / UAMS_PER_NAH);
+
+    m_totals.cycles++;
+    m_totals.duration_ms  += cycle.duration_ms;
+    m_totals.cpu_us       += cycle.cpu_us;
+    m_totals.uart_ms      += cycle.uart_ms;
+    m_totals.flash_writes += cycle.flash_writes;
+    m_totals.flash_erases += cycle.flash_erases;
+    m_totals.wakeups      += cycle.wakeups;
+    m_totals.charge_nah   += cycle.charge_nah;
+    for (uint8_t radio = 0; radio < ENERGY_RADIO_COUNT; radio++)
+    {
+        m_totals.radio_ms[radio] += cycle.radio_ms[radio];
+    }
+    m_last_cycle = cycle;
+
+    NRF_LOG_RAW_INFO(LOG_INFO " Energia: CPU %u ms, ADV %u ms, scan %u ms, conexion %u ms, "
+                              "UART %u ms",
+                     cycle.cpu_us / 1000,
+                     cycle.radio_ms[ENERGY_RADIO_ADV],
+                     cycle.radio_ms[ENERGY_RADIO_SCAN],
+                     cycle.radio_ms[ENERGY_RADIO_CONN],
+                     cycle.uart_ms);
+    NRF_LOG_RAW_INFO(LOG_INFO " Energia: flash %u escrituras / %u borrados, %u despertares, "
+                              "%u nAh (%u uAh/dia)",
+                     cycle.flash_writes,
+                     cycle.flash_erases,
+                     cycle.wakeups,
+                     cycle.charge_nah,
+                     energy_daily_uah());
+}
+
+void energy_last_cycle_get(energy_cycle_t *p_cycle)
+{
+    *p_cycle = m_last_cycle;
+}
+
+void energy_totals_get(energy_totals_t *p_totals)
+{
+    *p_totals = m_totals;
+}
+
+uint32_t energy_daily_uah(void)
+{
+    if (m_totals.duration_ms == 0)
+    {
+        return 0;
+    }
+    // nAh * (ms por dia) / ms medidos / 1000
+    return (uint32_t)(m_totals.charge_nah * 86400ULL / m_totals.duration_ms);
+}
+
+void energy_totals_reset(void)
+{
+    memset(&m_totals, 0, sizeof(m_totals));
+}
+
+static uint16_t put_u32(uint8_t *p_buf, uint32_t value)
+{
+    p_buf[0] = (value >> 24) & 0xFF;
+    p_buf[1] = (value >> 16) & 0xFF;
+    p_buf[2] = (value >> 8) & 0xFF;
+    p_buf[3] = (value & 0xFF);
+    return 4;
+}
+
+uint16_t energy_encode_totals(uint8_t *p_buf)
+{
+    uint16_t pos = 0;
+
+    // [E7][ciclos][tiempo s][CPU ms][ADV s][scan s][conexion s][escrituras]
+    // [borrados][despertares][carga uAh][uAh/dia][UART s], todo u32 big-endian
+    p_buf[pos++] = ENERGY_FRAME_TAG;
+    pos += put_u32(&p_buf[pos], m_totals.cycles);
+    pos += put_u32(&p_buf[pos], (uint32_t)(m_totals.duration_ms / 1000));
+    pos += put_u32(&p_buf[pos], (uint32_t)(m_totals.cpu_us / 1000));
+    for (uint8_t radio = 0; radio < ENERGY_RADIO_COUNT; radio++)
+    {
+        pos += put_u32(&p_buf[pos], (uint32_t)(m_totals.radio_ms[radio] / 1000));
+    }
+    pos += put_u32(&p_buf[pos], m_totals.flash_writes);
+    pos += put_u32(&p_buf[pos], m_totals.flash_erases);
+    pos += put_u32(&p_buf[pos], m_totals.wakeups);
+    pos += put_u32(&p_buf[pos], (uint32_t)(m_totals.charge_nah / 1000));
+    pos += put_u32(&p_buf[pos], energy_daily_uah());
+    pos += put_u32(&p_buf[pos], (uint32_t)(m_totals.uart_ms / 1000));
+    return pos;
+}
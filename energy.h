@@ -0,0 +1,126 @@
+#ifndef ENERGY_H
+#define ENERGY_H
+
+#include <stdint.h>
+
+// Contabilidad de energia por ciclo de encendido.
+//
+// Se mide el tiempo con advertising, escaneo, conexiones y UART abiertos
+// (ticks de rtc_timer), el tiempo de CPU despierta entre esperas de idle_state_handle()
+// (contador de app_timer, ~61 us), las escrituras y borrados de flash y la
+// cantidad de despertares. Un modelo de corriente por estado convierte eso en
+// carga; el ciclo cierra al despertar del sleep (power_fsm).
+//
+// Las corrientes son estimaciones con LDO a 3 V y 0 dBm: las de advertising,
+// escaneo y conexion son promedios con los intervalos configurados, no la
+// corriente pico de la radio. Se pueden calibrar con medidas de banco
+// definiendolas antes de incluir este archivo.
+
+#ifndef ENERGY_BASE_UA
+#define ENERGY_BASE_UA          3      // System ON con RTC y RAM retenida
+#endif
+#ifndef ENERGY_CPU_UA
+#define ENERGY_CPU_UA           7400   // CPU ejecutando desde flash
+#endif
+#ifndef ENERGY_ADV_UA
+#define ENERGY_ADV_UA           500    // Advertising cada 40 ms
+#endif
+#ifndef ENERGY_RX_UA
+#define ENERGY_RX_UA            11700  // Radio en recepcion
+#endif
+#ifndef ENERGY_SCAN_UA
+#define ENERGY_SCAN_UA          (ENERGY_RX_UA * NRF_BLE_SCAN_SCAN_WINDOW / NRF_BLE_SCAN_SCAN_INTERVAL)
+#endif
+#ifndef ENERGY_CONN_UA
+#define ENERGY_CONN_UA          300    // Conexion con poco trafico
+#endif
+#ifndef ENERGY_UART_UA
+#define ENERGY_UART_UA          600    // UARTE en recepcion, con HFCLK pedido
+#endif
+#ifndef ENERGY_FLASH_WRITE_UAMS
+#define ENERGY_FLASH_WRITE_UAMS 3000   // Un registro: ~10 palabras de 41 us
+#endif
+#ifndef ENERGY_FLASH_ERASE_UAMS
+#define ENERGY_FLASH_ERASE_UAMS 629000 // Una pagina: 85 ms
+#endif
+
+#define ENERGY_FRAME_TAG        0xE7
+#define ENERGY_FRAME_SIZE       49
+#define ENERGY_PART_HEADER_SIZE 3  // [E7][parte][partes] en cada notificacion
+
+typedef enum
+{
+    ENERGY_RADIO_ADV = 0,
+    ENERGY_RADIO_SCAN,
+    ENERGY_RADIO_CONN, // Cuenta enlaces: puede haber celular y emisor a la vez
+    ENERGY_RADIO_COUNT
+} energy_radio_t;
+
+typedef struct
+{
+    uint32_t duration_ms;
+    uint32_t cpu_us;
+    uint32_t radio_ms[ENERGY_RADIO_COUNT];
+    uint32_t uart_ms;
+    uint32_t flash_writes;
+    uint32_t flash_erases;
+    uint32_t wakeups;
+    uint32_t charge_nah;
+} energy_cycle_t;
+
+typedef struct
+{
+    uint32_t cycles;
+    uint64_t duration_ms;
+    uint64_t cpu_us;
+    uint64_t radio_ms[ENERGY_RADIO_COUNT];
+    uint64_t uart_ms;
+    uint32_t flash_writes;
+    uint32_t flash_erases;
+    uint32_t wakeups;
+    uint64_t charge_nah;
+} energy_totals_t;
+
+/**@brief Requiere app_timer iniciado. Llamar antes de iniciar la radio. */
+void     energy_init(void);
+
+/**@brief Inicio y fin de una actividad de radio. ADV y SCAN son encendido o
+ *        apagado; CONN cuenta enlaces abiertos. Se pueden llamar desde
+ *        interrupciones.
+ */
+void     energy_radio_on(energy_radio_t radio);
+void     energy_radio_off(energy_radio_t radio);
+
+/**@brief Apertura y cierre del UARTE (uart_bridge). */
+void     energy_uart_on(void);
+void     energy_uart_off(void);
+
+/**@brief Alrededor de la espera de eventos en idle_state_handle(). */
+void     energy_cpu_sleep(void);
+void     energy_cpu_wake(void);
+
+/**@brief Operaciones de flash completadas (eventos de FDS). */
+void     energy_flash_write(void);
+void     energy_flash_erase(void);
+
+/**@brief Cierra el ciclo: calcula la carga, la suma a los totales y la
+ *        informa en el log.
+ */
+void     energy_cycle_close(void);
+
+void     energy_last_cycle_get(energy_cycle_t *p_cycle);
+void     energy_totals_get(energy_totals_t *p_totals);
+
+/**@brief Consumo diario estimado con los totales acumulados (uAh/dia). */
+uint32_t energy_daily_uah(void);
+
+void     energy_totals_reset(void);
+
+/**@brief Trama de totales para el celular (comando 27). @p p_buf debe tener
+ *        ENERGY_FRAME_SIZE bytes. No entra en una notificacion con el MTU por
+ *        defecto: app_nus_server la envia en partes de ENERGY_PART_HEADER_SIZE
+ *        bytes de encabezado mas los datos que quepan.
+ */
+uint16_t energy_encode_totals(uint8_t *p_buf);
+
+#endif // ENERGY_H
@@ -2,16 +2,125 @@
 #include "variables.h"
 #include "ble_gap.h"
 #include "nrf_sdh_ble.h"
+#include "adv_payload.h"
 #include "app_nus_server.h"
+#include "energy.h"
+#include "history_codec.h"
+#include "history_sync.h"
+#include "power_fsm.h"
+#include "relay_queue.h"
 #include <stdint.h>
 
 // Buffer estático para evitar problemas con variables locales en el stack
 static store_history g_temp_history_buffer;
+
 extern void          app_nus_client_on_data_received(
                     const uint8_t *data_ptr,
                     uint16_t       data_length);
 extern config_repeater_t config_repeater;
 
+// Formatos anteriores, con la fecha desglosada en 7 bytes. Se reconocen por
+// el largo del registro y se convierten al leerlos; la siguiente escritura
+// ya usa el formato actual.
+typedef struct
+{
+    uint16_t magic;
+    uint16_t year;
+    uint8_t  month;
+    uint8_t  day;
+    uint8_t  hour;
+    uint8_t  minute;
+    uint8_t  second;
+    uint32_t contador;
+    uint16_t V1;
+    uint16_t V2;
+    uint16_t V3;
+    uint16_t V4;
+    uint16_t V5;
+    uint16_t V6;
+    uint16_t V7;
+    uint16_t V8;
+    uint8_t  temp;
+    uint8_t  battery;
+} store_history_v1_t;
+
+typedef struct
+{
+    uint8_t    mac_emisor[6];
+    uint8_t    mac_repetidor[6];
+    bool       enable_custom_mac_repetidor;
+    uint32_t   tiempo_encendido;
+    uint32_t   tiempo_dormido;
+    uint32_t   tiempo_extendido;
+    uint32_t   tiempo_extendido_dormido;
+    datetime_t fecha;
+    uint8_t    version[3];
+    uint16_t   cantidad_historiales;
+} config_repeater_v1_t;
+
+#define HISTORY_WORDS     BYTES_TO_WORDS(sizeof(store_history))
+#define HISTORY_V1_WORDS  BYTES_TO_WORDS(sizeof(store_history_v1_t))
+#define CONFIG_WORDS      BYTES_TO_WORDS(sizeof(config_repeater_t))
+#define CONFIG_V1_WORDS   BYTES_TO_WORDS(sizeof(config_repeater_v1_t))
+
+static bool history_record_words_valid(uint16_t length_words)
+{
+    return length_words == HISTORY_WORDS || length_words == HISTORY_V1_WORDS;
+}
+
+// Copia un registro de historial desde flash en el formato actual
+static bool history_record_from_flash(
+           fds_flash_record_t const *p_flash,
+           store_history            *p_out)
+{
+    if (p_flash->p_header->length_words == HISTORY_WORDS) {
+        memcpy(p_out, p_flash->p_data, sizeof(store_history));
+        return true;
+    }
+    if (p_flash->p_header->length_words != HISTORY_V1_WORDS) {
+        return false;
+    }
+
+    store_history_v1_t const *p_old = p_flash->p_data;
+    datetime_t                dt    = {
+                          .year   = p_old->year,
+                          .month  = p_old->month,
+                          .day    = p_old->day,
+                          .hour   = p_old->hour,
+                          .minute = p_old->minute,
+                          .second = p_old->second};
+
+    p_out->magic     = p_old->magic;
+    p_out->temp      = p_old->temp;
+    p_out->battery   = p_old->battery;
+    p_out->timestamp = timestamp_from_datetime(&dt);
+    p_out->contador  = p_old->contador;
+    p_out->V1        = p_old->V1;
+    p_out->V2        = p_old->V2;
+    p_out->V3        = p_old->V3;
+    p_out->V4        = p_old->V4;
+    p_out->V5        = p_old->V5;
+    p_out->V6        = p_old->V6;
+    p_out->V7        = p_old->V7;
+    p_out->V8        = p_old->V8;
+    return true;
+}
+
+uint16_t history_put_ble_date(uint8_t *p_buf, uint32_t timestamp)
+{
+    datetime_t dt;
+
+    timestamp_to_datetime(timestamp, &dt);
+    p_buf[0] = dt.day;
+    p_buf[1] = dt.month;
+    p_buf[2] = (dt.year >> 8) & 0xFF;
+    p_buf[3] = (dt.year & 0xFF);
+    p_buf[4] = dt.hour;
+    p_buf[5] = dt.minute;
+    p_buf[6] = dt.second;
+    return 7;
+}
+
 //-------------------------------------------------------------------------------------------------------------
 //                                      FDS INIT FUNCTIONS STARTS HERE
 //-------------------------------------------------------------------------------------------------------------
@@ -30,8 +139,28 @@ static void perform_garbage_collection(void)
     }
 }
 
+static void history_batch_on_fds_evt(fds_evt_t const *p_evt);
+
 static void fds_evt_handler(fds_evt_t const *p_evt)
 {
+    history_batch_on_fds_evt(p_evt);
+    relay_queue_on_fds_evt(p_evt);
+
+    if ((p_evt->id == FDS_EVT_WRITE || p_evt->id == FDS_EVT_UPDATE) &&
+        p_evt->result == NRF_SUCCESS) {
+        energy_flash_write();
+    }
+    else if (p_evt->id == FDS_EVT_GC && p_evt->result == NRF_SUCCESS) {
+        energy_flash_erase(); // Al menos una pagina
+    }
+
+    // La configuracion se guarda al despertar; avisar cuando quedo escrita
+    if ((p_evt->id == FDS_EVT_WRITE || p_evt->id == FDS_EVT_UPDATE) &&
+        p_evt->result == NRF_SUCCESS && p_evt->write.file_id == CONFIG_FILE_ID &&
+        p_evt->write.record_key == CONFIG_RECORD_KEY) {
+        power_fsm_post(PWR_EVT_CONFIG_SAVED);
+    }
+
     if (p_evt->id == FDS_EVT_INIT) {
         if (p_evt->result == NRF_SUCCESS) {
             NRF_LOG_RAW_INFO(
@@ -106,7 +235,266 @@ void fds_initialize(void)
 //                                      FDS INIT FUNCTIONS ENDS HERE
 //-------------------------------------------------------------------------------------------------------------
 
+//-------------------------------------------------------------------------------------------------------------
+//                                      HISTORY APPEND (CATCH-UP)
+//-------------------------------------------------------------------------------------------------------------
+
+// ID mas alto guardado localmente en m_history_highest_file (se calcula una
+// vez recorriendo el archivo)
+static uint16_t m_history_highest_file  = HISTORY_FILE_ID;
+static uint16_t m_history_highest_id    = 0;
+static bool     m_history_highest_known = false;
+static bool     m_history_has_records   = false;
+
+// Cola de escrituras en lote: FDS escribe desde estos buffers de forma
+// asíncrona, así que cada entrada se libera recién con su evento de FDS
+typedef struct
+{
+    store_history record;
+    uint16_t      file_id;
+    uint16_t      offset;
+    uint8_t       retries; // Reintentos restantes si FDS informa un error
+    bool          writing;
+    bool          done;
+} history_batch_entry_t;
+
+static history_batch_entry_t m_history_batch[HISTORY_BATCH_SIZE];
+static uint8_t               m_history_batch_head  = 0;
+static uint8_t               m_history_batch_count = 0;
+static bool                  m_history_batch_gc    = false;
+
+static void history_note_stored_id(uint16_t file_id, uint16_t offset)
+{
+    if (file_id != m_history_highest_file) {
+        return;
+    }
+    if (!m_history_has_records || offset > m_history_highest_id) {
+        m_history_highest_id = offset;
+    }
+    m_history_has_records = true;
+}
+
+bool history_highest_local_id(uint16_t file_id, uint16_t *p_id)
+{
+    if (file_id != m_history_highest_file) {
+        m_history_highest_file  = file_id;
+        m_history_highest_known = false;
+    }
+
+    if (!m_history_highest_known) {
+        fds_record_desc_t desc  = {0};
+        fds_find_token_t  token = {0};
+
+        m_history_has_records = false;
+        m_history_highest_id  = 0;
+        while (fds_record_find_in_file(file_id, &desc, &token) ==
+               NRF_SUCCESS) {
+            fds_flash_record_t flash_record = {0};
+            if (fds_record_open(&desc, &flash_record) != NRF_SUCCESS) {
+                continue;
+            }
+            uint16_t key = flash_record.p_header->record_key;
+            fds_record_close(&desc);
+
+            if (key >= HISTORY_RECORD_KEY_START) {
+                history_note_stored_id(file_id, key - HISTORY_RECORD_KEY_START);
+            }
+        }
+        m_history_highest_known = true;
+    }
+
+    if (p_id != NULL) {
+        *p_id = m_history_highest_id;
+    }
+    return m_history_has_records;
+}
+
+static history_batch_entry_t *history_batch_at(uint8_t index)
+{
+    return &m_history_batch[(m_history_batch_head + index) % HISTORY_BATCH_SIZE];
+}
+
+// Entrada de la cola para el mismo registro, en escritura o no
+static history_batch_entry_t *history_batch_find(
+           uint16_t file_id,
+           uint16_t offset,
+           bool     writing)
+{
+    for (uint8_t i = 0; i < m_history_batch_count; i++) {
+        history_batch_entry_t *p_entry = history_batch_at(i);
+        if (!p_entry->done && p_entry->writing == writing &&
+            p_entry->file_id == file_id && p_entry->offset == offset) {
+            return p_entry;
+        }
+    }
+    return NULL;
+}
+
+// Lanza las escrituras pendientes hasta llenar la cola de operaciones de FDS
+static void history_batch_flush(void)
+{
+    for (uint8_t i = 0; i < m_history_batch_count; i++) {
+        history_batch_entry_t *p_entry = history_batch_at(i);
+        if (p_entry->writing || p_entry->done) {
+            continue;
+        }
+
+        // Mientras la escritura anterior del mismo registro no termine,
+        // fds_record_find() no lo ve: se espera para actualizarlo
+        if (history_batch_find(p_entry->file_id, p_entry->offset, true) !=
+            NULL) {
+            continue;
+        }
+
+        fds_record_desc_t desc       = {0};
+        fds_find_token_t  token      = {0};
+        uint16_t          record_key = HISTORY_RECORD_KEY_START + p_entry->offset;
+        fds_record_t      record     = {
+                   .file_id           = p_entry->file_id,
+                   .key               = record_key,
+                   .data.p_data       = &p_entry->record,
+                   .data.length_words = BYTES_TO_WORDS(sizeof(store_history))};
+        ret_code_t        ret;
+
+        if (fds_record_find(p_entry->file_id, record_key, &desc, &token) ==
+            NRF_SUCCESS) {
+            ret = fds_record_update(&desc, &record);
+        }
+        else {
+            ret = fds_record_write(&desc, &record);
+        }
+
+        if (ret == NRF_SUCCESS) {
+            p_entry->writing = true;
+            history_note_stored_id(p_entry->file_id, p_entry->offset);
+        }
+        else if (ret == FDS_ERR_NO_SPACE_IN_FLASH) {
+            // Se reintenta al terminar la recolección de basura
+            if (!m_history_batch_gc && fds_gc() == NRF_SUCCESS) {
+                m_history_batch_gc = true;
+            }
+            break;
+        }
+        else {
+            // Cola de FDS llena: se reintenta con el próximo evento
+            break;
+        }
+    }
+}
+
+static void history_batch_on_fds_evt(fds_evt_t const *p_evt)
+{
+    if (p_evt->id == FDS_EVT_GC) {
+        m_history_batch_gc = false;
+        history_batch_flush();
+        return;
+    }
+
+    if ((p_evt->id != FDS_EVT_WRITE && p_evt->id != FDS_EVT_UPDATE) ||
+        m_history_batch_count == 0 ||
+        p_evt->write.record_key < HISTORY_RECORD_KEY_START) {
+        return;
+    }
+
+    // Hay a lo sumo una escritura en curso por registro
+    history_batch_entry_t *p_entry = history_batch_find(
+               p_evt->write.file_id,
+               p_evt->write.record_key - HISTORY_RECORD_KEY_START,
+               true);
+    if (p_entry == NULL) {
+        return;
+    }
+
+    p_entry->writing = false;
+    if (p_evt->result == NRF_SUCCESS) {
+        p_entry->done = true;
+        // El contador y el advertising son del emisor principal
+        if (p_entry->file_id == HISTORY_FILE_ID) {
+            if (p_evt->id == FDS_EVT_WRITE) {
+                config_repeater.cantidad_historiales++;
+            }
+            adv_payload_on_history(&p_entry->record);
+        }
+    }
+    else if (p_entry->retries > 0) {
+        p_entry->retries--;
+        NRF_LOG_RAW_INFO(
+                   LOG_WARN " Error 0x%X al guardar historial %u, "
+                            "reintentando",
+                   p_evt->result,
+                   p_entry->offset);
+    }
+    else {
+        p_entry->done = true;
+        NRF_LOG_RAW_INFO(
+                   LOG_FAIL " Historial %u descartado tras error 0x%X",
+                   p_entry->offset,
+                   p_evt->result);
+    }
+
+    // Se liberan las entradas terminadas desde la cabeza
+    uint8_t count = m_history_batch_count;
+    while (m_history_batch_count > 0 && history_batch_at(0)->done) {
+        m_history_batch_head = (m_history_batch_head + 1) % HISTORY_BATCH_SIZE;
+        m_history_batch_count--;
+    }
+
+    history_batch_flush();
+
+    // La recuperacion puede estar esperando lugar para pedir mas
+    if (m_history_batch_count < count) {
+        history_sync_on_batch_space();
+    }
+}
+
+ret_code_t history_batch_append(
+           uint16_t             file_id,
+           store_history const *p_history_data,
+           uint16_t             offset)
+{
+    history_batch_entry_t *p_entry;
+
+    if (p_history_data == NULL) {
+        return NRF_ERROR_NULL;
+    }
+
+    // Un registro repetido que todavia no salio se reemplaza en su lugar
+    p_entry = history_batch_find(file_id, offset, false);
+    if (p_entry != NULL) {
+        memcpy(&p_entry->record, p_history_data, sizeof(store_history));
+        return NRF_SUCCESS;
+    }
+
+    if (m_history_batch_count >= HISTORY_BATCH_SIZE) {
+        return NRF_ERROR_NO_MEM;
+    }
+
+    p_entry = history_batch_at(m_history_batch_count);
+    memcpy(&p_entry->record, p_history_data, sizeof(store_history));
+    p_entry->file_id = file_id;
+    p_entry->offset  = offset;
+    p_entry->retries = HISTORY_BATCH_RETRIES;
+    p_entry->writing = false;
+    p_entry->done    = false;
+    m_history_batch_count++;
+
+    history_batch_flush();
+
+    return NRF_SUCCESS;
+}
+
+bool history_batch_is_idle(void)
+{
+    return m_history_batch_count == 0;
+}
+
+uint8_t history_batch_free_count(void)
+{
+    return HISTORY_BATCH_SIZE - m_history_batch_count;
+}
+
 ret_code_t save_history_record_emisor(
+           uint16_t             file_id,
            store_history const *p_history_data,
            uint16_t             offset)
 {
@@ -123,13 +511,13 @@ ret_code_t save_history_record_emisor(
     // Preparar nuevo registro histórico
     uint16_t     record_key = HISTORY_RECORD_KEY_START + offset;
     fds_record_t new_record = {
-               .file_id     = HISTORY_FILE_ID,
+               .file_id     = file_id,
                .key         = record_key,
                .data.p_data = &g_temp_history_buffer, // Usar buffer estático
                .data.length_words = BYTES_TO_WORDS(sizeof(store_history))};
 
     // Buscar el registro del historial, si no existe lo escribe
-    ret = fds_record_find(HISTORY_FILE_ID, record_key, &desc_history, &token);
+    ret = fds_record_find(file_id, record_key, &desc_history, &token);
     if (ret == NRF_SUCCESS) {
         // Si el registro ya existe, lo actualiza
         ret = fds_record_update(&desc_history, &new_record);
@@ -164,17 +552,25 @@ ret_code_t save_history_record_emisor(
         nrf_delay_ms(1000);
         (void)fds_gc(); // Forzar garbage collection si es necesario
         
-        // Incrementar contador de historiales en memoria
-        // La configuración se guardará cuando el dispositivo entre en modo sleep
-        config_repeater.cantidad_historiales++;
-        NRF_LOG_RAW_INFO(LOG_INFO " Contador de historiales: %u", 
-                       config_repeater.cantidad_historiales);
+        // Incrementar contador de historiales en memoria (solo los del
+        // emisor principal). La configuración se guardará cuando el
+        // dispositivo entre en modo sleep
+        if (file_id == HISTORY_FILE_ID) {
+            config_repeater.cantidad_historiales++;
+            NRF_LOG_RAW_INFO(LOG_INFO " Contador de historiales: %u",
+                           config_repeater.cantidad_historiales);
+        }
     }
     else {
         NRF_LOG_RAW_INFO(LOG_FAIL " Error al buscar el registro: %d", ret);
         return ret;
     }
 
+    history_note_stored_id(file_id, offset);
+    if (file_id == HISTORY_FILE_ID) {
+        adv_payload_on_history(&g_temp_history_buffer);
+    }
+
     return NRF_SUCCESS;
 }
 
@@ -316,10 +712,8 @@ ret_code_t read_history_record_by_id(
             return ret;
         }
 
-        // Verificar que el tamaño del registro en flash coincida con el del
-        // struct.
-        if (flash_record.p_header->length_words !=
-            BYTES_TO_WORDS(sizeof(store_history))) {
+        // Copiar los datos al puntero de salida (formato actual o anterior).
+        if (!history_record_from_flash(&flash_record, p_history_data)) {
             NRF_LOG_RAW_INFO(
                        LOG_WARN
                        " Tamano del registro en flash no coincide con el "
@@ -329,9 +723,6 @@ ret_code_t read_history_record_by_id(
             return NRF_ERROR_INVALID_DATA;
         }
 
-        // Copiar los datos al puntero de salida.
-        memcpy(p_history_data, flash_record.p_data, sizeof(store_history));
-
         return fds_record_close(&desc);
     }
 
@@ -373,22 +764,68 @@ ret_code_t read_last_history_record(store_history *p_history_data)
     return NRF_ERROR_NOT_FOUND;
 }
 
+uint8_t history_read_latest(store_history *p_records, uint8_t max_records)
+{
+    fds_record_desc_t desc  = {0};
+    fds_find_token_t  token = {0};
+    uint8_t           count = 0;
+
+    // Una pasada por el archivo del emisor principal, sin esperas ni log:
+    // quedan los max_records de fecha mas reciente, el mas nuevo primero
+    while (fds_record_find_in_file(HISTORY_FILE_ID, &desc, &token) == NRF_SUCCESS) {
+        fds_flash_record_t flash_record = {0};
+        store_history      record;
+        bool               valid;
+
+        if (fds_record_open(&desc, &flash_record) != NRF_SUCCESS) {
+            continue;
+        }
+        valid = flash_record.p_header->record_key >= HISTORY_RECORD_KEY_START &&
+                history_record_from_flash(&flash_record, &record);
+        fds_record_close(&desc);
+
+        if (!valid || record.timestamp == TIMESTAMP_INVALID) {
+            continue;
+        }
+
+        uint8_t pos = count;
+        while (pos > 0 && p_records[pos - 1].timestamp < record.timestamp) {
+            pos--;
+        }
+        if (pos >= max_records) {
+            continue;
+        }
+        if (count < max_records) {
+            count++;
+        }
+        memmove(&p_records[pos + 1], &p_records[pos],
+                (count - 1 - pos) * sizeof(store_history));
+        p_records[pos] = record;
+    }
+
+    return count;
+}
+
 void print_history_record(store_history const *p_record, const char *p_title)
 {
+    datetime_t dt;
+
+    timestamp_to_datetime(p_record->timestamp, &dt);
+
     // Calcula el largo de la línea de cierre según el título
     NRF_LOG_RAW_INFO(
                "\n\n\x1B[1;36m=======\x1B[0m %s \x1B[1;36m=======\x1B[0m\n\n",
                p_title);
     NRF_LOG_RAW_INFO(
                "Fecha        : %02d/%02d/%04d\n",
-               p_record->day,
-               p_record->month,
-               p_record->year);
+               dt.day,
+               dt.month,
+               dt.year);
     NRF_LOG_RAW_INFO(
                "Hora         : %02d:%02d:%02d\n",
-               p_record->hour,
-               p_record->minute,
-               p_record->second);
+               dt.hour,
+               dt.minute,
+               dt.second);
     NRF_LOG_RAW_INFO("Contador     : %lu\n", p_record->contador);
     NRF_LOG_RAW_INFO("V1           : %u\n", p_record->V1);
     NRF_LOG_RAW_INFO("V2           : %u\n", p_record->V2);
@@ -409,19 +846,22 @@ void print_history_record(store_history const *p_record, const char *p_title)
 
 void print_adv_history_record(const store_adv_history *p_record, const char *p_title)
 {
+    datetime_t dt;
+
+    timestamp_to_datetime(p_record->timestamp, &dt);
     NRF_LOG_RAW_INFO(
                "\n\n\x1B[1;36m=======\x1B[0m %s \x1B[1;36m=======\x1B[0m\n\n",
                p_title);
     NRF_LOG_RAW_INFO(
                "Fecha        : %02d/%02d/%04d\n",
-               p_record->day,
-               p_record->month,
-               p_record->year);
+               dt.day,
+               dt.month,
+               dt.year);
     NRF_LOG_RAW_INFO(
                "Hora         : %02d:%02d:%02d\n",
-               p_record->hour,
-               p_record->minute,
-               p_record->second);
+               dt.hour,
+               dt.minute,
+               dt.second);
     NRF_LOG_RAW_INFO("Contador ADV : %lu\n", p_record->contador);
     NRF_LOG_RAW_INFO("V1 (ADC1)    : %u\n", p_record->V1);
     NRF_LOG_RAW_INFO("V2 (ADC2)    : %u\n", p_record->V2);
@@ -551,18 +991,21 @@ datetime_t read_date_from_flash(void)
         return resultado;
     }
 
-    // Verificar tamaño en BYTES (no palabras)
-    const uint32_t data_size_bytes =
-               flash_record.p_header->length_words * sizeof(uint32_t);
-
-    if (data_size_bytes >= len) {
+    // Una palabra: segundos desde 2000. Dos: datetime_t del formato anterior
+    if (flash_record.p_header->length_words == 1) {
+        uint32_t timestamp;
+        memcpy(&timestamp, flash_record.p_data, sizeof(timestamp));
+        if (timestamp != TIMESTAMP_INVALID) {
+            timestamp_to_datetime(timestamp, &resultado);
+        }
+    }
+    else if (flash_record.p_header->length_words * sizeof(uint32_t) >= len) {
         memcpy(&resultado, flash_record.p_data, len);
     }
     else {
         NRF_LOG_RAW_INFO(
-                   "\n\t>> Dato corrupto: tamaño %u < %u",
-                   data_size_bytes,
-                   len);
+                   "\n\t>> Dato corrupto: tamaño %u palabras",
+                   flash_record.p_header->length_words);
     }
 
     // Cerrar usando DESCRIPTOR (no flash_record)
@@ -642,6 +1085,8 @@ void write_time_to_flash(valor_type_t valor_type, uint32_t valor)
 
 ret_code_t write_date_to_flash(const datetime_t *p_date)
 {
+    // FDS escribe de forma asíncrona desde este buffer
+    static uint32_t   timestamp;
     ret_code_t        err_code;
     fds_record_desc_t record_desc;
     fds_find_token_t  ftok   = {0};
@@ -649,9 +1094,14 @@ ret_code_t write_date_to_flash(const datetime_t *p_date)
     fds_record_t      record = {
                     .file_id = DATE_AND_TIME_FILE_ID,
                     .key     = DATE_AND_TIME_RECORD_KEY,
-                    .data    = {.p_data       = p_date,
-                                .length_words = (sizeof(datetime_t) + 3) /
-                                                sizeof(uint32_t)}};
+                    .data    = {.p_data       = &timestamp,
+                                .length_words = 1}};
+
+    timestamp = timestamp_from_datetime(p_date);
+    if (timestamp == TIMESTAMP_INVALID) {
+        NRF_LOG_RAW_INFO(LOG_FAIL " Fecha y hora fuera de rango");
+        return NRF_ERROR_INVALID_PARAM;
+    }
 
     err_code = fds_record_find(
                DATE_AND_TIME_FILE_ID,
@@ -877,6 +1327,16 @@ static uint32_t history_total_records  = 0;
 static uint32_t history_sent_count     = 0;
 static uint32_t history_failed_count   = 0;
 
+// Exportacion comprimida (negociada por sesion con el comando 21)
+static bool     history_compression_enabled = false;
+static bool     history_header_pending      = false;
+static bool     history_end_pending         = false;
+static uint8_t  history_block_seq           = 0;
+static uint8_t  history_block_buf[HISTORY_CODEC_FRAME_MAX];
+static uint16_t history_block_len           = 0; // > 0: bloque armado sin enviar
+static uint32_t history_block_next_record   = 0; // Indice tras el bloque armado
+static uint32_t history_block_records       = 0; // Registros dentro del bloque
+
 // Buffer para almacenar los record keys válidos encontrados por
 // fds_record_iterate
 #define MAX_HISTORY_RECORDS 248
@@ -902,29 +1362,212 @@ static ret_code_t read_history_record_by_key(
             return ret;
         }
 
-        // Verificar que el tamaño del registro sea correcto
-        if (flash_record.p_header->length_words !=
-            BYTES_TO_WORDS(sizeof(store_history))) {
+        // Copiar los datos al puntero de salida (formato actual o anterior)
+        if (!history_record_from_flash(&flash_record, p_history_data)) {
             NRF_LOG_ERROR("Tamaño del registro no coincide");
             fds_record_close(&desc);
             return NRF_ERROR_INVALID_DATA;
         }
 
-        // Copiar los datos al puntero de salida
-        memcpy(p_history_data, flash_record.p_data, sizeof(store_history));
-
         return fds_record_close(&desc);
     }
 
     return NRF_ERROR_NOT_FOUND;
 }
 
+static void history_record_to_codec(
+           store_history const    *p_record,
+           history_codec_record_t *p_out)
+{
+    p_out->timestamp = p_record->timestamp;
+    p_out->contador  = p_record->contador;
+    p_out->v[0]      = p_record->V1;
+    p_out->v[1]      = p_record->V2;
+    p_out->v[2]      = p_record->V3;
+    p_out->v[3]      = p_record->V4;
+    p_out->v[4]      = p_record->V5;
+    p_out->v[5]      = p_record->V6;
+    p_out->v[6]      = p_record->V7;
+    p_out->v[7]      = p_record->V8;
+    p_out->temp      = p_record->temp;
+    p_out->battery   = p_record->battery;
+}
+
+// Arma un bloque comprimido a partir de history_current_record, del tamano
+// de una notificacion en la conexion actual. Los registros que no se pueden
+// leer se cuentan como fallos y se saltan.
+static void history_build_block(void)
+{
+    history_codec_block_t block;
+    uint32_t              index = history_current_record;
+    uint16_t              capacity =
+               MIN(sizeof(history_block_buf), app_nus_server_max_data_len());
+
+    history_codec_block_begin(
+               &block,
+               history_block_buf,
+               capacity,
+               history_block_seq);
+    history_block_records = 0;
+
+    while (index < history_total_records && index < history_valid_count) {
+        store_history          record;
+        history_codec_record_t codec_record;
+
+        if (read_history_record_by_key(history_valid_keys[index], &record) !=
+            NRF_SUCCESS) {
+            history_failed_count++;
+            index++;
+            continue;
+        }
+
+        history_record_to_codec(&record, &codec_record);
+        if (!history_codec_block_add(&block, &codec_record)) {
+            break; // No cabe: queda para el siguiente bloque
+        }
+        history_block_records++;
+        index++;
+    }
+
+    history_block_next_record = index;
+    history_block_len = (history_block_records > 0) ? block.length : 0;
+}
+
+// Corta el envio comprimido: lo que falta se informa como fallos en END
+static void history_abort_blocks(void)
+{
+    history_failed_count += history_total_records - history_current_record;
+    history_current_record = history_total_records;
+    history_block_len      = 0;
+}
+
+// Envío del historial en modo comprimido: HEADER, bloques y END. Un bloque
+// rechazado por falta de buffers se reintenta tal cual en el siguiente TX_RDY.
+static void history_send_next_block(void)
+{
+    uint8_t    frame[8];
+    ret_code_t ret;
+
+    if (app_nus_server_max_data_len() < HISTORY_CODEC_BLOCK_MIN &&
+        history_current_record < history_total_records) {
+        NRF_LOG_RAW_INFO(
+                   LOG_FAIL " MTU insuficiente para la exportacion "
+                            "comprimida (%u < %u bytes)",
+                   app_nus_server_max_data_len(),
+                   HISTORY_CODEC_BLOCK_MIN);
+        history_abort_blocks();
+    }
+
+    if (history_header_pending) {
+        uint16_t len = history_codec_header_encode(
+                   frame,
+                   (uint16_t)history_total_records);
+        ret = app_nus_server_send_data(frame, len);
+        if (ret == NRF_ERROR_RESOURCES || ret == NRF_ERROR_BUSY) {
+            return;
+        }
+        if (ret != NRF_SUCCESS) {
+            NRF_LOG_RAW_INFO(
+                       LOG_FAIL " Error enviando cabecera comprimida: 0x%X",
+                       ret);
+            history_send_active = false;
+            return;
+        }
+        history_header_pending = false;
+    }
+
+    while (history_send_active &&
+           history_current_record < history_total_records) {
+        if (history_block_len == 0) {
+            history_build_block();
+            if (history_block_len == 0) {
+                // Solo quedaban registros ilegibles
+                history_current_record = history_block_next_record;
+                break;
+            }
+        }
+
+        ret = app_nus_server_send_data(history_block_buf, history_block_len);
+        if (ret == NRF_SUCCESS) {
+            history_current_record = history_block_next_record;
+            history_sent_count += history_block_records;
+            history_block_len = 0;
+            history_block_seq++;
+        }
+        else if (ret == NRF_ERROR_RESOURCES || ret == NRF_ERROR_BUSY) {
+            return; // Esperar al próximo TX_RDY
+        }
+        else {
+            NRF_LOG_RAW_INFO(
+                       LOG_FAIL " Error enviando bloque comprimido: 0x%X",
+                       ret);
+            history_abort_blocks();
+            break;
+        }
+    }
+
+    if (history_current_record >= history_total_records) {
+        history_end_pending = true;
+    }
+
+    if (history_end_pending) {
+        uint16_t len = history_codec_end_encode(
+                   frame,
+                   (uint16_t)history_sent_count,
+                   (uint16_t)history_failed_count);
+        ret = app_nus_server_send_data(frame, len);
+        if (ret != NRF_SUCCESS && ret != NRF_ERROR_RESOURCES &&
+            ret != NRF_ERROR_BUSY) {
+            // Sin conexion no hay a quien avisar
+            history_end_pending = false;
+            history_send_active = false;
+        }
+        else if (ret == NRF_SUCCESS) {
+            history_end_pending = false;
+            history_send_active = false;
+            NRF_LOG_RAW_INFO(
+                       "\n=== ENVIO DE HISTORIAL COMPRIMIDO COMPLETADO ===");
+            NRF_LOG_RAW_INFO(
+                       "\nRegistros enviados: %d/%d en %d bloques, Fallos: %d",
+                       history_sent_count,
+                       history_total_records,
+                       history_block_seq,
+                       history_failed_count);
+        }
+    }
+}
+
+void history_set_compression(bool enabled)
+{
+    history_compression_enabled = enabled;
+}
+
+bool history_compression_is_enabled(void)
+{
+    return history_compression_enabled;
+}
+
+ret_code_t history_send_compression_ack(void)
+{
+    uint8_t  frame[4];
+    uint16_t len = history_codec_ack_encode(frame, history_compression_enabled);
+    return app_nus_server_send_data(frame, len);
+}
+
 // Función auxiliar para enviar el siguiente paquete de historial (similar a
 // cmd15_send_next_packet)
 void history_send_next_packet(void)
 {
-    if (!history_send_active ||
-        history_current_record >= history_total_records) {
+    if (!history_send_active) {
+        return;
+    }
+
+    if (history_compression_enabled) {
+        history_send_next_block();
+        return;
+    }
+
+    if (history_current_record >= history_total_records) {
         return;
     }
 
@@ -971,13 +1614,8 @@ void history_send_next_packet(void)
         data_array[position++] = 0x08;
 
         // Bytes 1-7: Fecha y hora
-        data_array[position++] = current_record.day;
-        data_array[position++] = current_record.month;
-        data_array[position++] = (current_record.year >> 8) & 0xFF;
-        data_array[position++] = (current_record.year & 0xFF);
-        data_array[position++] = current_record.hour;
-        data_array[position++] = current_record.minute;
-        data_array[position++] = current_record.second;
+        position += history_put_ble_date(&data_array[position],
+                                         current_record.timestamp);
 
         // Bytes 8-11: Contador (4 bytes) - convertir a big-endian
         data_array[position++] = (current_record.contador >> 24) & 0xFF;
@@ -1117,12 +1755,11 @@ ret_code_t send_all_history(void)
     fds_find_token_t   token          = {0};
     fds_record_desc_t  record_desc    = {0};
     fds_flash_record_t flash_record   = {0};
-    uint16_t           expected_words = BYTES_TO_WORDS(sizeof(store_history));
 
     // Resetear contador y array de keys válidos
     history_valid_count = 0;
 
-    // Iterar a través de todos los registros del HISTORY_FILE_ID
+    // Iterar a través de todos los registros del archivo de historiales
     while (fds_record_iterate(&record_desc, &token) == NRF_SUCCESS &&
            history_valid_count < MAX_HISTORY_RECORDS) {
         // Abrir el registro para acceder a su header
@@ -1144,8 +1781,8 @@ ret_code_t send_all_history(void)
         }
 
         // Verificar que el tamaño sea correcto
-        if (flash_record.p_header->length_words ==
-            expected_words) { // Inicializado a 0
+        if (history_record_words_valid(
+                       flash_record.p_header->length_words)) {
             // Almacenar el record key válido
             history_valid_keys[history_valid_count] =
                        flash_record.p_header->record_key;
@@ -1186,10 +1823,15 @@ ret_code_t send_all_history(void)
     history_total_records  = history_valid_count;
     history_sent_count     = 0;
     history_failed_count   = 0;
+    history_header_pending = history_compression_enabled;
+    history_end_pending    = false;
+    history_block_len      = 0;
+    history_block_seq      = 0;
 
     NRF_LOG_RAW_INFO(
-               LOG_EXEC " Enviando %d registros de forma asincrona...",
-               history_total_records);
+               LOG_EXEC " Enviando %d registros de forma asincrona%s...",
+               history_total_records,
+               history_compression_enabled ? " (comprimido)" : "");
 
     // Enviar el primer lote de paquetes - los siguientes se enviarán en
     // BLE_NUS_EVT_TX_RDY
@@ -1230,6 +1872,7 @@ void delete_all_history(void)
     else {
         // Si se eliminaron exitosamente, resetear el contador
         config_repeater.cantidad_historiales = 0;
+        adv_payload_on_history(NULL);
         
         // Guardar la configuración actualizada
         ret_code_t save_ret = save_config_to_flash(&config_repeater);
@@ -1444,12 +2087,8 @@ void load_default_config(config_repeater_t *p_config)
     p_config->version[2] = 0;
 
     // Fecha y hora predeterminada de configuracion
-    p_config->fecha.year   = 2024;
-    p_config->fecha.month  = 1;
-    p_config->fecha.day    = 1;
-    p_config->fecha.hour   = 0;
-    p_config->fecha.minute = 0;
-    p_config->fecha.second = 0;
+    datetime_t fecha = {.year = 2024, .month = 1, .day = 1};
+    p_config->fecha  = timestamp_from_datetime(&fecha);
 
     // Cantidad de historiales guardados (inicialmente 0)
     p_config->cantidad_historiales = 0;
@@ -1465,8 +2104,8 @@ ret_code_t save_config_to_flash(config_repeater_t *p_config)
     }
 
     // Actualizar la fecha de configuracion con el tiempo actual del RTC
-    datetime_t current_time;
-    if (calendar_get_time(&current_time)) {
+    uint32_t current_time = calendar_get_timestamp(NULL);
+    if (current_time != TIMESTAMP_INVALID) {
         p_config->fecha = current_time;
     }
     else {
@@ -1482,9 +2121,7 @@ ret_code_t save_config_to_flash(config_repeater_t *p_config)
     record.file_id     = CONFIG_FILE_ID;
     record.key         = CONFIG_RECORD_KEY;
     record.data.p_data = p_config;
-    record.data.length_words =
-               (sizeof(config_repeater_t) + sizeof(uint32_t) - 1) /
-               sizeof(uint32_t);
+    record.data.length_words = CONFIG_WORDS;
 
     // Buscar si ya existe el registro
     ret = fds_record_find(
@@ -1523,6 +2160,23 @@ ret_code_t save_config_to_flash(config_repeater_t *p_config)
     return ret;
 }
 
+// Configuracion guardada con la fecha desglosada
+static void config_from_v1(
+           config_repeater_v1_t const *p_old,
+           config_repeater_t          *p_config)
+{
+    memcpy(p_config->mac_emisor, p_old->mac_emisor, 6);
+    memcpy(p_config->mac_repetidor, p_old->mac_repetidor, 6);
+    p_config->enable_custom_mac_repetidor = p_old->enable_custom_mac_repetidor;
+    p_config->tiempo_encendido            = p_old->tiempo_encendido;
+    p_config->tiempo_dormido              = p_old->tiempo_dormido;
+    p_config->tiempo_extendido            = p_old->tiempo_extendido;
+    p_config->tiempo_extendido_dormido    = p_old->tiempo_extendido_dormido;
+    p_config->fecha = timestamp_from_datetime(&p_old->fecha);
+    memcpy(p_config->version, p_old->version, 3);
+    p_config->cantidad_historiales = p_old->cantidad_historiales;
+}
+
 ret_code_t load_config_from_flash(config_repeater_t *p_config)
 {
     if (p_config == NULL) {
@@ -1545,22 +2199,24 @@ ret_code_t load_config_from_flash(config_repeater_t *p_config)
         // Abrir el registro
         ret = fds_record_open(&record_desc, &flash_record);
         if (ret == NRF_SUCCESS) {
-            // Verificar tamaño
-            uint32_t expected_words =
-                       (sizeof(config_repeater_t) + sizeof(uint32_t) - 1) /
-                       sizeof(uint32_t);
-            if (flash_record.p_header->length_words >= expected_words) {
+            // Verificar tamaño (el formato anterior es mas largo)
+            uint16_t length_words = flash_record.p_header->length_words;
+            if (length_words >= CONFIG_WORDS) {
                 // Copiar los datos
-                memcpy(p_config,
-                       flash_record.p_data,
-                       sizeof(config_repeater_t));
+                if (length_words == CONFIG_V1_WORDS) {
+                    config_from_v1(flash_record.p_data, p_config);
+                }
+                else {
+                    memcpy(p_config,
+                           flash_record.p_data,
+                           sizeof(config_repeater_t));
+                }
 
                 // Cerrar el registro
                 fds_record_close(&record_desc);
 
-                // Validar si la fecha es valida (diferente de cero)
-                if (p_config->fecha.year == 0 || p_config->fecha.month == 0 ||
-                    p_config->fecha.day == 0) {
+                // Validar si la fecha es valida
+                if (p_config->fecha == TIMESTAMP_INVALID) {
                     NRF_LOG_RAW_INFO(
                                LOG_FAIL " Fecha de configuracion no valida - "
                                         "configuracion antigua");
@@ -1597,6 +2253,107 @@ ret_code_t load_config_from_flash(config_repeater_t *p_config)
     return ret;
 }
 
+// Buffer estático: FDS escribe de forma asíncrona desde este puntero
+static gatt_cache_t m_gatt_cache_buffer;
+
+ret_code_t load_gatt_cache(gatt_cache_t *p_cache)
+{
+    fds_record_desc_t  record_desc;
+    fds_find_token_t   ftok = {0};
+    fds_flash_record_t flash_record;
+    ret_code_t         ret;
+
+    if (p_cache == NULL) {
+        return NRF_ERROR_NULL;
+    }
+
+    ret = fds_record_find(
+               GATT_CACHE_FILE_ID,
+               GATT_CACHE_RECORD_KEY,
+               &record_desc,
+               &ftok);
+    if (ret != NRF_SUCCESS) {
+        return ret;
+    }
+
+    ret = fds_record_open(&record_desc, &flash_record);
+    if (ret != NRF_SUCCESS) {
+        return ret;
+    }
+
+    if (flash_record.p_header->length_words !=
+        BYTES_TO_WORDS(sizeof(gatt_cache_t))) {
+        fds_record_close(&record_desc);
+        return NRF_ERROR_INVALID_DATA;
+    }
+
+    memcpy(p_cache, flash_record.p_data, sizeof(gatt_cache_t));
+    fds_record_close(&record_desc);
+
+    if (p_cache->magic != MAGIC_PASSWORD) {
+        return NRF_ERROR_INVALID_DATA;
+    }
+
+    return NRF_SUCCESS;
+}
+
+ret_code_t save_gatt_cache(gatt_cache_t const *p_cache)
+{
+    fds_record_desc_t record_desc;
+    fds_find_token_t  ftok = {0};
+    ret_code_t        ret;
+
+    if (p_cache == NULL) {
+        return NRF_ERROR_NULL;
+    }
+
+    memcpy(&m_gatt_cache_buffer, p_cache, sizeof(gatt_cache_t));
+    m_gatt_cache_buffer.magic = MAGIC_PASSWORD;
+
+    fds_record_t record = {
+               .file_id           = GATT_CACHE_FILE_ID,
+               .key               = GATT_CACHE_RECORD_KEY,
+               .data.p_data       = &m_gatt_cache_buffer,
+               .data.length_words = BYTES_TO_WORDS(sizeof(gatt_cache_t))};
+
+    ret = fds_record_find(
+               GATT_CACHE_FILE_ID,
+               GATT_CACHE_RECORD_KEY,
+               &record_desc,
+               &ftok);
+    if (ret == NRF_SUCCESS) {
+        ret = fds_record_update(&record_desc, &record);
+    }
+    else {
+        ret = fds_record_write(&record_desc, &record);
+    }
+
+    if (ret == NRF_SUCCESS) {
+        NRF_LOG_RAW_INFO(LOG_OK " Handles NUS del emisor guardados en cache");
+    }
+    else {
+        NRF_LOG_RAW_INFO(
+                   LOG_WARN " No se pudo guardar la cache GATT: 0x%X",
+                   ret);
+    }
+
+    return ret;
+}
+
+void delete_gatt_cache(void)
+{
+    fds_record_desc_t record_desc;
+    fds_find_token_t  ftok = {0};
+
+    if (fds_record_find(
+                   GATT_CACHE_FILE_ID,
+                   GATT_CACHE_RECORD_KEY,
+                   &record_desc,
+                   &ftok) == NRF_SUCCESS) {
+        fds_record_delete(&record_desc);
+        NRF_LOG_RAW_INFO(LOG_INFO " Cache GATT invalidada");
+    }
+}
 
 void set_custom_mac_repeater(void)
 {
@@ -1729,16 +2486,18 @@ void init_sistema_configuracion(config_repeater_t *p_config)
     nrf_delay_ms(15);
 
     // Mostrar fecha de configuracion
+    datetime_t fecha;
+    timestamp_to_datetime(p_config->fecha, &fecha);
     NRF_LOG_RAW_INFO(
                " - Fecha y hora  : %02u/%02u/%u ",
-               p_config->fecha.day,
-               p_config->fecha.month,
-               p_config->fecha.year);
+               fecha.day,
+               fecha.month,
+               fecha.year);
     NRF_LOG_RAW_INFO(
                "%02u:%02u:%02u\n",
-               p_config->fecha.hour,
-               p_config->fecha.minute,
-               p_config->fecha.second);
+               fecha.hour,
+               fecha.minute,
+               fecha.second);
     NRF_LOG_FLUSH();
     nrf_delay_ms(15);
 
@@ -1758,48 +2517,149 @@ void init_sistema_configuracion(config_repeater_t *p_config)
     set_custom_mac_repeater();
 }
 
-ret_code_t send_config_via_ble(void)
+// Buffer estático para la configuración serializada (sin heap en el camino BLE)
+static uint8_t m_config_tlv_buffer[CONFIG_TLV_BUFFER_SIZE];
+
+static const uint8_t m_config_tlv_all_tags[] = {
+           CONFIG_TLV_MAC_EMISOR,
+           CONFIG_TLV_MAC_REPETIDOR,
+           CONFIG_TLV_CUSTOM_MAC_ENABLED,
+           CONFIG_TLV_TIEMPO_ENCENDIDO,
+           CONFIG_TLV_TIEMPO_DORMIDO,
+           CONFIG_TLV_TIEMPO_EXTENDIDO,
+           CONFIG_TLV_TIEMPO_EXT_DORMIDO,
+           CONFIG_TLV_FECHA,
+           CONFIG_TLV_VERSION_FW,
+           CONFIG_TLV_CANTIDAD_HISTORIALES};
+
+static uint16_t tlv_put_u32(uint8_t *p_buf, uint8_t tag, uint32_t value)
 {
-    ret_code_t ret;
+    p_buf[0] = tag;
+    p_buf[1] = 4;
+    p_buf[2] = (value >> 24) & 0xFF;
+    p_buf[3] = (value >> 16) & 0xFF;
+    p_buf[4] = (value >> 8) & 0xFF;
+    p_buf[5] = (value & 0xFF);
+    return 6;
+}
 
-    // Crear buffer con identificadores + configuración
-    uint16_t config_size = sizeof(config_repeater_t);
-    uint16_t total_size =
-               2 + config_size; // 2 bytes identificadores + configuración
-    uint8_t *buffer = malloc(total_size);
+// Serializa un campo como TLV big-endian. Retorna 0 si la etiqueta no existe.
+static uint16_t config_tlv_put(
+           uint8_t                 *p_buf,
+           config_repeater_t const *p_config,
+           uint8_t                  tag)
+{
+    uint16_t   pos = 0;
+    datetime_t fecha;
+
+    switch (tag) {
+    case CONFIG_TLV_MAC_EMISOR:
+    case CONFIG_TLV_MAC_REPETIDOR:
+        p_buf[pos++] = tag;
+        p_buf[pos++] = 6;
+        memcpy(&p_buf[pos],
+               (tag == CONFIG_TLV_MAC_EMISOR) ? p_config->mac_emisor
+                                              : p_config->mac_repetidor,
+               6);
+        pos += 6;
+        break;
 
-    if (buffer == NULL) {
-        NRF_LOG_RAW_INFO(
-                   LOG_WARN " No se pudo reservar memoria para el buffer");
-        return NRF_ERROR_NO_MEM;
+    case CONFIG_TLV_CUSTOM_MAC_ENABLED:
+        p_buf[pos++] = tag;
+        p_buf[pos++] = 1;
+        p_buf[pos++] = p_config->enable_custom_mac_repetidor ? 1 : 0;
+        break;
+
+    case CONFIG_TLV_TIEMPO_ENCENDIDO:
+        pos = tlv_put_u32(p_buf, tag, p_config->tiempo_encendido);
+        break;
+
+    case CONFIG_TLV_TIEMPO_DORMIDO:
+        pos = tlv_put_u32(p_buf, tag, p_config->tiempo_dormido);
+        break;
+
+    case CONFIG_TLV_TIEMPO_EXTENDIDO:
+        pos = tlv_put_u32(p_buf, tag, p_config->tiempo_extendido);
+        break;
+
+    case CONFIG_TLV_TIEMPO_EXT_DORMIDO:
+        pos = tlv_put_u32(p_buf, tag, p_config->tiempo_extendido_dormido);
+        break;
+
+    case CONFIG_TLV_FECHA:
+        // En la trama la fecha sigue desglosada (año big-endian primero)
+        timestamp_to_datetime(p_config->fecha, &fecha);
+        p_buf[pos++] = tag;
+        p_buf[pos++] = 7;
+        p_buf[pos++] = (fecha.year >> 8) & 0xFF;
+        p_buf[pos++] = (fecha.year & 0xFF);
+        p_buf[pos++] = fecha.month;
+        p_buf[pos++] = fecha.day;
+        p_buf[pos++] = fecha.hour;
+        p_buf[pos++] = fecha.minute;
+        p_buf[pos++] = fecha.second;
+        break;
+
+    case CONFIG_TLV_VERSION_FW:
+        p_buf[pos++] = tag;
+        p_buf[pos++] = 3;
+        memcpy(&p_buf[pos], p_config->version, 3);
+        pos += 3;
+        break;
+
+    case CONFIG_TLV_CANTIDAD_HISTORIALES:
+        p_buf[pos++] = tag;
+        p_buf[pos++] = 2;
+        p_buf[pos++] = (p_config->cantidad_historiales >> 8) & 0xFF;
+        p_buf[pos++] = (p_config->cantidad_historiales & 0xFF);
+        break;
+
+    default:
+        break;
     }
 
-    // Agregar identificadores al inicio
-    buffer[0] = 0xCC;
-    buffer[1] = 0xAA;
+    return pos;
+}
 
-    // Copiar la estructura de configuración después de los identificadores
-    memcpy(&buffer[2], &config_repeater, config_size);
+ret_code_t send_config_fields_via_ble(const uint8_t *p_tags, uint8_t tag_count)
+{
+    ret_code_t ret;
+    uint16_t   position = 0;
 
-    // Enviar via BLE NUS
-    ret = app_nus_server_send_data(buffer, total_size);
+    if (p_tags == NULL || tag_count == 0) {
+        p_tags    = m_config_tlv_all_tags;
+        tag_count = sizeof(m_config_tlv_all_tags);
+    }
 
-    if (ret == NRF_SUCCESS) {
-        NRF_LOG_RAW_INFO(
-                   LOG_OK " Configuracion enviada via BLE con identificadores "
-                   "(%u "
-                   "bytes total)",
-                   total_size);
+    // Cabecera: identificadores + versión del formato
+    m_config_tlv_buffer[position++] = 0xCC;
+    m_config_tlv_buffer[position++] = 0xAA;
+    m_config_tlv_buffer[position++] = CONFIG_TLV_FORMAT_VERSION;
 
-        // Mostrar los primeros bytes en log para debug
-        NRF_LOG_RAW_INFO(LOG_INFO " Primeros bytes: ");
-        for (int i = 0; i < (total_size > 16 ? 16 : total_size); i++) {
-            NRF_LOG_RAW_INFO("%02X ", buffer[i]);
+    for (uint8_t i = 0; i < tag_count; i++) {
+        // Evitar desbordes del buffer si se piden etiquetas repetidas
+        if (position + CONFIG_TLV_MAX_FIELD_SIZE > sizeof(m_config_tlv_buffer)) {
+            break;
         }
-        if (total_size > 16) {
-            NRF_LOG_RAW_INFO("... (%u bytes total)", total_size);
+        uint16_t len = config_tlv_put(
+                   &m_config_tlv_buffer[position],
+                   &config_repeater,
+                   p_tags[i]);
+        if (len == 0) {
+            NRF_LOG_RAW_INFO(
+                       LOG_WARN " Campo de configuracion desconocido: 0x%02X",
+                       p_tags[i]);
         }
-        NRF_LOG_RAW_INFO("\n");
+        position += len;
+    }
+
+    ret = app_nus_server_send_data(m_config_tlv_buffer, position);
+
+    if (ret == NRF_SUCCESS) {
+        NRF_LOG_RAW_INFO(
+                   LOG_OK " Configuracion enviada via BLE (TLV v%u, %u bytes)",
+                   CONFIG_TLV_FORMAT_VERSION,
+                   position);
     }
     else {
         NRF_LOG_RAW_INFO(
@@ -1807,8 +2667,13 @@ ret_code_t send_config_via_ble(void)
                    ret);
     }
 
-    // Liberar memoria
-    free(buffer);
+    return ret;
+}
+
+ret_code_t send_config_via_ble(void)
+{
+    ret_code_t ret = send_config_fields_via_ble(NULL, 0);
+    datetime_t fecha;
 
     // También mostrar en log local para debug
     NRF_LOG_RAW_INFO("\n--- CONFIGURACION ACTUAL ---");
@@ -1841,14 +2706,15 @@ ret_code_t send_config_via_ble(void)
                config_repeater.version[0],
                config_repeater.version[1],
                config_repeater.version[2]);
+    timestamp_to_datetime(config_repeater.fecha, &fecha);
     NRF_LOG_RAW_INFO(
                "\nFecha Config: %02u/%02u/%u %02u:%02u:%02u",
-               config_repeater.fecha.day,
-               config_repeater.fecha.month,
-               config_repeater.fecha.year,
-               config_repeater.fecha.hour,
-               config_repeater.fecha.minute,
-               config_repeater.fecha.second);
+               fecha.day,
+               fecha.month,
+               fecha.year,
+               fecha.hour,
+               fecha.minute,
+               fecha.second);
     NRF_LOG_RAW_INFO(
                "\nCantidad Historiales: %u",
                config_repeater.cantidad_historiales);
@@ -13,16 +13,14 @@
 #include "nrf_log_ctrl.h"
 #include "variables.h"
 
-// Estructura de guardado de historiales
+// Estructura de guardado de historiales (7 palabras). Los registros del
+// formato anterior, con la fecha desglosada, se convierten al leerlos.
 typedef struct
 {
     uint16_t magic;
-    uint16_t year;
-    uint8_t  month;
-    uint8_t  day;
-    uint8_t  hour;
-    uint8_t  minute;
-    uint8_t  second;
+    uint8_t  temp;
+    uint8_t  battery;
+    uint32_t timestamp; // Segundos desde 2000 (timestamp.h)
     uint32_t contador;
     uint16_t V1;
     uint16_t V2;
@@ -32,8 +30,6 @@ typedef struct
     uint16_t V6;
     uint16_t V7;
     uint16_t V8;
-    uint8_t  temp;
-    uint8_t  battery;
 } store_history;
 
 typedef struct
@@ -52,11 +48,43 @@ typedef struct
     uint32_t   tiempo_dormido;
     uint32_t   tiempo_extendido;
     uint32_t   tiempo_extendido_dormido;
-    datetime_t fecha;
+    uint32_t   fecha;  // Segundos desde 2000 de la ultima configuracion
     uint8_t    version[3];
     uint16_t   cantidad_historiales;  // Cantidad de historiales guardados
 } config_repeater_t;
 
+// Handles del servicio NUS del emisor, guardados para evitar el descubrimiento
+// GATT en cada ciclo. Solo son validos para la MAC con la que se descubrieron.
+typedef struct
+{
+    uint16_t magic;
+    uint8_t  mac[6]; // Direccion del emisor (orden little-endian de BLE)
+    uint16_t nus_rx_handle;
+    uint16_t nus_tx_handle;
+    uint16_t nus_tx_cccd_handle;
+    uint16_t reserved;
+} gatt_cache_t;
+
+// Serialización TLV de la configuración (comandos 16 y 22).
+// Trama: [0xCC][0xAA][version][tag][len][valor big-endian]...
+#define CONFIG_TLV_FORMAT_VERSION 2
+#define CONFIG_TLV_MAX_FIELD_SIZE 9  // tag + len + 7 bytes (fecha)
+#define CONFIG_TLV_BUFFER_SIZE    80
+
+typedef enum
+{
+    CONFIG_TLV_MAC_EMISOR            = 0x01,
+    CONFIG_TLV_MAC_REPETIDOR         = 0x02,
+    CONFIG_TLV_CUSTOM_MAC_ENABLED    = 0x03,
+    CONFIG_TLV_TIEMPO_ENCENDIDO      = 0x04,
+    CONFIG_TLV_TIEMPO_DORMIDO        = 0x05,
+    CONFIG_TLV_TIEMPO_EXTENDIDO      = 0x06,
+    CONFIG_TLV_TIEMPO_EXT_DORMIDO    = 0x07,
+    CONFIG_TLV_FECHA                 = 0x08,
+    CONFIG_TLV_VERSION_FW            = 0x09,
+    CONFIG_TLV_CANTIDAD_HISTORIALES  = 0x0A
+} config_tlv_tag_t;
+
 extern adc_values_t      adc_values;
 extern config_repeater_t config_repeater;
 
@@ -81,14 +109,33 @@ ret_code_t load_adc_values(adc_values_t *adc_values_cargados);
 ret_code_t save_adc_values(adc_values_t const *valores_a_guardar);
 
 // History functions
+// Los historiales de cada emisor van a su propio archivo (file_id, ver
+// emisor_table.h). Las lecturas, exportaciones y borrados que pide el
+// celular trabajan siempre sobre HISTORY_FILE_ID (emisor principal).
 ret_code_t save_history_record_emisor(
+           uint16_t             file_id,
            store_history const *p_history_data,
            uint16_t             offset);
 ret_code_t read_history_record_by_id(
            uint16_t       record_id,
            store_history *p_history_data);
 void print_history_record(store_history const *p_record, const char *p_title);
+
+// Fecha en el formato de 7 bytes de las respuestas BLE: dia, mes, año
+// (big-endian), hora, minuto, segundo. Retorna los bytes escritos.
+uint16_t   history_put_ble_date(uint8_t *p_buf, uint32_t timestamp);
 ret_code_t read_last_history_record(store_history *p_history_data);
+uint8_t    history_read_latest(store_history *p_records, uint8_t max_records);
+
+// Escritura en lote (recuperacion de historiales faltantes): sin esperas
+// bloqueantes, las escrituras se encadenan con los eventos de FDS
+ret_code_t history_batch_append(
+           uint16_t             file_id,
+           store_history const *p_history_data,
+           uint16_t             offset);
+bool       history_batch_is_idle(void);
+uint8_t    history_batch_free_count(void); // Lugares libres en la cola
+bool       history_highest_local_id(uint16_t file_id, uint16_t *p_id);
 
 // ADV History functions (Extended Search Mode)
 ret_code_t save_adv_history_record(
@@ -104,6 +151,9 @@ ret_code_t send_all_history(void);
 void       history_send_next_packet(void);
 bool       history_send_is_active(void);
 uint32_t   history_get_progress(void);
+void       history_set_compression(bool enabled);
+bool       history_compression_is_enabled(void);
+ret_code_t history_send_compression_ack(void);
 
 // Date and time functions
 ret_code_t write_date_to_flash(const datetime_t *p_date);
@@ -113,6 +163,11 @@ uint32_t read_time_from_flash(valor_type_t valor_type, uint32_t default_valor);
 void     load_mac_from_flash(mac_type_t mac_type, uint8_t *mac_out);
 void     save_mac_to_flash(mac_type_t mac_type, uint8_t *mac_out);
 
+// GATT cache functions
+ret_code_t load_gatt_cache(gatt_cache_t *p_cache);
+ret_code_t save_gatt_cache(gatt_cache_t const *p_cache);
+void       delete_gatt_cache(void);
+
 // Configuration functions
 void       set_custom_mac_repeater(void);
 void       init_sistema_configuracion(config_repeater_t *p_config);
@@ -124,6 +179,7 @@ void       load_default_config(config_repeater_t *p_config);
 void       fds_initialize(void);
 
 ret_code_t send_config_via_ble(void);
+ret_code_t send_config_fields_via_ble(const uint8_t *p_tags, uint8_t tag_count);
 
 // typedef struct
 // {
@@ -0,0 +1,286 @@
+#include "history_codec.h"
+
+#include <stddef.h>
+#include <string.h>
+
+//-------------------------------------------------------------------------------------------------------------
+//                                      HELPERS
+//-------------------------------------------------------------------------------------------------------------
+
+// Obtiene el valor de un campo del registro segun su indice en la mascara
+static uint32_t field_get(history_codec_record_t const *p_record, uint8_t field)
+{
+    switch (field)
+    {
+    case 0:
+        return p_record->timestamp;
+    case 1:
+        return p_record->contador;
+    case 10:
+        return p_record->temp;
+    case 11:
+        return p_record->battery;
+    default:
+        return p_record->v[field - 2];
+    }
+}
+
+static void field_set(history_codec_record_t *p_record, uint8_t field, uint32_t value)
+{
+    switch (field)
+    {
+    case 0:
+        p_record->timestamp = value;
+        break;
+    case 1:
+        p_record->contador = value;
+        break;
+    case 10:
+        p_record->temp = (uint8_t)value;
+        break;
+    case 11:
+        p_record->battery = (uint8_t)value;
+        break;
+    default:
+        p_record->v[field - 2] = (uint16_t)value;
+        break;
+    }
+}
+
+static uint16_t varint_put(uint8_t *p_buf, uint32_t value)
+{
+    uint16_t len = 0;
+    while (value >= 0x80)
+    {
+        p_buf[len++] = (uint8_t)(value | 0x80);
+        value >>= 7;
+    }
+    p_buf[len++] = (uint8_t)value;
+    return len;
+}
+
+// Retorna los bytes consumidos, o 0 si el varint esta truncado
+static uint16_t varint_get(uint8_t const *p_buf, uint16_t available, uint32_t *p_value)
+{
+    uint32_t value = 0;
+    for (uint16_t i = 0; i < available && i < 5; i++)
+    {
+        value |= (uint32_t)(p_buf[i] & 0x7F) << (7 * i);
+        if ((p_buf[i] & 0x80) == 0)
+        {
+            *p_value = value;
+            return i + 1;
+        }
+    }
+    return 0;
+}
+
+static inline uint32_t zigzag_encode(int32_t value)
+{
+    return ((uint32_t)value << 1) ^ (uint32_t)(value >> 31);
+}
+
+static inline int32_t zigzag_decode(uint32_t value)
+{
+    return (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+}
+
+static uint16_t keyframe_put(uint8_t *p_buf, history_codec_record_t const *p_record)
+{
+    uint16_t pos = 0;
+
+    p_buf[pos++] = (p_record->timestamp >> 24) & 0xFF;
+    p_buf[pos++] = (p_record->timestamp >> 16) & 0xFF;
+    p_buf[pos++] = (p_record->timestamp >> 8) & 0xFF;
+    p_buf[pos++] = (p_record->timestamp & 0xFF);
+    p_buf[pos++] = (p_record->contador >> 24) & 0xFF;
+    p_buf[pos++] = (p_record->contador >> 16) & 0xFF;
+    p_buf[pos++] = (p_record->contador >> 8) & 0xFF;
+    p_buf[pos++] = (p_record->contador & 0xFF);
+    for (uint8_t i = 0; i < 8; i++)
+    {
+        p_buf[pos++] = (p_record->v[i] >> 8) & 0xFF;
+        p_buf[pos++] = (p_record->v[i] & 0xFF);
+    }
+    p_buf[pos++] = p_record->temp;
+    p_buf[pos++] = p_record->battery;
+
+    return pos;
+}
+
+static void keyframe_get(uint8_t const *p_buf, history_codec_record_t *p_record)
+{
+    uint16_t pos        = 0;
+
+    p_record->timestamp = ((uint32_t)p_buf[0] << 24) | ((uint32_t)p_buf[1] << 16) |
+                          ((uint32_t)p_buf[2] << 8) | p_buf[3];
+    p_record->contador  = ((uint32_t)p_buf[4] << 24) | ((uint32_t)p_buf[5] << 16) |
+                          ((uint32_t)p_buf[6] << 8) | p_buf[7];
+    pos                 = 8;
+    for (uint8_t i = 0; i < 8; i++)
+    {
+        p_record->v[i] = (uint16_t)((p_buf[pos] << 8) | p_buf[pos + 1]);
+        pos += 2;
+    }
+    p_record->temp    = p_buf[pos++];
+    p_record->battery = p_buf[pos++];
+}
+
+//-------------------------------------------------------------------------------------------------------------
+//                                      ENCODER
+//-------------------------------------------------------------------------------------------------------------
+
+void history_codec_block_begin(history_codec_block_t *p_block,
+                               uint8_t               *p_buf,
+                               uint16_t               capacity,
+                               uint8_t                seq)
+{
+    p_block->p_buf    = p_buf;
+    p_block->capacity = capacity;
+    p_block->count    = 0;
+    p_block->length   = HISTORY_CODEC_BLOCK_OVERHEAD;
+
+    p_buf[0]          = HISTORY_CODEC_TAG_BLOCK;
+    p_buf[1]          = seq;
+    p_buf[2]          = 0;
+}
+
+bool history_codec_block_add(history_codec_block_t        *p_block,
+                             history_codec_record_t const *p_record)
+{
+    if (p_block->count == UINT8_MAX)
+    {
+        return false;
+    }
+
+    // El primer registro del bloque va completo
+    if (p_block->count == 0)
+    {
+        if (p_block->length + HISTORY_CODEC_KEYFRAME_SIZE > p_block->capacity)
+        {
+            return false;
+        }
+        p_block->length += keyframe_put(&p_block->p_buf[p_block->length], p_record);
+    }
+    else
+    {
+        uint8_t  tmp[HISTORY_CODEC_MAX_DELTA_SIZE];
+        uint16_t len  = 2;
+        uint16_t mask = 0;
+
+        for (uint8_t field = 0; field < HISTORY_CODEC_FIELD_COUNT; field++)
+        {
+            int32_t delta =
+                (int32_t)(field_get(p_record, field) - field_get(&p_block->prev, field));
+            if (delta != 0)
+            {
+                mask |= (uint16_t)(1u << field);
+                len += varint_put(&tmp[len], zigzag_encode(delta));
+            }
+        }
+        tmp[0] = (mask >> 8) & 0xFF;
+        tmp[1] = (mask & 0xFF);
+
+        if (p_block->length + len > p_block->capacity)
+        {
+            return false;
+        }
+        memcpy(&p_block->p_buf[p_block->length], tmp, len);
+        p_block->length += len;
+    }
+
+    p_block->prev = *p_record;
+    p_block->count++;
+    p_block->p_buf[2] = p_block->count;
+
+    return true;
+}
+
+uint16_t history_codec_ack_encode(uint8_t *p_buf, bool enabled)
+{
+    p_buf[0] = HISTORY_CODEC_TAG_ACK;
+    p_buf[1] = HISTORY_CODEC_VERSION;
+    p_buf[2] = enabled ? 1 : 0;
+    return 3;
+}
+
+uint16_t history_codec_header_encode(uint8_t *p_buf, uint16_t total)
+{
+    p_buf[0] = HISTORY_CODEC_TAG_HEADER;
+    p_buf[1] = HISTORY_CODEC_VERSION;
+    p_buf[2] = (total >> 8) & 0xFF;
+    p_buf[3] = (total & 0xFF);
+    return 4;
+}
+
+uint16_t history_codec_end_encode(uint8_t *p_buf, uint16_t sent, uint16_t failed)
+{
+    p_buf[0] = HISTORY_CODEC_TAG_END;
+    p_buf[1] = (sent >> 8) & 0xFF;
+    p_buf[2] = (sent & 0xFF);
+    p_buf[3] = (failed >> 8) & 0xFF;
+    p_buf[4] = (failed & 0xFF);
+    return 5;
+}
+
+//-------------------------------------------------------------------------------------------------------------
+//                                      DECODER
+//-------------------------------------------------------------------------------------------------------------
+
+int32_t history_codec_block_decode(uint8_t const          *p_buf,
+                                   uint16_t                length,
+                                   history_codec_record_t *p_records,
+                                   uint16_t                max_records)
+{
+    if (p_buf == NULL || length < HISTORY_CODEC_BLOCK_OVERHEAD ||
+        p_buf[0] != HISTORY_CODEC_TAG_BLOCK)
+    {
+        return -1;
+    }
+
+    uint8_t  count = p_buf[2];
+    uint16_t pos   = HISTORY_CODEC_BLOCK_OVERHEAD;
+
+    if (count == 0)
+    {
+        return 0;
+    }
+    if (count > max_records || pos + HISTORY_CODEC_KEYFRAME_SIZE > length)
+    {
+        return -1;
+    }
+
+    keyframe_get(&p_buf[pos], &p_records[0]);
+    pos += HISTORY_CODEC_KEYFRAME_SIZE;
+
+    for (uint8_t i = 1; i < count; i++)
+    {
+        if (pos + 2 > length)
+        {
+            return -1;
+        }
+        uint16_t mask = (uint16_t)((p_buf[pos] << 8) | p_buf[pos + 1]);
+        pos += 2;
+
+        p_records[i] = p_records[i - 1];
+        for (uint8_t field = 0; field < HISTORY_CODEC_FIELD_COUNT; field++)
+        {
+            if ((mask & (1u << field)) == 0)
+            {
+                continue;
+            }
+            uint32_t raw  = 0;
+            uint16_t used = varint_get(&p_buf[pos], length - pos, &raw);
+            if (used == 0)
+            {
+                return -1;
+            }
+            pos += used;
+            field_set(&p_records[i],
+                      field,
+                      field_get(&p_records[i], field) + (uint32_t)zigzag_decode(raw));
+        }
+    }
+
+    return count;
+}
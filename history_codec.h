@@ -0,0 +1,75 @@
+#ifndef HISTORY_CODEC_H
+#define HISTORY_CODEC_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Codec de exportacion comprimida de historiales (modo negociado por sesion).
+// No depende del SDK: el mismo codigo se usa en el decodificador de referencia
+// del host (tools/history_decoder.c).
+//
+// Tramas:
+//   ACK    [0xC6][version][habilitado]
+//   HEADER [0xC7][version][total MSB][total LSB]
+//   BLOCK  [0xC8][seq][n][registro base (26 bytes)][deltas ...]
+//   END    [0xC9][enviados MSB][enviados LSB][fallos MSB][fallos LSB]
+//
+// Un bloque ocupa como maximo lo que admite una notificacion NUS en la
+// conexion actual (MTU - 3, hasta HISTORY_CODEC_FRAME_MAX). Si el envio se
+// corta, END cuenta como fallos los registros que no llegaron a salir.
+//
+// Registro base (big-endian): timestamp(4) contador(4) V1..V8(16) temp(1)
+// bateria(1). Cada registro siguiente del bloque se codifica como una mascara
+// de 16 bits con los campos que cambiaron, seguida del delta de cada campo
+// marcado en zigzag + varint. Cada bloque es decodificable por si solo.
+
+#define HISTORY_CODEC_VERSION        1
+
+#define HISTORY_CODEC_TAG_ACK        0xC6
+#define HISTORY_CODEC_TAG_HEADER     0xC7
+#define HISTORY_CODEC_TAG_BLOCK      0xC8
+#define HISTORY_CODEC_TAG_END        0xC9
+
+#define HISTORY_CODEC_FIELD_COUNT    12  // timestamp, contador, V1..V8, temp, bateria
+#define HISTORY_CODEC_KEYFRAME_SIZE  26
+#define HISTORY_CODEC_BLOCK_OVERHEAD 3
+#define HISTORY_CODEC_MAX_DELTA_SIZE (2 + HISTORY_CODEC_FIELD_COUNT * 5)
+#define HISTORY_CODEC_FRAME_MAX      128 // Tope; el bloque se ajusta al MTU negociado
+#define HISTORY_CODEC_BLOCK_MIN      (HISTORY_CODEC_BLOCK_OVERHEAD + HISTORY_CODEC_KEYFRAME_SIZE)
+
+typedef struct
+{
+    uint32_t timestamp; // Segundos desde 01/01/2000
+    uint32_t contador;
+    uint16_t v[8];      // V1..V8
+    uint8_t  temp;
+    uint8_t  battery;
+} history_codec_record_t;
+
+typedef struct
+{
+    uint8_t               *p_buf;
+    uint16_t               capacity;
+    uint16_t               length;
+    uint8_t                count;
+    history_codec_record_t prev;
+} history_codec_block_t;
+
+// Encoder
+void     history_codec_block_begin(history_codec_block_t *p_block,
+                                   uint8_t               *p_buf,
+                                   uint16_t               capacity,
+                                   uint8_t                seq);
+bool     history_codec_block_add(history_codec_block_t        *p_block,
+                                 history_codec_record_t const *p_record);
+uint16_t history_codec_ack_encode(uint8_t *p_buf, bool enabled);
+uint16_t history_codec_header_encode(uint8_t *p_buf, uint16_t total);
+uint16_t history_codec_end_encode(uint8_t *p_buf, uint16_t sent, uint16_t failed);
+
+// Decoder (referencia para la app)
+int32_t  history_codec_block_decode(uint8_t const          *p_buf,
+                                    uint16_t                length,
+                                    history_codec_record_t *p_records,
+                                    uint16_t                max_records);
+
+#endif // HISTORY_CODEC_H
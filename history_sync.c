@@ -0,0 +1,324 @@
+#include "history_sync.h"
+
+#include <stdio.h>
+
+#include "cmd_sequencer.h"
+#include "emisor_table.h"
+#include "nordic_common.h"
+#include "nrf_log.h"
+#include "relay.h"
+#include "variables.h"
+
+static bool     m_active    = false;
+static bool     m_stopped   = false; // No se piden mas en este ciclo
+static uint16_t m_next      = 0; // Proximo ID a pedir
+static uint16_t m_end       = 0; // Primer ID que ya no hace falta pedir
+static uint16_t m_requested = 0; // Pedidos en este ciclo
+static uint16_t m_received  = 0;
+static uint16_t m_missed    = HISTORY_SYNC_NONE; // Primer ID sin respuesta
+static uint16_t m_file_id   = HISTORY_FILE_ID;   // Archivo del emisor en curso
+
+// Historiales que llegaron con la cola de escritura llena: se vuelven a pedir
+static uint16_t m_retry[HISTORY_SYNC_IN_FLIGHT];
+static uint8_t  m_retry_count = 0;
+
+static bool     m_requesting    = false; // Dentro de history_sync_request_more
+static bool     m_request_again = false;
+
+// Primer ID que quedo sin recuperar en cada archivo. El ciclo siguiente
+// retoma desde ahi: el ID mas alto local ya no sirve de referencia porque el
+// "08" de cada conexion guarda la ultima posicion del emisor.
+typedef struct
+{
+    bool     used;
+    uint16_t file_id;
+    uint16_t from;
+} history_sync_resume_t;
+
+static history_sync_resume_t m_resume[EMISOR_TABLE_MAX];
+
+static history_sync_resume_t *resume_find(uint16_t file_id)
+{
+    for (uint8_t i = 0; i < EMISOR_TABLE_MAX; i++)
+    {
+        if (m_resume[i].used && m_resume[i].file_id == file_id)
+        {
+            return &m_resume[i];
+        }
+    }
+    return NULL;
+}
+
+static void resume_set(uint16_t file_id, uint16_t from)
+{
+    history_sync_resume_t *p_resume = resume_find(file_id);
+
+    for (uint8_t i = 0; p_resume == NULL && i < EMISOR_TABLE_MAX; i++)
+    {
+        if (!m_resume[i].used)
+        {
+            p_resume = &m_resume[i];
+        }
+    }
+    if (p_resume != NULL)
+    {
+        p_resume->used    = true;
+        p_resume->file_id = file_id;
+        p_resume->from    = from;
+    }
+}
+
+static void resume_clear(uint16_t file_id)
+{
+    history_sync_resume_t *p_resume = resume_find(file_id);
+
+    if (p_resume != NULL)
+    {
+        p_resume->used = false;
+    }
+}
+
+// Cierra la recuperacion. first_missing es el primer ID que no llego
+// (HISTORY_SYNC_NONE si estan todos).
+static void history_sync_finish(uint16_t first_missing)
+{
+    m_active = false;
+    NRF_LOG_RAW_INFO(LOG_OK " Recuperacion de historiales: %u recibidos", m_received);
+
+    first_missing = MIN(first_missing, m_missed);
+    for (uint8_t i = 0; i < m_retry_count; i++)
+    {
+        first_missing = MIN(first_missing, m_retry[i]);
+    }
+    m_retry_count = 0;
+    if (m_next < m_end)
+    {
+        first_missing = MIN(first_missing, m_next);
+    }
+    if (first_missing < m_end)
+    {
+        NRF_LOG_RAW_INFO(LOG_INFO " Quedan historiales desde el %u para el proximo ciclo",
+                         first_missing);
+        resume_set(m_file_id, first_missing);
+    }
+    else
+    {
+        resume_clear(m_file_id);
+    }
+}
+
+static void history_sync_fail_handler(uint16_t context);
+
+static bool history_sync_request(uint16_t id)
+{
+    char cmd[CMD_SEQ_MAX_CMD_LEN];
+    int  len = snprintf(cmd, sizeof(cmd), EMISOR_CMD_HISTORY_BY_ID "%u", id);
+
+    return cmd_seq_push_with_handler((uint8_t *)cmd,
+                                     (uint16_t)len,
+                                     0x08,
+                                     CMD_SEQ_DEFAULT_TIMEOUT_MS,
+                                     CMD_SEQ_DEFAULT_RETRIES,
+                                     history_sync_fail_handler,
+                                     id) == NRF_SUCCESS;
+}
+
+// Mantiene hasta HISTORY_SYNC_IN_FLIGHT pedidos en el secuenciador sin pasar
+// el limite por ciclo. Si el reenvio al celular esta saturado se deja uno solo
+// en curso hasta que se descargue, y nunca hay mas pedidos en curso que
+// lugares libres en la cola de escritura (se sigue en
+// history_sync_on_batch_space). Sin pedidos en curso ni espera la
+// recuperacion termina, tambien si se llego al limite o se dejo de pedir.
+static void history_sync_request_round(void)
+{
+    uint8_t outstanding = cmd_seq_pending_count(0x08);
+    uint8_t window =
+        relay_is_throttled(RELAY_DIR_TO_PHONE) ? 1 : HISTORY_SYNC_IN_FLIGHT;
+    bool    pending;
+
+    window = MIN(window, history_batch_free_count());
+
+    while (outstanding < window && m_retry_count > 0)
+    {
+        uint16_t id = m_retry[--m_retry_count];
+
+        if (!history_sync_request(id))
+        {
+            m_retry[m_retry_count++] = id;
+            break;
+        }
+        outstanding = cmd_seq_pending_count(0x08);
+    }
+
+    while (m_retry_count == 0 && !m_stopped && outstanding < window && m_next < m_end &&
+           m_requested < HISTORY_SYNC_MAX_PER_CYCLE)
+    {
+        if (!history_sync_request(m_next))
+        {
+            break;
+        }
+        m_next++;
+        m_requested++;
+        // Un rechazo del stack ya lo saco de la cola
+        outstanding = cmd_seq_pending_count(0x08);
+    }
+
+    // Solo se espera si lo que falta quedo frenado por la cola de escritura
+    pending = m_retry_count > 0 ||
+              (!m_stopped && m_next < m_end && m_requested < HISTORY_SYNC_MAX_PER_CYCLE);
+    if (outstanding == 0 && !(pending && history_batch_free_count() == 0))
+    {
+        history_sync_finish(HISTORY_SYNC_NONE);
+    }
+}
+
+// Un rechazo del stack llama a history_sync_fail_handler desde adentro de
+// cmd_seq_push_with_handler: esa llamada anidada solo pide otra vuelta
+static void history_sync_request_more(void)
+{
+    if (m_requesting)
+    {
+        m_request_again = true;
+        return;
+    }
+
+    m_requesting = true;
+    do
+    {
+        m_request_again = false;
+        history_sync_request_round();
+    } while (m_request_again && m_active);
+    m_requesting = false;
+}
+
+// Un pedido se descarto sin respuesta: se anota el ID para el proximo ciclo.
+// Si el emisor no respondio ninguno (firmware sin "11") no se piden mas.
+static void history_sync_fail_handler(uint16_t context)
+{
+    if (!m_active)
+    {
+        return;
+    }
+
+    m_missed = MIN(m_missed, context);
+    if (m_received == 0 && !m_stopped)
+    {
+        NRF_LOG_RAW_INFO(LOG_WARN " El emisor no responde al pedido de historial %u", context);
+        m_stopped = true;
+    }
+    history_sync_request_more();
+}
+
+void history_sync_on_last_position(uint16_t file_id, uint16_t last_position)
+{
+    history_sync_resume_t *p_resume;
+    uint16_t               highest;
+    uint16_t               first;
+
+    if (m_active)
+    {
+        return;
+    }
+
+    if (history_highest_local_id(file_id, &highest))
+    {
+        if (last_position < highest)
+        {
+            // El emisor reinicio su numeracion: no hay forma segura de
+            // saber que falta
+            NRF_LOG_RAW_INFO(LOG_WARN " Posicion del emisor (%u) menor a la local (%u)",
+                             last_position,
+                             highest);
+            resume_clear(file_id);
+            return;
+        }
+        first = highest + 1;
+    }
+    else
+    {
+        first = (last_position > HISTORY_SYNC_MAX_BACKLOG)
+                    ? last_position - HISTORY_SYNC_MAX_BACKLOG
+                    : 0;
+    }
+
+    // Lo que quedo pendiente de ciclos anteriores. Los IDs entre ese y el mas
+    // alto local que ya estaban se vuelven a pedir; se sobrescriben igual.
+    p_resume = resume_find(file_id);
+    if (p_resume != NULL && p_resume->from < first)
+    {
+        first = p_resume->from;
+    }
+
+    // last_position llega en la misma respuesta, no hace falta pedirlo
+    if (first >= last_position)
+    {
+        resume_clear(file_id);
+        return;
+    }
+
+    NRF_LOG_RAW_INFO(LOG_EXEC " Recuperando historiales %u a %u del emisor",
+                     first,
+                     last_position - 1);
+
+    m_active      = true;
+    m_stopped     = false;
+    m_missed      = HISTORY_SYNC_NONE;
+    m_retry_count = 0;
+    m_file_id     = file_id;
+    m_next        = first;
+    m_end         = last_position;
+    m_requested   = 0;
+    m_received    = 0;
+
+    history_sync_request_more();
+}
+
+void history_sync_on_record(store_history const *p_record, uint16_t position)
+{
+    ret_code_t ret = history_batch_append(m_file_id, p_record, position);
+    if (ret == NRF_ERROR_NO_MEM && m_active && m_retry_count < HISTORY_SYNC_IN_FLIGHT)
+    {
+        // Cola de escritura llena (no deberia pasar, los pedidos se limitan
+        // a los lugares libres): se vuelve a pedir cuando haya lugar
+        m_retry[m_retry_count++] = position;
+    }
+    else if (ret != NRF_SUCCESS)
+    {
+        NRF_LOG_RAW_INFO(LOG_FAIL " No se pudo guardar el historial %u: 0x%X", position, ret);
+        m_missed = MIN(m_missed, position);
+    }
+
+    m_received++;
+
+    if (m_active)
+    {
+        history_sync_request_more();
+    }
+}
+
+void history_sync_on_batch_space(void)
+{
+    if (m_active)
+    {
+        history_sync_request_more();
+    }
+}
+
+bool history_sync_is_active(void)
+{
+    return m_active;
+}
+
+void history_sync_reset(void)
+{
+    if (m_active)
+    {
+        // Los pedidos salen y se responden en orden: los que siguen en la
+        // cola son los ultimos pedidos
+        uint16_t outstanding = cmd_seq_pending_count(0x08);
+
+        NRF_LOG_RAW_INFO(LOG_WARN " Recuperacion de historiales interrumpida");
+        history_sync_finish(m_next - MIN(outstanding, m_next));
+    }
+    m_active = false;
+}
@@ -0,0 +1,42 @@
+#ifndef HISTORY_SYNC_H
+#define HISTORY_SYNC_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "filesystem.h"
+
+// Recuperacion de historiales que el emisor genero en ciclos sin conexion.
+//
+// Con la respuesta al comando "08" se conoce la ultima posicion del emisor
+// (last_position). Si hay IDs entre el mas alto guardado localmente y esa
+// posicion, se piden de a HISTORY_SYNC_IN_FLIGHT con el secuenciador de
+// comandos, hasta HISTORY_SYNC_MAX_PER_CYCLE por ciclo. Lo que falte (por el
+// limite, por pedidos sin respuesta o por desconexion) se continua en el
+// siguiente ciclo desde el primer ID que no llego.
+
+#define HISTORY_SYNC_NONE 0xFFFF
+
+/**@brief Procesa la respuesta al "08" del ciclo e inicia la recuperacion si
+ *        faltan historiales.
+ *
+ * @param[in] file_id Archivo de historiales del emisor conectado.
+ */
+void history_sync_on_last_position(uint16_t file_id, uint16_t last_position);
+
+/**@brief Procesa un historial recibido durante la recuperacion: lo guarda en
+ *        lote, en el archivo de la recuperacion en curso, y pide el siguiente.
+ */
+void history_sync_on_record(store_history const *p_record, uint16_t position);
+
+/**@brief La cola de escritura en lote libero lugares (filesystem.c). */
+void history_sync_on_batch_space(void);
+
+bool history_sync_is_active(void);
+
+/**@brief Cancela la recuperacion en curso (desconexion del emisor). Llamar
+ *        antes de cmd_seq_reset para saber que pedidos quedaron sin respuesta.
+ */
+void history_sync_reset(void);
+
+#endif // HISTORY_SYNC_H
@@ -2,11 +2,14 @@
 #include <stdint.h>
 #include <stdio.h>
 
+#include "adv_broadcast.h"
+#include "adv_payload.h"
+#include "adv_tracker.h"
 #include "app_error.h"
 #include "app_nus_client.h"
 #include "app_nus_server.h"
+#include "app_scheduler.h"
 #include "app_timer.h"
-#include "app_uart.h"
 #include "app_util.h"
 #include "ble.h"
 #include "ble_gap.h"
@@ -15,7 +18,10 @@
 #include "bsp_btn_ble.h"
 #include "button.h"
 #include "calendar.h"
+#include "emisor_table.h"
+#include "energy.h"
 #include "filesystem.h"
+#include "history_sync.h"
 #include "leds.h"
 #include "nordic_common.h"
 #include "nrf_ble_gatt.h"
@@ -29,11 +35,16 @@
 #include "nrf_sdh_ble.h"
 #include "nrf_sdh_soc.h"
 #include "nrf_ble_scan.h"
+#include "power_fsm.h"
+#include "relay.h"
+#include "relay_queue.h"
+#include "rendezvous.h"
+#include "rtc_timer.h"
+#include "telemetry.h"
+#include "time_sync.h"
+#include "uart_bridge.h"
 #include "variables.h"
 
-// Forward declarations
-void activate_extended_search_mode(void);
-
 // store_flash Flash_array = {0};
 adc_values_t      adc_values      = {0};
 config_repeater_t config_repeater = {0};
@@ -107,91 +118,46 @@ config_repeater_t config_repeater = {0};
 // #define RTC_SLEEP_TICKS (10 * 8)
 
 NRF_BLE_GATT_DEF(m_gatt); /**< GATT module instance. */
-nrfx_rtc_t           m_rtc                     = NRFX_RTC_INSTANCE(2);
-bool                 m_device_active           = true;
-bool                 m_connected_this_cycle    = false;
-bool                 m_extended_mode_on        = false;
-
 bool                 m_reconnection_mode       = false; // BORRAR
 bool                 m_emisor_found_this_cycle = false; // BORRAR
 
 // Extended search mode variables
-bool                 m_extended_search_active  = false;
-uint8_t              m_extended_search_seconds_remaining = 0;
 bool                 m_emisor_adv_detected     = false;
+
+// Contadores de ADV de la busqueda extendida (verifican el filtrado)
+static struct {
+    uint32_t total;            // Reportes entregados por la SoftDevice
+    uint32_t rejected_company; // Descartados por company ID
+    uint32_t rejected_mac;     // Company ID correcto pero no es el emisor principal
+    uint32_t matched;          // ADV de un emisor de la tabla
+} m_adv_stats;
 uint32_t             m_last_adv_contador       = 0; // Para evitar duplicados
 
 static uint16_t      m_conn_handle             = BLE_CONN_HANDLE_INVALID;
-static volatile bool m_rtc_on_flag             = false;
-static volatile bool m_rtc_sleep_flag          = false;
 static uint16_t      m_ble_nus_max_data_len =
            BLE_GATT_ATT_MTU_DEFAULT - OPCODE_LENGTH - HANDLE_LENGTH;
 //
 
-void uart_event_handler(app_uart_evt_t *p_event)
+// Bloque recibido por la UART (ya delimitado por silencio en la linea). Se
+// reenvia en tramas del tamano maximo que admite NUS.
+static void uart_rx_handler(uint8_t const *p_data, uint16_t length)
 {
-    static uint8_t  data_array[BLE_NUS_MAX_DATA_LEN];
-    static uint16_t index = 0;
-    uint32_t        ret_val;
-
-    switch (p_event->evt_type) {
-        /**@snippet [Handling data from UART] */
-
-    case APP_UART_DATA_READY:
-        UNUSED_VARIABLE(app_uart_get(&data_array[index]));
-        index++;
-        if ((data_array[index - 1] == '\n') ||
-            (data_array[index - 1] == '\r') ||
-            (index >= (m_ble_nus_max_data_len))) {
-            NRF_LOG_DEBUG("Ready to send data over BLE NUS client and server");
-            NRF_LOG_HEXDUMP_DEBUG(data_array, index);
-            app_nus_client_send_data(data_array, index);
-            app_nus_server_send_data(data_array, index);
-            index = 0;
-        }
-        break;
-
-        /**@snippet [Handling data from UART] */
-
-    case APP_UART_COMMUNICATION_ERROR:
-        NRF_LOG_ERROR("Communication error occurred while handling UART.");
-        // No hacer crash, solo loggear el error
-        NRF_LOG_ERROR(
-                   "UART Communication error code: 0x%X",
-                   p_event->data.error_communication);
-        break;
+    NRF_LOG_DEBUG("Ready to send data over BLE NUS client and server");
+    NRF_LOG_HEXDUMP_DEBUG(p_data, length);
 
-    case APP_UART_FIFO_ERROR:
-        NRF_LOG_ERROR("Error occurred in FIFO module used by UART.");
-        // No hacer crash, solo loggear el error
-        NRF_LOG_ERROR("UART FIFO error code: 0x%X", p_event->data.error_code);
-        break;
+    while (length > 0) {
+        uint16_t chunk = MIN(length, m_ble_nus_max_data_len);
 
-    default:
-        break;
+        (void)relay_to_emisor(p_data, chunk);
+        (void)relay_to_phone(p_data, chunk);
+        p_data += chunk;
+        length -= chunk;
     }
 }
 
 static void uart_init(void)
 {
-    ret_code_t                   err_code;
-
-    app_uart_comm_params_t const comm_params = {
-               .rx_pin_no    = RX_PIN_NUMBER,
-               .tx_pin_no    = TX_PIN_NUMBER,
-               .rts_pin_no   = RTS_PIN_NUMBER,
-               .cts_pin_no   = CTS_PIN_NUMBER,
-               .flow_control = APP_UART_FLOW_CONTROL_DISABLED,
-               .use_parity   = false,
-               .baud_rate    = UART_BAUDRATE_BAUDRATE_Baud115200};
-
-    APP_UART_FIFO_INIT(
-               &comm_params,
-               UART_RX_BUF_SIZE,
-               UART_TX_BUF_SIZE,
-               uart_event_handler,
-               APP_IRQ_PRIORITY_LOWEST,
-               err_code);
+    ret_code_t err_code = uart_bridge_init(uart_rx_handler);
 
     if (err_code != NRF_SUCCESS) {
         NRF_LOG_ERROR("UART initialization failed with error: 0x%X", err_code);
@@ -201,169 +167,33 @@ static void uart_init(void)
     // NRF_LOG_INFO("UART initialized successfully");
 }
 
-void rtc_handler(nrfx_rtc_int_type_t int_type)
-{
-    if (int_type == NRFX_RTC_INT_COMPARE0) {
-        m_rtc_on_flag = true;
-    }
-
-    else if (int_type == NRFX_RTC_INT_COMPARE1) {
-        m_rtc_sleep_flag = true;
-    }
-
-    else if (int_type == NRFX_RTC_INT_COMPARE2) {
-        calendar_rtc_handler();
-        
-        // Verificar si estamos en modo activo y quedan 5 segundos antes de dormir
-        if (m_device_active && !m_connected_this_cycle && !m_extended_search_active) {
-            // Obtener el contador actual y el valor de COMPARE0 (cuando se apagará)
-            uint32_t current_counter = nrfx_rtc_counter_get(&m_rtc);
-            uint32_t compare0_value = nrf_rtc_cc_get(m_rtc.p_reg, 0);
-            
-            // Calcular ticks restantes (manejando wrap-around de 24 bits)
-            uint32_t ticks_remaining;
-            if (compare0_value > current_counter) {
-                ticks_remaining = compare0_value - current_counter;
-            } else {
-                ticks_remaining = (0xFFFFFF - current_counter) + compare0_value;
-            }
-            
-            // Convertir ticks a segundos (8 ticks = 1 segundo)
-            uint32_t seconds_remaining = ticks_remaining / 8;
-            
-            // Si quedan exactamente 5 segundos, activar búsqueda extendida
-            if (seconds_remaining == EXTENDED_SEARCH_DURATION_SECONDS) {
-                activate_extended_search_mode();
-            }
-        }
-        
-        // Manejar countdown de búsqueda extendida
-        if (m_extended_search_active && m_extended_search_seconds_remaining > 0) {
-            m_extended_search_seconds_remaining--;
-            NRF_LOG_RAW_INFO(LOG_INFO " Busqueda extendida: %u segundos restantes...",
-                           m_extended_search_seconds_remaining);
-            
-            if (m_extended_search_seconds_remaining == 0) {
-                m_extended_search_active = false;
-                NRF_LOG_RAW_INFO(LOG_WARN " Tiempo de busqueda extendida agotado");
-                
-                // Restaurar escaneo activo (con auto-conexión) si aún estamos en modo activo
-                if (m_device_active) {
-                    NRF_LOG_RAW_INFO(LOG_INFO " Restaurando modo de escaneo activo...");
-                    scan_start_active_mode();
-                }
-            }
-        }
-    }
-}
+// Contador de app_timer al vencer el sleep, para medir la reanudacion
+static volatile uint32_t m_sleep_end_cnt = 0;
 
-void handle_rtc_events(void)
+// En interrupcion solo se publican eventos; la maquina de estados corre en
+// el lazo principal
+static void rtc_timer_evt_handler(rtc_timer_id_t id)
 {
-    ret_code_t err_code;
-
-    if (m_rtc_on_flag) {
-        m_rtc_on_flag = false;
-
-        if (m_device_active) {
-            disconnect_all_devices();
-            advertising_stop();
-            scan_stop();
-            app_uart_close();
-
-            nrf_gpio_pin_clear(LED1_PIN);
-
-            m_device_active = false;
-
-            if (!m_connected_this_cycle) {
-                NRF_LOG_RAW_INFO(
-                           "\n" LOG_INFO " Transicion a \033[1;36mMODO SLEEP "
-                           "EXTENDIDO\033[0m");
-                uint32_t extended_on_ms = read_time_from_flash(
-                           TIEMPO_EXTENDED_ENCENDIDO,
-                           DEFAULT_DEVICE_EXTENDED_ON_TIME_MS);
-                uint32_t extended_sleep_ms = read_time_from_flash(
-                           TIEMPO_EXTENDED_SLEEP,
-                           DEFAULT_DEVICE_EXTENDED_SLEEP_TIME_MS);
-                NRF_LOG_RAW_INFO(
-                           LOG_INFO
-                           " Modo extendido ACTIVADO (ON=%u ms, SLEEP=%u ms)",
-                           extended_on_ms,
-                           extended_sleep_ms);
-                m_extended_mode_on = true;
-                restart_extended_sleep_rtc();
-            }
-            else {
-                NRF_LOG_RAW_INFO(
-                           "\n" LOG_INFO
-                           " Transicion a \033[1;36mMODO SLEEP\033[0m");
-                uint32_t on_ms = read_time_from_flash(
-                           TIEMPO_ENCENDIDO,
-                           DEFAULT_DEVICE_ON_TIME_MS);
-                uint32_t sleep_ms = read_time_from_flash(
-                           TIEMPO_SLEEP,
-                           DEFAULT_DEVICE_SLEEP_TIME_MS);
-                NRF_LOG_RAW_INFO(
-                           LOG_INFO " Modo normal (ON=%u ms, SLEEP=%u ms)",
-                           on_ms,
-                           sleep_ms);
-                m_extended_mode_on = false;
-                restart_sleep_rtc();
-            }
-
-            m_connected_this_cycle = false;
-        }
-    }
+    switch (id) {
+    case RTC_TIMER_ON:
+        power_fsm_post(PWR_EVT_ON_TIMEOUT);
+        break;
 
-    if (m_rtc_sleep_flag) {
-        m_rtc_sleep_flag = false;
+    case RTC_TIMER_SLEEP:
+        m_sleep_end_cnt = app_timer_cnt_get();
+        power_fsm_post(PWR_EVT_SLEEP_TIMEOUT);
+        break;
 
-        if (!m_device_active) {
-            nrf_gpio_pin_set(LED1_PIN);
+    case RTC_TIMER_SEARCH:
+        power_fsm_post(PWR_EVT_SEARCH_TIMER);
+        break;
 
-            if (m_extended_mode_on) {
-                NRF_LOG_RAW_INFO(
-                           "\n" LOG_INFO " Transicion a \033[1;32mMODO ACTIVO "
-                           "EXTENDIDO\033[0m");
-            }
-            else {
-                NRF_LOG_RAW_INFO(
-                           "\n" LOG_INFO
-                           " Transicion a \033[1;32mMODO ACTIVO\033[0m");
-            }
+    case RTC_TIMER_SECOND:
+        power_fsm_post(PWR_EVT_SECOND);
+        break;
 
-            save_config_to_flash(&config_repeater);
-            NRF_LOG_RAW_INFO(
-                       LOG_OK
-                       " Guardado de fecha y hora actual: %02u/%02u/%04u, "
-                       "%02u:%02u:%02u",
-                       m_time.day,
-                       m_time.month,
-                       m_time.year,
-                       m_time.hour,
-                       m_time.minute,
-                       m_time.second);
-
-            advertising_init();
-
-            // Asegurarse de que la búsqueda extendida esté desactivada al iniciar nuevo ciclo
-            m_extended_search_active = false;
-            m_extended_search_seconds_remaining = 0;
-            
-            // Actualizar el payload para mostrar los adc_values
-            // Iniciar con escaneo activo (con auto-conexión) al comenzar nuevo ciclo
-            scan_start_active_mode();
-            advertising_start();
-            uart_init();
-            m_device_active        = true;
-            m_connected_this_cycle = false;
-
-            if (m_extended_mode_on) {
-                restart_extended_on_rtc();
-            }
-            else {
-                restart_on_rtc();
-            }
-        }
+    default:
+        break;
     }
 }
 
@@ -377,31 +207,7 @@ void rtc_init(void)
     while (!nrf_drv_clock_lfclk_is_running()) {
     }
 
-    // Configurar RTC con prescaler CORRECTO
-    nrfx_rtc_config_t config = NRFX_RTC_DEFAULT_CONFIG;
-    config.prescaler         = RTC_PRESCALER;
-    ret_code_t err_code      = nrfx_rtc_init(&m_rtc, &config, rtc_handler);
-    APP_ERROR_CHECK(err_code);
-
-    // Limpiar contador y comenzar desde cero
-    nrfx_rtc_counter_clear(&m_rtc);
-
-    // Configurar comparadores iniciales
-    ret_code_t on_ms = read_time_from_flash(
-               TIEMPO_ENCENDIDO,
-               DEFAULT_DEVICE_ON_TIME_MS);
-    // Solo programar el primer evento de 15s
-    nrfx_rtc_cc_set(&m_rtc, 0, (on_ms / 1000) * 8, true);
-
-    // Deshabilitar el evento de 20s inicialmente
-    nrfx_rtc_cc_disable(&m_rtc, 1);
-
-    // Habilitar interrupciones
-    nrfx_rtc_int_enable(
-               &m_rtc,
-               NRF_RTC_INT_COMPARE0_MASK | NRF_RTC_INT_COMPARE1_MASK |
-                          NRF_RTC_INT_COMPARE2_MASK);
-    nrfx_rtc_enable(&m_rtc);
+    rtc_timer_init(rtc_timer_evt_handler);
     nrf_gpio_pin_set(LED1_PIN);
 }
 
@@ -420,35 +226,18 @@ static void ble_nus_chars_received_uart_print(
            uint8_t *p_data,
            uint16_t data_len)
 {
-    ret_code_t ret_val;
-
     NRF_LOG_DEBUG("Receiving data.");
     NRF_LOG_HEXDUMP_DEBUG(p_data, data_len);
 
-    for (uint32_t i = 0; i < data_len; i++) {
-        uint32_t timeout_counter = 0;
-        do {
-            ret_val = app_uart_put(p_data[i]);
-            if ((ret_val != NRF_SUCCESS) && (ret_val != NRF_ERROR_BUSY)) {
-                NRF_LOG_ERROR(
-                           "app_uart_put failed for index 0x%04x, error: 0x%X",
-                           i,
-                           ret_val);
-                // No hacer crash, solo salir del loop
-                break;
-            }
-
-            // Timeout para evitar loops infinitos
-            timeout_counter++;
-            if (timeout_counter > 10000) {
-                NRF_LOG_WARNING("UART timeout, skipping byte %d", i);
-                break;
-            }
-        } while (ret_val == NRF_ERROR_BUSY);
+    // Se encola sin esperar al puerto serie; si no hay lugar se descarta
+    // segun la politica de uart_bridge (y se cuenta)
+    if (uart_bridge_send(p_data, data_len) == NRF_ERROR_NO_MEM) {
+        NRF_LOG_WARNING("UART TX lleno, %u bytes descartados en total",
+                        uart_bridge_tx_dropped_count());
     }
     if (p_data[data_len - 1] == '\r') {
-        while (app_uart_put('\n') == NRF_ERROR_BUSY)
-            ;
+        static const uint8_t lf = '\n';
+        (void)uart_bridge_send(&lf, 1);
     }
     if (ECHOBACK_BLE_UART_DATA) {
         // Send data back to the peripheral.
@@ -492,23 +281,116 @@ static bool shutdown_handler(nrf_pwr_mgmt_evt_t event)
 
 NRF_PWR_MGMT_HANDLER_REGISTER(shutdown_handler, APP_SHUTDOWN_HANDLER_PRIORITY);
 
-void activate_extended_search_mode(void)
+// Entrada a PWR_STATE_EXTENDED_SEARCH
+static void power_search_start(void)
 {
-    if (m_extended_search_active) {
-        return; // Ya está activo
-    }
-    
     NRF_LOG_RAW_INFO("\n" LOG_INFO " \033[1;33mActivando busqueda extendida de ADV\033[0m");
     NRF_LOG_RAW_INFO(LOG_INFO " Escuchando ADV del emisor durante %u segundos...",
                    EXTENDED_SEARCH_DURATION_SECONDS);
     NRF_LOG_RAW_INFO(LOG_WARN " Modo PASIVO: NO se conectara al emisor");
     
-    m_extended_search_active = true;
-    m_extended_search_seconds_remaining = EXTENDED_SEARCH_DURATION_SECONDS;
     m_emisor_adv_detected = false;
+    memset(&m_adv_stats, 0, sizeof(m_adv_stats));
     
-    // Iniciar escaneo PASIVO (solo escucha ADV, NO conecta automáticamente)
-    scan_start_passive_mode();
+    // Iniciar escaneo PASIVO (solo escucha ADV, NO conecta automáticamente).
+    // Con el intervalo del emisor aprendido se escanea solo en ventanas
+    // cortas alrededor de cada ADV previsto.
+    adv_tracker_start_search();
+}
+
+static void print_adv_stats(void)
+{
+    NRF_LOG_RAW_INFO(LOG_INFO " ADV recibidos: %u (company ID: -%u, MAC: -%u, emisor: %u)",
+                     m_adv_stats.total,
+                     m_adv_stats.rejected_company,
+                     m_adv_stats.rejected_mac,
+                     m_adv_stats.matched);
+}
+
+// Salida de PWR_STATE_EXTENDED_SEARCH (contacto, fin de la busqueda o sleep)
+static void power_search_stop(void)
+{
+    print_adv_stats();
+    adv_tracker_stop();
+}
+
+// Entrada a sleep: se apaga todo lo que consume
+static void power_down(void)
+{
+    disconnect_all_devices();
+    advertising_stop();
+    adv_tracker_stop();
+    scan_stop();
+    uart_bridge_uninit();
+
+    nrf_gpio_pin_clear(LED1_PIN);
+}
+
+// Contador de app_timer a us, con el prescaler de APP_TIMER_CONFIG_RTC_FREQUENCY
+#define CNT_FREQ       (APP_TIMER_CLOCK_FREQ / (APP_TIMER_CONFIG_RTC_FREQUENCY + 1))
+#define CNT_TO_US(cnt) ((uint32_t)((uint64_t)(cnt) * 1000000 / CNT_FREQ))
+
+// Lo que no hace falta para que la radio salga: corre en el lazo principal
+// despues de los eventos ya encolados
+static void power_up_deferred(void *p_event_data, uint16_t event_size)
+{
+    UNUSED_PARAMETER(p_event_data);
+    UNUSED_PARAMETER(event_size);
+
+    uart_init();
+
+    // El registro de la hora se informa al completarse (PWR_EVT_CONFIG_SAVED)
+    save_config_to_flash(&config_repeater);
+}
+
+// Salida del sleep. Los modulos se configuraron al arrancar: aca solo se
+// actualiza el payload y se encienden los roles de radio.
+static void power_up(void)
+{
+    uint32_t   start_cnt = app_timer_cnt_get();
+    uint32_t   radio_cnt;
+    ret_code_t err_code;
+
+    nrf_gpio_pin_set(LED1_PIN);
+
+    // Iniciar con escaneo activo (con auto-conexión) al comenzar nuevo ciclo,
+    // por el emisor al que le toca empezar la ventana
+    emisor_table_begin_window();
+    app_nus_client_search_current();
+    (void)adv_payload_update();
+    advertising_start();
+    radio_cnt = app_timer_cnt_get();
+
+    err_code = app_sched_event_put(NULL, 0, power_up_deferred);
+    if (err_code == NRF_ERROR_NO_MEM) {
+        // Cola llena: power_up corre en el lazo principal, se hace aca
+        power_up_deferred(NULL, 0);
+    }
+    else {
+        APP_ERROR_CHECK(err_code);
+    }
+
+    NRF_LOG_RAW_INFO(LOG_INFO " Reanudacion: radio en %u us (%u us desde el RTC)",
+                     CNT_TO_US(app_timer_cnt_diff_compute(radio_cnt, start_cnt)),
+                     CNT_TO_US(app_timer_cnt_diff_compute(radio_cnt, m_sleep_end_cnt)));
+}
+
+static const power_fsm_hooks_t m_power_hooks = {
+    .power_up     = power_up,
+    .power_down   = power_down,
+    .search_start = power_search_start,
+    .search_stop  = power_search_stop,
+};
+
+// Descarte temprano: el ADV del emisor trae el campo 0xFF con su company ID
+// en una posicion fija, cualquier otro se descarta sin comparar la MAC
+static bool adv_has_emisor_company_id(const uint8_t *p_data, uint16_t data_len)
+{
+    return data_len > EMISOR_ADV_MANUF_OFFSET + 3 &&
+           p_data[EMISOR_ADV_MANUF_OFFSET + 1] ==
+                      BLE_GAP_AD_TYPE_MANUFACTURER_SPECIFIC_DATA &&
+           p_data[EMISOR_ADV_MANUF_OFFSET + 2] == LSB_16(EMISOR_ADV_COMPANY_ID) &&
+           p_data[EMISOR_ADV_MANUF_OFFSET + 3] == MSB_16(EMISOR_ADV_COMPANY_ID);
 }
 
 /**@brief Función para parsear los datos de advertising del emisor
@@ -633,7 +515,14 @@ static void ble_evt_handler(ble_evt_t const *p_ble_evt, void *p_context)
         // }
         
         // Solo procesar si estamos en modo de búsqueda extendida
-        if (!m_extended_search_active) {
+        if (power_fsm_state() != PWR_STATE_EXTENDED_SEARCH) {
+            break;
+        }
+
+        m_adv_stats.total++;
+        if (!adv_has_emisor_company_id(p_adv_report->data.p_data,
+                                       p_adv_report->data.len)) {
+            m_adv_stats.rejected_company++;
             break;
         }
         
@@ -646,18 +535,17 @@ static void ble_evt_handler(ble_evt_t const *p_ble_evt, void *p_context)
         //                config_repeater.mac_emisor[4],
         //                config_repeater.mac_emisor[5]);
         
-        // Filtrar por MAC del emisor (comparar con inversión de bytes)
-        // BLE GAP addr viene como: [0]=LSB ... [5]=MSB
-        // config_repeater.mac_emisor está como: [0]=MSB ... [5]=LSB
-        bool mac_match = true;
-        for (int i = 0; i < 6; i++) {
-            if (p_adv_report->peer_addr.addr[i] != config_repeater.mac_emisor[5-i]) {
-                mac_match = false;
-                break;
-            }
+        // Filtrar por MAC del emisor (la tabla invierte los bytes)
+        // Solo el emisor principal (indice 0) tiene historial ADV
+        emisor_entry_t *p_emisor = (emisor_table_find_by_addr(&p_adv_report->peer_addr) == 0)
+                                       ? emisor_table_get(0)
+                                       : NULL;
+
+        if (p_emisor == NULL) {
+            m_adv_stats.rejected_mac++;
         }
-        
-        if (mac_match) {
+        else {
+            m_adv_stats.matched++;
             NRF_LOG_RAW_INFO("\n" LOG_OK " \033[1;32m*** MAC MATCH! ***\033[0m");
             
             // Es el emisor objetivo, parsear los datos
@@ -670,8 +558,11 @@ static void ble_evt_handler(ble_evt_t const *p_ble_evt, void *p_context)
                                       &contador, &v1, &v2)) {
                 
                 // Verificar si es un contador nuevo (evitar duplicados)
-                if (contador != m_last_adv_contador) {
-                    m_last_adv_contador = contador;
+                // Marca de llegada para aprender el intervalo del emisor
+                adv_tracker_on_report((uint16_t)contador);
+
+                if (contador != p_emisor->last_contador) {
+                    p_emisor->last_contador = contador;
                     m_emisor_adv_detected = true;
                     
                     NRF_LOG_RAW_INFO("\n" LOG_OK " \033[1;32mADV del EMISOR detectado!\033[0m");
@@ -679,15 +570,10 @@ static void ble_evt_handler(ble_evt_t const *p_ble_evt, void *p_context)
                     
                     // Crear estructura de historial ADV
                     store_adv_history adv_hist = {
-                        .year     = m_time.year,
-                        .month    = m_time.month,
-                        .day      = m_time.day,
-                        .hour     = m_time.hour,
-                        .minute   = m_time.minute,
-                        .second   = m_time.second,
-                        .contador = contador,
-                        .V1       = v1,
-                        .V2       = v2
+                        .timestamp = calendar_get_timestamp(NULL),
+                        .contador  = contador,
+                        .V1        = v1,
+                        .V2        = v2
                     };
                     
                     // Guardar historial (el sistema calcula automáticamente el offset)
@@ -704,17 +590,10 @@ static void ble_evt_handler(ble_evt_t const *p_ble_evt, void *p_context)
                         // Imprimir el RSSI del ADV detectado
                         NRF_LOG_RAW_INFO(LOG_INFO " RSSI: \x1B[36m%d dBm\x1B[0m\r\n", p_adv_report->rssi);
                         
-                        // Marcar que se detectó al emisor en este ciclo
-                        m_connected_this_cycle = true;
-                        
-                        // Desactivar búsqueda extendida (detener escaneo pasivo)
-                        // pero NO restaurar modo activo - simplemente esperar a entrar en sleep
-                        m_extended_search_active = false;
-                        m_extended_search_seconds_remaining = 0;
-                        NRF_LOG_RAW_INFO(LOG_INFO " Match detectado. Deteniendo escaneo. Esperando modo sleep...");
-                        
-                        // Detener el escaneo completamente
-                        nrf_ble_scan_stop();
+                        // Marcar que se detectó al emisor en este ciclo: la
+                        // busqueda termina y se espera el sleep sin escanear
+                        rendezvous_on_contact();
+                        power_fsm_post(PWR_EVT_EMISOR_CONTACT);
                     } else {
                         NRF_LOG_RAW_INFO(LOG_WARN " Error al guardar historial ADV: %d", ret);
                     }
@@ -766,6 +645,7 @@ void gatt_evt_handler(nrf_ble_gatt_t *p_gatt, nrf_ble_gatt_evt_t const *p_evt)
 
         m_ble_nus_max_data_len = p_evt->params.att_mtu_effective -
                                  OPCODE_LENGTH - HANDLE_LENGTH;
+        app_nus_server_on_mtu(p_evt->conn_handle, m_ble_nus_max_data_len);
         // NRF_LOG_INFO("Ble NUS max data length set to 0x%X(%d)",
         // m_ble_nus_max_data_len, m_ble_nus_max_data_len);
     }
@@ -851,7 +731,9 @@ void app_nus_server_on_data_received(
     // NRF_LOG_RAW_INFO("\n");
 
     // Forward the data from the client to the server
-    app_nus_client_send_data(data_ptr, data_length);
+    if (relay_to_emisor(data_ptr, data_length) != NRF_SUCCESS) {
+        NRF_LOG_RAW_INFO(LOG_WARN " Mensaje al emisor descartado");
+    }
 }
 
 // Procesa la información recibida desde el emisor
@@ -859,7 +741,9 @@ void app_nus_client_on_data_received(
            const uint8_t *data_ptr,
            uint16_t       data_length)
 {
-    uint16_t position = 0;
+    uint16_t position  = 0;
+    bool     forwarded = false;
+    bool     persisted = false; // La trama ya quedo guardada en flash
 
     // Se recibieron los datos de los ADC's y contador
     if (data_length > 8 && data_ptr[0] == 0x96) {
@@ -876,6 +760,19 @@ void app_nus_client_on_data_received(
                        "\n[ERROR] No se pudieron guardar ni cargar los valores "
                        "de los ADC's");
         }
+        adv_payload_changed();
+        // Si la consulta la hizo la suscripcion de telemetria, el celular ya
+        // recibio la trama 0x97 y no hace falta reenviar la respuesta cruda
+        forwarded = telemetry_on_emisor_values(
+                   adc_values.V1,
+                   adc_values.V2,
+                   adc_values.contador);
+    }
+
+    // Respuesta a la sincronizacion de hora: es interna, no va al celular
+    if (data_length >= TIME_SYNC_REPLY_SIZE && data_ptr[0] == TIME_SYNC_REQUEST_TAG) {
+        time_sync_on_reply(data_ptr, data_length);
+        forwarded = true;
     }
 
     // Se recibio el 'ultimo' historial del emisor
@@ -906,35 +803,49 @@ void app_nus_client_on_data_received(
         uint16_t last_position =
                    (data_ptr[position++] << 8) | data_ptr[position++];
 
-        // Construir el registro temporal
+        // Construir el registro temporal, con la hora del registro llevada
+        // al reloj del repetidor
+        datetime_t    fecha           = {year, month, day, hour, minute, second};
         store_history nuevo_historial = {
-                   .year     = year,
-                   .month    = month,
-                   .day      = day,
-                   .hour     = hour,
-                   .minute   = minute,
-                   .second   = second,
-                   .contador = contador,
-                   .V1       = V1,
-                   .V2       = V2,
-                   .V3       = V3,
-                   .V4       = V4,
-                   .V5       = V5,
-                   .V6       = V6,
-                   .V7       = V7,
-                   .V8       = V8,
-                   .temp     = temp,
-                   .battery  = battery};
-
-        // Guardar el historial recibido en la posición indicada
-        ret_code_t ret =
-                   save_history_record_emisor(&nuevo_historial, last_position);
-        if (ret != NRF_SUCCESS) {
-            NRF_LOG_RAW_INFO(
-                       "\nError al guardar historial en posicion: %u "
-                       "(ret=%d)\n",
-                       last_position,
-                       ret);
+                   .timestamp = time_sync_correct(timestamp_from_datetime(&fecha)),
+                   .contador  = contador,
+                   .V1        = V1,
+                   .V2        = V2,
+                   .V3        = V3,
+                   .V4        = V4,
+                   .V5        = V5,
+                   .V6        = V6,
+                   .V7        = V7,
+                   .V8        = V8,
+                   .temp      = temp,
+                   .battery   = battery};
+
+        if (history_sync_is_active()) {
+            // Respuesta a un pedido de recuperacion: escritura en lote
+            persisted = true;
+            history_sync_on_record(&nuevo_historial, last_position);
+        }
+        else {
+            // Cada emisor guarda en su propio archivo
+            uint16_t file_id = emisor_table_current()->history_file_id;
+
+            // Antes de guardar: comparar con el ID mas alto local y pedir
+            // los historiales que falten
+            history_sync_on_last_position(file_id, last_position);
+
+            // Guardar el historial recibido en la posición indicada
+            ret_code_t ret = save_history_record_emisor(
+                       file_id,
+                       &nuevo_historial,
+                       last_position);
+            persisted = (ret == NRF_SUCCESS);
+            if (ret != NRF_SUCCESS) {
+                NRF_LOG_RAW_INFO(
+                           "\nError al guardar historial en posicion: %u "
+                           "(ret=%d)\n",
+                           last_position,
+                           ret);
+            }
         }
 
         // Imprimir usando print_history_record con el número de historial en el
@@ -948,18 +859,28 @@ void app_nus_client_on_data_received(
         // fds_print_all_record_times();
         NRF_LOG_FLUSH();
     }
-    app_nus_server_send_data(data_ptr, data_length);
+    if (!forwarded) {
+        // Sin celular (o sin buffers) la trama se guarda para reenviarla
+        // cuando el celular se conecte. Los historiales que ya quedaron en
+        // flash se leen con el comando 15 y no se duplican en la cola.
+        if (relay_to_phone(data_ptr, data_length) != NRF_SUCCESS &&
+            !persisted) {
+            relay_queue_push(data_ptr, data_length);
+        }
+    }
 }
 
 static void idle_state_handle(void)
 {
     if (NRF_LOG_PROCESS() == false) {
-        if (!m_device_active) {
+        energy_cpu_sleep();
+        if (!power_fsm_is_active()) {
             nrf_pwr_mgmt_run();
         }
         else {
             sd_app_evt_wait();
         }
+        energy_cpu_wake();
     }
 }
 
@@ -976,6 +897,8 @@ int main(void)
                "\033[1;90mCrea\033[1;31mLab\033[0m\n");
 
     base_timer_init();
+    energy_init();
+    APP_SCHED_INIT(POWER_FSM_SCHED_EVENT_SIZE, POWER_FSM_SCHED_QUEUE_SIZE);
     fds_initialize();
     uart_init();
 
@@ -991,11 +914,20 @@ int main(void)
     // load_adc_values(&adc_values);
     // load_repeater_configuration(&config_repetidor, 0, 0, 1);
     init_sistema_configuracion(&config_repeater);
+    relay_queue_init();
+    emisor_table_init();
+    adv_broadcast_init();
+    adv_payload_init();
     // Inicializa los servicios de servidor y cliente NUS
     app_nus_server_init(app_nus_server_on_data_received);
     app_nus_client_init(app_nus_client_on_data_received);
+    relay_init();
+    adv_tracker_init();
+    rendezvous_init();
+    telemetry_init();
 
     rtc_init();
+    power_fsm_init(&m_power_hooks);
     calendar_init();
 
     calendar_set_datetime();
@@ -1005,8 +937,11 @@ int main(void)
 
     // Enter main loop.
     for (;;) {
-        calendar_update();
-        handle_rtc_events();
+        // Los eventos de la maquina de estados que no entraron en la cola
+        // del scheduler se entregan despues de los que si entraron
+        do {
+            app_sched_execute();
+        } while (power_fsm_dispatch_deferred());
         idle_state_handle();
     }
 }
@@ -0,0 +1,422 @@
+#include "power_fsm.h"
+
+#include <string.h>
+
+#include "app_error.h"
+#include "app_nus_client.h"
+#include "app_scheduler.h"
+#include "app_util.h"
+#include "app_util_platform.h"
+#include "calendar.h"
+#include "duty_adapt.h"
+#include "energy.h"
+#include "filesystem.h"
+#include "nrf_log.h"
+#include "rendezvous.h"
+#include "rtc_timer.h"
+#include "variables.h"
+
+#define PWR_STATE_ANY       PWR_STATE_COUNT
+
+typedef bool (*power_guard_t)(void);
+typedef void (*power_action_t)(void);
+
+typedef struct
+{
+    power_state_t  state;
+    power_evt_t    evt;
+    power_guard_t  guard;  // NULL: siempre
+    power_state_t  next;
+    power_action_t action; // NULL: ninguna
+} power_transition_t;
+
+typedef struct
+{
+    power_action_t entry;
+    power_action_t exit;
+} power_state_actions_t;
+
+static power_fsm_hooks_t m_hooks;
+static power_state_t     m_state          = PWR_STATE_ACTIVE;
+static bool              m_contacted      = false; // Contacto con el emisor en el ciclo
+static bool              m_extended_mode  = false; // Ciclo con tiempos extendidos
+static uint64_t          m_state_entered  = 0;     // Tick de rtc_timer al entrar al estado
+static uint32_t          m_cycle_ticks[PWR_STATE_COUNT];
+static uint32_t          m_last_cycle_ms[PWR_STATE_COUNT];
+
+// Eventos que no entraron en la cola del scheduler, en orden de llegada. Cada
+// tipo aparece a lo sumo una vez, asi que PWR_EVT_COUNT lugares alcanzan.
+static power_evt_t       m_deferred[PWR_EVT_COUNT];
+static volatile uint8_t  m_deferred_head  = 0;
+static volatile uint8_t  m_deferred_count = 0;
+static volatile uint32_t m_deferred_mask  = 0;     // Tipos presentes en m_deferred
+
+static char const *const m_state_names[PWR_STATE_COUNT] = {
+    "ACTIVO", "ACTIVO EXTENDIDO", "BUSQUEDA EXTENDIDA", "SLEEP", "SLEEP EXTENDIDO"};
+
+/* ------------------------------------------------------------------------ */
+/* Condiciones                                                              */
+/* ------------------------------------------------------------------------ */
+
+static bool guard_contacted(void)
+{
+    return m_contacted;
+}
+
+static bool guard_extended(void)
+{
+    return m_extended_mode;
+}
+
+static bool guard_not_contacted(void)
+{
+    return !m_contacted;
+}
+
+// La busqueda extendida ocupa los ultimos EXTENDED_SEARCH_MS de la ventana
+// ON; se reprograma cada vez que la ventana cambia
+static void schedule_search(void)
+{
+    uint32_t remaining = rtc_timer_remaining_ms(RTC_TIMER_ON);
+
+    if (!m_contacted && remaining > EXTENDED_SEARCH_MS)
+    {
+        rtc_timer_start(RTC_TIMER_SEARCH, remaining - EXTENDED_SEARCH_MS);
+    }
+    else
+    {
+        rtc_timer_stop(RTC_TIMER_SEARCH);
+    }
+}
+
+/* ------------------------------------------------------------------------ */
+/* Acciones de transicion                                                   */
+/* ------------------------------------------------------------------------ */
+
+static void act_wake_normal(void)
+{
+    NRF_LOG_RAW_INFO("\n" LOG_INFO " Transicion a \033[1;32mMODO ACTIVO\033[0m");
+    duty_adapt_on_wake(false);
+    restart_wake_on_rtc();
+    schedule_search();
+}
+
+static void act_wake_extended(void)
+{
+    NRF_LOG_RAW_INFO("\n" LOG_INFO " Transicion a \033[1;32mMODO ACTIVO EXTENDIDO\033[0m");
+    duty_adapt_on_wake(true);
+    restart_extended_on_rtc();
+    schedule_search();
+}
+
+// Conexion con el emisor: la ventana ON vuelve al tiempo normal
+static void act_emisor_connected(void)
+{
+    m_contacted     = true;
+    m_extended_mode = false;
+    duty_adapt_on_contact(DUTY_ADAPT_CONTACT_CONN);
+    restart_on_rtc();
+    schedule_search();
+}
+
+// ADV del emisor durante la busqueda: se deja de escanear hasta el sleep
+static void act_emisor_adv(void)
+{
+    m_contacted = true;
+    duty_adapt_on_contact(DUTY_ADAPT_CONTACT_ADV);
+    NRF_LOG_RAW_INFO(LOG_INFO " Match detectado. Deteniendo escaneo. Esperando modo sleep...");
+    scan_stop();
+}
+
+static void act_phone_connected(void)
+{
+    restart_extended_on_rtc();
+    // Durante la busqueda RTC_TIMER_SEARCH marca su fin
+    if (m_state != PWR_STATE_EXTENDED_SEARCH)
+    {
+        schedule_search();
+    }
+}
+
+static void act_search_timeout(void)
+{
+    NRF_LOG_RAW_INFO(LOG_WARN " Tiempo de busqueda extendida agotado");
+    NRF_LOG_RAW_INFO(LOG_INFO " Restaurando modo de escaneo activo...");
+    scan_start_active_mode();
+}
+
+static void act_search_countdown(void)
+{
+    NRF_LOG_RAW_INFO(LOG_INFO " Busqueda extendida: %u segundos restantes...",
+                     (rtc_timer_remaining_ms(RTC_TIMER_SEARCH) + 500) / 1000);
+}
+
+static void act_config_saved(void)
+{
+    datetime_t now;
+
+    (void)calendar_get_time(&now);
+    NRF_LOG_RAW_INFO(LOG_OK " Guardado de fecha y hora actual: %02u/%02u/%04u, "
+                            "%02u:%02u:%02u",
+                     now.day,
+                     now.month,
+                     now.year,
+                     now.hour,
+                     now.minute,
+                     now.second);
+}
+
+/* ------------------------------------------------------------------------ */
+/* Entrada y salida de estados                                              */
+/* ------------------------------------------------------------------------ */
+
+static void enter_sleep(void)
+{
+    uint32_t on_ms    = read_time_from_flash(TIEMPO_ENCENDIDO, DEFAULT_DEVICE_ON_TIME_MS);
+    uint32_t sleep_ms = read_time_from_flash(TIEMPO_SLEEP, DEFAULT_DEVICE_SLEEP_TIME_MS);
+
+    rtc_timer_stop(RTC_TIMER_SEARCH);
+    m_hooks.power_down();
+    rendezvous_on_cycle_end();
+    duty_adapt_on_cycle_end();
+    m_extended_mode = false;
+
+    NRF_LOG_RAW_INFO("\n" LOG_INFO " Transicion a \033[1;36mMODO SLEEP\033[0m");
+    NRF_LOG_RAW_INFO(LOG_INFO " Modo normal (ON=%u ms, SLEEP=%u ms)", on_ms, sleep_ms);
+    restart_sleep_rtc();
+}
+
+static void enter_extended_sleep(void)
+{
+    uint32_t extended_on_ms =
+        read_time_from_flash(TIEMPO_EXTENDED_ENCENDIDO, DEFAULT_DEVICE_EXTENDED_ON_TIME_MS);
+    uint32_t extended_sleep_ms =
+        read_time_from_flash(TIEMPO_EXTENDED_SLEEP, DEFAULT_DEVICE_EXTENDED_SLEEP_TIME_MS);
+
+    rtc_timer_stop(RTC_TIMER_SEARCH);
+    m_hooks.power_down();
+    rendezvous_on_cycle_end();
+    duty_adapt_on_cycle_end();
+    m_extended_mode = true;
+
+    NRF_LOG_RAW_INFO("\n" LOG_INFO " Transicion a \033[1;36mMODO SLEEP EXTENDIDO\033[0m");
+    NRF_LOG_RAW_INFO(LOG_INFO " Modo extendido ACTIVADO (ON=%u ms, SLEEP=%u ms)",
+                     extended_on_ms,
+                     extended_sleep_ms);
+    restart_extended_sleep_rtc();
+}
+
+// Al despertar cierra el ciclo anterior
+static void exit_sleep(void)
+{
+    for (uint8_t state = 0; state < PWR_STATE_COUNT; state++)
+    {
+        m_last_cycle_ms[state] = (uint32_t)RTC_TIMER_TICKS_TO_MS(m_cycle_ticks[state]);
+    }
+    memset(m_cycle_ticks, 0, sizeof(m_cycle_ticks));
+
+    NRF_LOG_RAW_INFO(LOG_INFO " Ciclo: activo %u ms, activo ext %u ms, busqueda %u ms, "
+                              "sleep %u ms, sleep ext %u ms",
+                     m_last_cycle_ms[PWR_STATE_ACTIVE],
+                     m_last_cycle_ms[PWR_STATE_EXTENDED_ACTIVE],
+                     m_last_cycle_ms[PWR_STATE_EXTENDED_SEARCH],
+                     m_last_cycle_ms[PWR_STATE_SLEEP],
+                     m_last_cycle_ms[PWR_STATE_EXTENDED_SLEEP]);
+
+    energy_cycle_close();
+
+    m_contacted = false;
+    m_hooks.power_up();
+}
+
+static void enter_search(void)
+{
+    rtc_timer_start(RTC_TIMER_SEARCH, EXTENDED_SEARCH_MS);
+    calendar_tick_request(); // Cuenta regresiva en el log
+    m_hooks.search_start();
+}
+
+static void exit_search(void)
+{
+    rtc_timer_stop(RTC_TIMER_SEARCH);
+    calendar_tick_release();
+    m_hooks.search_stop();
+}
+
+static const power_state_actions_t m_state_actions[PWR_STATE_COUNT] = {
+    [PWR_STATE_ACTIVE]          = {NULL, NULL},
+    [PWR_STATE_EXTENDED_ACTIVE] = {NULL, NULL},
+    [PWR_STATE_EXTENDED_SEARCH] = {enter_search, exit_search},
+    [PWR_STATE_SLEEP]           = {enter_sleep, exit_sleep},
+    [PWR_STATE_EXTENDED_SLEEP]  = {enter_extended_sleep, exit_sleep},
+};
+
+/* ------------------------------------------------------------------------ */
+/* Tabla de transiciones (gana la primera fila que coincide)                */
+/* ------------------------------------------------------------------------ */
+
+static const power_transition_t m_transitions[] = {
+    {PWR_STATE_ACTIVE,          PWR_EVT_ON_TIMEOUT,      guard_contacted,     PWR_STATE_SLEEP,           NULL},
+    {PWR_STATE_ACTIVE,          PWR_EVT_ON_TIMEOUT,      NULL,                PWR_STATE_EXTENDED_SLEEP,  NULL},
+    {PWR_STATE_ACTIVE,          PWR_EVT_SEARCH_TIMER,    guard_not_contacted, PWR_STATE_EXTENDED_SEARCH, NULL},
+    {PWR_STATE_ACTIVE,          PWR_EVT_EMISOR_CONTACT,  NULL,                PWR_STATE_ACTIVE,          act_emisor_connected},
+    {PWR_STATE_ACTIVE,          PWR_EVT_PHONE_CONNECTED, NULL,                PWR_STATE_ACTIVE,          act_phone_connected},
+
+    {PWR_STATE_EXTENDED_ACTIVE, PWR_EVT_ON_TIMEOUT,      guard_contacted,     PWR_STATE_SLEEP,           NULL},
+    {PWR_STATE_EXTENDED_ACTIVE, PWR_EVT_ON_TIMEOUT,      NULL,                PWR_STATE_EXTENDED_SLEEP,  NULL},
+    {PWR_STATE_EXTENDED_ACTIVE, PWR_EVT_SEARCH_TIMER,    guard_not_contacted, PWR_STATE_EXTENDED_SEARCH, NULL},
+    {PWR_STATE_EXTENDED_ACTIVE, PWR_EVT_EMISOR_CONTACT,  NULL,                PWR_STATE_ACTIVE,          act_emisor_connected},
+    {PWR_STATE_EXTENDED_ACTIVE, PWR_EVT_PHONE_CONNECTED, NULL,                PWR_STATE_EXTENDED_ACTIVE, act_phone_connected},
+
+    {PWR_STATE_EXTENDED_SEARCH, PWR_EVT_ON_TIMEOUT,      guard_contacted,     PWR_STATE_SLEEP,           NULL},
+    {PWR_STATE_EXTENDED_SEARCH, PWR_EVT_ON_TIMEOUT,      NULL,                PWR_STATE_EXTENDED_SLEEP,  NULL},
+    {PWR_STATE_EXTENDED_SEARCH, PWR_EVT_SECOND,          NULL,                PWR_STATE_EXTENDED_SEARCH, act_search_countdown},
+    {PWR_STATE_EXTENDED_SEARCH, PWR_EVT_EMISOR_CONTACT,  NULL,                PWR_STATE_ACTIVE,          act_emisor_adv},
+    {PWR_STATE_EXTENDED_SEARCH, PWR_EVT_SEARCH_TIMER,    guard_extended,      PWR_STATE_EXTENDED_ACTIVE, act_search_timeout},
+    {PWR_STATE_EXTENDED_SEARCH, PWR_EVT_SEARCH_TIMER,    NULL,                PWR_STATE_ACTIVE,          act_search_timeout},
+    {PWR_STATE_EXTENDED_SEARCH, PWR_EVT_PHONE_CONNECTED, NULL,                PWR_STATE_EXTENDED_SEARCH, act_phone_connected},
+
+    {PWR_STATE_SLEEP,           PWR_EVT_SLEEP_TIMEOUT,   NULL,                PWR_STATE_ACTIVE,          act_wake_normal},
+    {PWR_STATE_EXTENDED_SLEEP,  PWR_EVT_SLEEP_TIMEOUT,   NULL,                PWR_STATE_EXTENDED_ACTIVE, act_wake_extended},
+
+    {PWR_STATE_ANY,             PWR_EVT_CONFIG_SAVED,    NULL,                PWR_STATE_ANY,             act_config_saved},
+};
+
+static void account_state_time(void)
+{
+    uint64_t now = rtc_timer_ticks();
+
+    m_cycle_ticks[m_state] += (uint32_t)(now - m_state_entered);
+    m_state_entered = now;
+}
+
+static void dispatch(power_evt_t evt)
+{
+    for (uint8_t i = 0; i < ARRAY_SIZE(m_transitions); i++)
+    {
+        power_transition_t const *p_row = &m_transitions[i];
+
+        if ((p_row->state != m_state && p_row->state != PWR_STATE_ANY) || p_row->evt != evt ||
+            (p_row->guard != NULL && !p_row->guard()))
+        {
+            continue;
+        }
+
+        if (p_row->next == m_state || p_row->next == PWR_STATE_ANY)
+        {
+            // Transicion interna
+            if (p_row->action != NULL)
+            {
+                p_row->action();
+            }
+            return;
+        }
+
+        account_state_time();
+        if (m_state_actions[m_state].exit != NULL)
+        {
+            m_state_actions[m_state].exit();
+        }
+        NRF_LOG_DEBUG("Estado %s -> %s", m_state_names[m_state], m_state_names[p_row->next]);
+        m_state = p_row->next;
+        if (p_row->action != NULL)
+        {
+            p_row->action();
+        }
+        if (m_state_actions[m_state].entry != NULL)
+        {
+            m_state_actions[m_state].entry();
+        }
+        return;
+    }
+}
+
+static void sched_evt_handler(void *p_event_data, uint16_t event_size)
+{
+    UNUSED_PARAMETER(event_size);
+    dispatch(*(power_evt_t const *)p_event_data);
+}
+
+void power_fsm_init(power_fsm_hooks_t const *p_hooks)
+{
+    m_hooks         = *p_hooks;
+    m_state         = PWR_STATE_ACTIVE;
+    m_contacted     = false;
+    m_extended_mode = false;
+    m_state_entered = rtc_timer_ticks();
+    memset(m_cycle_ticks, 0, sizeof(m_cycle_ticks));
+    memset(m_last_cycle_ms, 0, sizeof(m_last_cycle_ms));
+
+    // Primera ventana ON
+    duty_adapt_init();
+    restart_wake_on_rtc();
+    schedule_search();
+}
+
+void power_fsm_post(power_evt_t evt)
+{
+    ret_code_t err_code = NRF_ERROR_NO_MEM;
+
+    CRITICAL_REGION_ENTER();
+    // Mientras haya diferidos los nuevos van detras, para no adelantarlos
+    if (m_deferred_count == 0)
+    {
+        err_code = app_sched_event_put(&evt, sizeof(evt), sched_evt_handler);
+    }
+    if (err_code == NRF_ERROR_NO_MEM && (m_deferred_mask & (1UL << evt)) == 0)
+    {
+        // Cola llena (ej. rafaga de ADV). Varios del mismo tipo quedan en
+        // uno; solo se repiten en rafaga EMISOR_CONTACT y SECOND, que no
+        // acumulan efecto.
+        m_deferred[(m_deferred_head + m_deferred_count) % PWR_EVT_COUNT] = evt;
+        m_deferred_count++;
+        m_deferred_mask |= 1UL << evt;
+    }
+    CRITICAL_REGION_EXIT();
+
+    if (err_code == NRF_ERROR_NO_MEM)
+    {
+        NRF_LOG_RAW_INFO(LOG_WARN " Cola de eventos llena, evento %u diferido", evt);
+        return;
+    }
+    APP_ERROR_CHECK(err_code);
+}
+
+bool power_fsm_dispatch_deferred(void)
+{
+    power_evt_t evt     = PWR_EVT_COUNT;
+    bool        pending = false;
+
+    CRITICAL_REGION_ENTER();
+    if (m_deferred_count > 0)
+    {
+        evt              = m_deferred[m_deferred_head];
+        m_deferred_head  = (m_deferred_head + 1) % PWR_EVT_COUNT;
+        m_deferred_count--;
+        m_deferred_mask &= ~(1UL << evt);
+        pending          = true;
+    }
+    CRITICAL_REGION_EXIT();
+
+    if (pending)
+    {
+        dispatch(evt);
+    }
+    return pending;
+}
+
+power_state_t power_fsm_state(void)
+{
+    return m_state;
+}
+
+bool power_fsm_is_active(void)
+{
+    return m_state == PWR_STATE_ACTIVE || m_state == PWR_STATE_EXTENDED_ACTIVE ||
+           m_state == PWR_STATE_EXTENDED_SEARCH;
+}
+
+void power_fsm_cycle_times_get(uint32_t p_ms[PWR_STATE_COUNT])
+{
+    memcpy(p_ms, m_last_cycle_ms, sizeof(m_last_cycle_ms));
+}
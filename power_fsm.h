@@ -0,0 +1,88 @@
+#ifndef POWER_FSM_H
+#define POWER_FSM_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Maquina de estados del ciclo de encendido.
+//
+// Los manejadores de interrupcion (RTC, BLE, FDS) solo publican eventos con
+// power_fsm_post(); app_scheduler los entrega en el lazo principal y ahi se
+// busca la transicion en una tabla {estado, evento, condicion, destino,
+// accion}. Al cambiar de estado se ejecuta la salida del estado anterior, la
+// accion y la entrada del nuevo; si el destino es el mismo estado la
+// transicion es interna y solo corre la accion.
+//
+//   ACTIVE / EXTENDED_ACTIVE --ON_TIMEOUT--> SLEEP (hubo contacto)
+//                                        \-> EXTENDED_SLEEP (sin contacto)
+//   ACTIVE / EXTENDED_ACTIVE --SEARCH_TIMER-> EXTENDED_SEARCH (ultimos
+//                                             segundos sin contacto)
+//   EXTENDED_SEARCH --EMISOR_CONTACT--> ACTIVE
+//   EXTENDED_SEARCH --SEARCH_TIMER--> EXTENDED_ACTIVE (ciclo extendido)
+//                                 \-> ACTIVE (ciclo normal)
+//   SLEEP --SLEEP_TIMEOUT--> ACTIVE, EXTENDED_SLEEP --SLEEP_TIMEOUT--> EXTENDED_ACTIVE
+//
+// Se mide el tiempo pasado en cada estado; el ciclo cierra al despertar.
+
+#define POWER_FSM_SCHED_QUEUE_SIZE  16
+
+typedef enum
+{
+    PWR_STATE_ACTIVE = 0,
+    PWR_STATE_EXTENDED_ACTIVE,
+    PWR_STATE_EXTENDED_SEARCH,
+    PWR_STATE_SLEEP,
+    PWR_STATE_EXTENDED_SLEEP,
+    PWR_STATE_COUNT
+} power_state_t;
+
+typedef enum
+{
+    PWR_EVT_ON_TIMEOUT = 0,   // RTC_TIMER_ON: fin de la ventana ON
+    PWR_EVT_SLEEP_TIMEOUT,    // RTC_TIMER_SLEEP: fin del sleep
+    PWR_EVT_SEARCH_TIMER,     // RTC_TIMER_SEARCH: inicio o fin de la busqueda
+    PWR_EVT_SECOND,           // Tick de 1 Hz (calendar_tick_request)
+    PWR_EVT_EMISOR_CONTACT,   // Conexion o ADV del emisor
+    PWR_EVT_PHONE_CONNECTED,
+    PWR_EVT_CONFIG_SAVED,     // FDS: configuracion escrita al despertar
+    PWR_EVT_COUNT
+} power_evt_t;
+
+#define POWER_FSM_SCHED_EVENT_SIZE  sizeof(power_evt_t)
+
+// Acciones que dependen del resto de la aplicacion
+typedef struct
+{
+    void (*power_up)(void);     // Salida del sleep: advertising, scan, UART
+    void (*power_down)(void);   // Entrada al sleep
+    void (*search_start)(void); // Escaneo pasivo de ADV
+    void (*search_stop)(void);
+} power_fsm_hooks_t;
+
+/**@brief Inicia en PWR_STATE_ACTIVE (la radio ya esta encendida) y programa
+ *        la primera ventana ON. Requiere APP_SCHED_INIT y rtc_timer_init
+ *        previos.
+ */
+void          power_fsm_init(power_fsm_hooks_t const *p_hooks);
+
+/**@brief Publica un evento. Se puede llamar desde interrupciones. Con la
+ *        cola llena el evento se difiere, y los siguientes van detras de el
+ *        hasta que el lazo principal los entregue.
+ */
+void          power_fsm_post(power_evt_t evt);
+
+/**@brief Entrega el evento diferido mas antiguo. Llamar desde el lazo
+ *        principal despues de app_sched_execute(), que entrega los que
+ *        llegaron antes, mientras devuelva true.
+ */
+bool          power_fsm_dispatch_deferred(void);
+
+power_state_t power_fsm_state(void);
+
+/**@brief true en ACTIVE, EXTENDED_ACTIVE o EXTENDED_SEARCH. */
+bool          power_fsm_is_active(void);
+
+/**@brief Milisegundos en cada estado durante el ultimo ciclo completo. */
+void          power_fsm_cycle_times_get(uint32_t p_ms[PWR_STATE_COUNT]);
+
+#endif // POWER_FSM_H
@@ -0,0 +1,201 @@
+#include "relay.h"
+
+#include <string.h>
+
+#include "app_nus_client.h"
+#include "app_nus_server.h"
+#include "nrf_log.h"
+#include "relay_queue.h"
+#include "variables.h"
+
+typedef uint32_t (*relay_send_t)(const uint8_t *p_data, uint16_t length);
+
+typedef struct
+{
+    uint8_t       buffer[RELAY_RING_SIZE];
+    uint16_t      head; // Proximo byte a escribir
+    uint16_t      tail; // Proximo byte a leer
+    uint16_t      used;
+    relay_send_t  send;
+    relay_stats_t stats;
+} relay_ring_t;
+
+static relay_ring_t m_rings[RELAY_DIR_COUNT];
+static uint8_t      m_frame[RELAY_MAX_FRAME]; // Trama contigua para el stack
+
+static bool stack_busy(ret_code_t err_code)
+{
+    return err_code == NRF_ERROR_RESOURCES || err_code == NRF_ERROR_BUSY ||
+           err_code == NRF_ERROR_NO_MEM;
+}
+
+static void ring_write(relay_ring_t *p_ring, uint8_t const *p_data, uint16_t length)
+{
+    for (uint16_t i = 0; i < length; i++)
+    {
+        p_ring->buffer[p_ring->head] = p_data[i];
+        p_ring->head                 = (p_ring->head + 1) % RELAY_RING_SIZE;
+    }
+    p_ring->used += length;
+}
+
+// Copia la trama de la cola a m_frame sin sacarla del anillo
+static uint16_t ring_peek(relay_ring_t const *p_ring)
+{
+    uint16_t length = p_ring->buffer[p_ring->tail];
+    uint16_t index  = (p_ring->tail + 1) % RELAY_RING_SIZE;
+
+    for (uint16_t i = 0; i < length; i++)
+    {
+        m_frame[i] = p_ring->buffer[index];
+        index      = (index + 1) % RELAY_RING_SIZE;
+    }
+    return length;
+}
+
+static void ring_pop(relay_ring_t *p_ring, uint16_t length)
+{
+    p_ring->tail = (p_ring->tail + 1 + length) % RELAY_RING_SIZE;
+    p_ring->used -= 1 + length;
+}
+
+static void ring_clear(relay_ring_t *p_ring)
+{
+    p_ring->head = 0;
+    p_ring->tail = 0;
+    p_ring->used = 0;
+}
+
+// Envia en orden lo pendiente hasta que el stack se quede sin buffers
+static void ring_flush(relay_ring_t *p_ring)
+{
+    while (p_ring->used > 0)
+    {
+        uint16_t   length   = ring_peek(p_ring);
+        ret_code_t err_code = p_ring->send(m_frame, length);
+
+        if (err_code == NRF_SUCCESS)
+        {
+            p_ring->stats.bytes_out += length;
+            ring_pop(p_ring, length);
+        }
+        else
+        {
+            // Sin buffers se reintenta en el proximo evento de TX; sin enlace
+            // lo pendiente lo resuelve el evento de desconexion
+            break;
+        }
+    }
+}
+
+static ret_code_t relay_forward(relay_ring_t *p_ring, uint8_t const *p_data, uint16_t length)
+{
+    ret_code_t err_code;
+
+    if (p_data == NULL || length == 0 || length > RELAY_MAX_FRAME)
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+
+    p_ring->stats.bytes_in += length;
+
+    // Sin nada pendiente se intenta enviar directo
+    if (p_ring->used == 0)
+    {
+        err_code = p_ring->send(p_data, length);
+        if (err_code == NRF_SUCCESS)
+        {
+            p_ring->stats.bytes_out += length;
+            return NRF_SUCCESS;
+        }
+        if (!stack_busy(err_code))
+        {
+            return err_code;
+        }
+    }
+
+    if (p_ring->used + 1 + length > RELAY_RING_SIZE)
+    {
+        p_ring->stats.frames_dropped++;
+        p_ring->stats.bytes_dropped += length;
+        return NRF_ERROR_NO_MEM;
+    }
+
+    uint8_t header = (uint8_t)length;
+    ring_write(p_ring, &header, 1);
+    ring_write(p_ring, p_data, length);
+    if (p_ring->used > p_ring->stats.max_used)
+    {
+        p_ring->stats.max_used = p_ring->used;
+    }
+
+    return NRF_SUCCESS;
+}
+
+void relay_init(void)
+{
+    memset(m_rings, 0, sizeof(m_rings));
+    m_rings[RELAY_DIR_TO_PHONE].send  = app_nus_server_send_data;
+    m_rings[RELAY_DIR_TO_EMISOR].send = app_nus_client_send_data;
+}
+
+ret_code_t relay_to_phone(uint8_t const *p_data, uint16_t length)
+{
+    return relay_forward(&m_rings[RELAY_DIR_TO_PHONE], p_data, length);
+}
+
+ret_code_t relay_to_emisor(uint8_t const *p_data, uint16_t length)
+{
+    return relay_forward(&m_rings[RELAY_DIR_TO_EMISOR], p_data, length);
+}
+
+void relay_on_phone_tx_ready(void)
+{
+    ring_flush(&m_rings[RELAY_DIR_TO_PHONE]);
+}
+
+void relay_on_emisor_tx_complete(void)
+{
+    ring_flush(&m_rings[RELAY_DIR_TO_EMISOR]);
+}
+
+void relay_on_phone_disconnected(void)
+{
+    relay_ring_t *p_ring = &m_rings[RELAY_DIR_TO_PHONE];
+
+    // Las tramas que no alcanzaron a salir se guardan para la proxima conexion
+    while (p_ring->used > 0)
+    {
+        uint16_t length = ring_peek(p_ring);
+        (void)relay_queue_push(m_frame, length);
+        ring_pop(p_ring, length);
+    }
+
+    NRF_LOG_RAW_INFO(LOG_INFO " Reenvio al celular: %u bytes, %u tramas descartadas",
+                     p_ring->stats.bytes_out,
+                     p_ring->stats.frames_dropped);
+}
+
+void relay_on_emisor_disconnected(void)
+{
+    relay_ring_t *p_ring = &m_rings[RELAY_DIR_TO_EMISOR];
+
+    while (p_ring->used > 0)
+    {
+        uint16_t length = ring_peek(p_ring);
+        p_ring->stats.frames_dropped++;
+        p_ring->stats.bytes_dropped += length;
+        ring_pop(p_ring, length);
+    }
+    ring_clear(p_ring);
+}
+
+bool relay_is_throttled(relay_dir_t dir)
+{
+    return m_rings[dir].used > RELAY_RING_HIGH_WATER;
+}
+
+void relay_stats_get(relay_dir_t dir, relay_stats_t *p_stats)
+{
+    *p_stats = m_rings[dir].stats;
+}
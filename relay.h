@@ -0,0 +1,67 @@
+#ifndef RELAY_H
+#define RELAY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "sdk_errors.h"
+
+// Reenvio en vivo celular <-> emisor.
+//
+// Cada sentido tiene un anillo en RAM con las tramas que el stack no pudo
+// aceptar (NRF_ERROR_RESOURCES / NRF_ERROR_BUSY). Las tramas se guardan como
+// [largo][datos] y se reintentan en orden cuando el stack libera buffers:
+//   - hacia el celular: BLE_NUS_EVT_TX_RDY
+//   - hacia el emisor:  BLE_GATTC_EVT_WRITE_CMD_TX_COMPLETE
+//
+// Si un anillo pasa RELAY_RING_HIGH_WATER bytes se considera saturado y las
+// fuentes que pueden esperar (recuperacion de historiales, telemetria) dejan
+// de generar trafico hasta que baje. Con el anillo lleno la trama nueva se
+// descarta y se cuenta.
+
+#define RELAY_RING_SIZE        512
+#define RELAY_RING_HIGH_WATER  (RELAY_RING_SIZE * 3 / 4)
+#define RELAY_MAX_FRAME        244 // Maximo de datos NUS con MTU 247
+
+typedef enum
+{
+    RELAY_DIR_TO_PHONE  = 0, // Emisor -> celular
+    RELAY_DIR_TO_EMISOR = 1, // Celular -> emisor
+    RELAY_DIR_COUNT
+} relay_dir_t;
+
+typedef struct
+{
+    uint32_t bytes_in;      // Bytes recibidos para reenviar
+    uint32_t bytes_out;     // Bytes aceptados por el stack
+    uint32_t frames_dropped;
+    uint32_t bytes_dropped;
+    uint16_t max_used;      // Maximo ocupado del anillo
+} relay_stats_t;
+
+void       relay_init(void);
+
+/**@brief Reenvia una trama al celular, o la encola si el stack esta ocupado.
+ *
+ * @retval NRF_SUCCESS         Enviada o encolada.
+ * @retval NRF_ERROR_NO_MEM    Anillo lleno, trama descartada.
+ * @return Otro error del stack si no hay celular conectado (no se encola).
+ */
+ret_code_t relay_to_phone(uint8_t const *p_data, uint16_t length);
+
+/**@brief Reenvia una trama al emisor, o la encola si el stack esta ocupado. */
+ret_code_t relay_to_emisor(uint8_t const *p_data, uint16_t length);
+
+// Eventos de buffers liberados: reintentar lo pendiente
+void       relay_on_phone_tx_ready(void);
+void       relay_on_emisor_tx_complete(void);
+
+// Desconexiones: lo pendiente hacia el celular pasa a la cola persistente,
+// lo pendiente hacia el emisor se descarta
+void       relay_on_phone_disconnected(void);
+void       relay_on_emisor_disconnected(void);
+
+bool       relay_is_throttled(relay_dir_t dir);
+void       relay_stats_get(relay_dir_t dir, relay_stats_t *p_stats);
+
+#endif // RELAY_H
@@ -0,0 +1,408 @@
+#include "relay_queue.h"
+
+#include <string.h>
+
+#include "app_nus_server.h"
+#include "calendar.h"
+#include "fds.h"
+#include "filesystem.h"
+#include "nrf_log.h"
+#include "variables.h"
+
+// Entrada tal como se guarda en flash (tamaño multiplo de 4 bytes)
+typedef struct
+{
+    uint16_t magic;
+    uint8_t  priority;
+    uint8_t  length;
+    uint32_t seq;        // Orden de llegada
+    uint32_t expires_at; // Segundos desde 2000
+    uint8_t  data[RELAY_QUEUE_MAX_FRAME];
+} relay_queue_entry_t;
+
+static relay_queue_entry_t m_entries[RELAY_QUEUE_CAPACITY];
+static bool                m_used[RELAY_QUEUE_CAPACITY];
+
+// FDS escribe desde m_entries de forma asincrona y fds_record_find() no ve
+// las escrituras pendientes: con una operacion en curso el slot no se reusa
+// y los cambios se aplican con su evento
+static bool                m_flash_busy[RELAY_QUEUE_CAPACITY];
+static bool                m_flash_dirty[RELAY_QUEUE_CAPACITY];
+static uint16_t            m_count   = 0;
+static uint32_t            m_seq     = 0;
+static uint32_t            m_dropped = 0;
+
+static uint32_t relay_queue_now(void)
+{
+    return calendar_get_timestamp(NULL);
+}
+
+static bool entry_expired(relay_queue_entry_t const *p_entry, uint32_t now)
+{
+    return (now != TIMESTAMP_INVALID) && (now >= p_entry->expires_at);
+}
+
+static void entry_classify(uint8_t tag, uint8_t *p_priority, uint32_t *p_ttl)
+{
+    switch (tag)
+    {
+    case 0x08: // Historial: no se puede volver a pedir, maxima prioridad
+        *p_priority = RELAY_QUEUE_PRIO_HIGH;
+        *p_ttl      = RELAY_QUEUE_TTL_HISTORY;
+        break;
+
+    case 0x96: // Valores instantaneos: solo interesa el ultimo
+        *p_priority = RELAY_QUEUE_PRIO_LOW;
+        *p_ttl      = RELAY_QUEUE_TTL_VALUES;
+        break;
+
+    default:
+        *p_priority = RELAY_QUEUE_PRIO_NORMAL;
+        *p_ttl      = RELAY_QUEUE_TTL_DEFAULT;
+        break;
+    }
+}
+
+// Lleva el registro del slot al estado de la RAM: escrito si la entrada esta
+// en uso y se persiste, borrado si no
+static ret_code_t entry_sync(uint8_t slot)
+{
+    ret_code_t        ret;
+    fds_record_desc_t desc   = {0};
+    fds_find_token_t  token  = {0};
+    fds_record_t      record = {
+        .file_id           = RELAY_QUEUE_FILE_ID,
+        .key               = RELAY_QUEUE_RECORD_KEY + slot,
+        .data.p_data       = &m_entries[slot],
+        .data.length_words = BYTES_TO_WORDS(sizeof(relay_queue_entry_t))};
+    bool              found;
+
+    if (m_flash_busy[slot])
+    {
+        m_flash_dirty[slot] = true;
+        return NRF_SUCCESS;
+    }
+    m_flash_dirty[slot] = false;
+
+    found = (fds_record_find(RELAY_QUEUE_FILE_ID, record.key, &desc, &token) == NRF_SUCCESS);
+
+    if (!m_used[slot] || m_entries[slot].priority == RELAY_QUEUE_PRIO_LOW)
+    {
+        // Las entradas de solo RAM no tienen registro
+        ret = found ? fds_record_delete(&desc) : NRF_SUCCESS;
+        if (found && ret == NRF_SUCCESS)
+        {
+            m_flash_busy[slot] = true;
+        }
+        return ret;
+    }
+
+    ret = found ? fds_record_update(&desc, &record) : fds_record_write(&desc, &record);
+    if (ret == NRF_SUCCESS)
+    {
+        m_flash_busy[slot] = true;
+    }
+    else if (ret == FDS_ERR_NO_SPACE_IN_FLASH)
+    {
+        fds_gc();
+    }
+
+    return ret;
+}
+
+static void entry_remove(uint8_t slot)
+{
+    m_used[slot] = false;
+    m_count--;
+
+    // Las entradas de solo RAM no tienen registro
+    if (m_entries[slot].priority != RELAY_QUEUE_PRIO_LOW)
+    {
+        (void)entry_sync(slot);
+    }
+}
+
+// Elige que entrada sacrificar cuando la cola esta llena: primero una vencida,
+// luego la de menor prioridad mas antigua (si no supera a la nueva). Las que
+// FDS todavia esta escribiendo no se pueden pisar.
+static int16_t find_victim(uint8_t priority, uint32_t now)
+{
+    int16_t victim = -1;
+
+    for (uint8_t i = 0; i < RELAY_QUEUE_CAPACITY; i++)
+    {
+        if (!m_used[i] || m_flash_busy[i])
+        {
+            continue;
+        }
+        if (entry_expired(&m_entries[i], now))
+        {
+            return i;
+        }
+        if (m_entries[i].priority > priority)
+        {
+            continue;
+        }
+        if (victim < 0 || m_entries[i].priority < m_entries[victim].priority ||
+            (m_entries[i].priority == m_entries[victim].priority &&
+             m_entries[i].seq < m_entries[victim].seq))
+        {
+            victim = i;
+        }
+    }
+
+    return victim;
+}
+
+// Siguiente entrada a enviar: mayor prioridad y, a igual prioridad, la mas
+// antigua. Las entradas vencidas se eliminan por el camino.
+static int16_t find_next(uint32_t now)
+{
+    int16_t next = -1;
+
+    for (uint8_t i = 0; i < RELAY_QUEUE_CAPACITY; i++)
+    {
+        if (!m_used[i])
+        {
+            continue;
+        }
+        if (entry_expired(&m_entries[i], now))
+        {
+            entry_remove(i);
+            m_dropped++;
+            continue;
+        }
+        if (next < 0 || m_entries[i].priority > m_entries[next].priority ||
+            (m_entries[i].priority == m_entries[next].priority &&
+             m_entries[i].seq < m_entries[next].seq))
+        {
+            next = i;
+        }
+    }
+
+    return next;
+}
+
+void relay_queue_init(void)
+{
+    fds_record_desc_t desc  = {0};
+    fds_find_token_t  token = {0};
+
+    memset(m_used, 0, sizeof(m_used));
+    memset(m_flash_busy, 0, sizeof(m_flash_busy));
+    memset(m_flash_dirty, 0, sizeof(m_flash_dirty));
+    m_count = 0;
+    m_seq   = 0;
+
+    while (fds_record_find_in_file(RELAY_QUEUE_FILE_ID, &desc, &token) == NRF_SUCCESS)
+    {
+        fds_flash_record_t flash_record = {0};
+        if (fds_record_open(&desc, &flash_record) != NRF_SUCCESS)
+        {
+            continue;
+        }
+
+        uint16_t slot = flash_record.p_header->record_key - RELAY_QUEUE_RECORD_KEY;
+        relay_queue_entry_t const *p_entry = flash_record.p_data;
+
+        if (slot < RELAY_QUEUE_CAPACITY && !m_used[slot] &&
+            flash_record.p_header->length_words ==
+                BYTES_TO_WORDS(sizeof(relay_queue_entry_t)) &&
+            p_entry->magic == MAGIC_PASSWORD && p_entry->priority == RELAY_QUEUE_PRIO_LOW)
+        {
+            // Valores guardados por una version anterior: ya no se persisten
+            fds_record_close(&desc);
+            (void)fds_record_delete(&desc);
+            continue;
+        }
+
+        if (slot < RELAY_QUEUE_CAPACITY && !m_used[slot] &&
+            flash_record.p_header->length_words ==
+                BYTES_TO_WORDS(sizeof(relay_queue_entry_t)) &&
+            p_entry->magic == MAGIC_PASSWORD && p_entry->length <= RELAY_QUEUE_MAX_FRAME)
+        {
+            m_entries[slot] = *p_entry;
+            m_used[slot]    = true;
+            m_count++;
+            if (p_entry->seq >= m_seq)
+            {
+                m_seq = p_entry->seq + 1;
+            }
+        }
+        fds_record_close(&desc);
+    }
+
+    if (m_count > 0)
+    {
+        NRF_LOG_RAW_INFO(LOG_INFO " Cola de reenvio: %u tramas pendientes", m_count);
+    }
+}
+
+ret_code_t relay_queue_push(uint8_t const *p_data, uint16_t length)
+{
+    uint8_t  priority;
+    uint32_t ttl;
+    int16_t  slot  = -1;
+    bool     stale = false; // El slot tiene el registro de otra entrada
+    uint32_t now   = relay_queue_now();
+
+    if (p_data == NULL || length == 0 || length > RELAY_QUEUE_MAX_FRAME)
+    {
+        return NRF_ERROR_INVALID_PARAM;
+    }
+
+    entry_classify(p_data[0], &priority, &ttl);
+
+    // Los valores instantaneos se reemplazan: solo se guarda el ultimo
+    if (priority == RELAY_QUEUE_PRIO_LOW)
+    {
+        for (uint8_t i = 0; i < RELAY_QUEUE_CAPACITY; i++)
+        {
+            if (m_used[i] && m_entries[i].data[0] == p_data[0])
+            {
+                slot = i;
+                break;
+            }
+        }
+    }
+
+    if (slot < 0)
+    {
+        for (uint8_t i = 0; i < RELAY_QUEUE_CAPACITY; i++)
+        {
+            if (!m_used[i] && !m_flash_busy[i])
+            {
+                slot = i;
+                break;
+            }
+        }
+    }
+
+    if (slot < 0)
+    {
+        slot = find_victim(priority, now);
+        if (slot < 0)
+        {
+            m_dropped++;
+            NRF_LOG_RAW_INFO(LOG_WARN " Cola de reenvio llena, trama 0x%02X descartada",
+                             p_data[0]);
+            return NRF_ERROR_NO_MEM;
+        }
+        m_used[slot] = false;
+        m_count--;
+        m_dropped++;
+        stale = (m_entries[slot].priority != RELAY_QUEUE_PRIO_LOW);
+    }
+
+    relay_queue_entry_t *p_entry = &m_entries[slot];
+    p_entry->magic               = MAGIC_PASSWORD;
+    p_entry->priority            = priority;
+    p_entry->length              = (uint8_t)length;
+    p_entry->seq                 = m_seq++;
+    p_entry->expires_at          = (now == TIMESTAMP_INVALID) ? TIMESTAMP_INVALID : now + ttl;
+    memset(p_entry->data, 0, sizeof(p_entry->data));
+    memcpy(p_entry->data, p_data, length);
+
+    if (!m_used[slot])
+    {
+        m_used[slot] = true;
+        m_count++;
+    }
+
+    // Una entrada de solo RAM que reemplaza a una persistida borra su registro
+    if (priority != RELAY_QUEUE_PRIO_LOW || stale)
+    {
+        ret_code_t ret = entry_sync((uint8_t)slot);
+        if (ret != NRF_SUCCESS && priority != RELAY_QUEUE_PRIO_LOW)
+        {
+            // La trama queda en RAM y se entrega igual si no hay reinicio
+            NRF_LOG_RAW_INFO(LOG_WARN " Trama encolada solo en RAM: 0x%X", ret);
+        }
+    }
+
+    NRF_LOG_RAW_INFO(LOG_INFO " Trama 0x%02X encolada (%u pendientes)", p_data[0], m_count);
+
+    return NRF_SUCCESS;
+}
+
+void relay_queue_drain(void)
+{
+    // La exportacion de historial tiene el enlace; esperar a que termine
+    if (m_count == 0 || history_send_is_active())
+    {
+        return;
+    }
+
+    uint32_t now = relay_queue_now();
+
+    for (uint8_t sent = 0; sent < RELAY_QUEUE_DRAIN_BURST; sent++)
+    {
+        int16_t slot = find_next(now);
+        if (slot < 0)
+        {
+            break;
+        }
+
+        ret_code_t ret = app_nus_server_send_data(m_entries[slot].data, m_entries[slot].length);
+        if (ret != NRF_SUCCESS)
+        {
+            // Sin buffers o sin celular: se reintenta en el proximo TX_RDY
+            break;
+        }
+        entry_remove((uint8_t)slot);
+    }
+
+    if (m_count == 0)
+    {
+        NRF_LOG_RAW_INFO(LOG_OK " Cola de reenvio vaciada");
+    }
+}
+
+void relay_queue_on_fds_evt(fds_evt_t const *p_evt)
+{
+    uint16_t file_id;
+    uint16_t record_key;
+
+    if (p_evt->id == FDS_EVT_WRITE || p_evt->id == FDS_EVT_UPDATE)
+    {
+        file_id    = p_evt->write.file_id;
+        record_key = p_evt->write.record_key;
+    }
+    else if (p_evt->id == FDS_EVT_DEL_RECORD)
+    {
+        file_id    = p_evt->del.file_id;
+        record_key = p_evt->del.record_key;
+    }
+    else
+    {
+        return;
+    }
+
+    if (file_id != RELAY_QUEUE_FILE_ID || record_key < RELAY_QUEUE_RECORD_KEY ||
+        record_key >= RELAY_QUEUE_RECORD_KEY + RELAY_QUEUE_CAPACITY)
+    {
+        return;
+    }
+
+    uint8_t slot = (uint8_t)(record_key - RELAY_QUEUE_RECORD_KEY);
+
+    m_flash_busy[slot] = false;
+    if (p_evt->result != NRF_SUCCESS && p_evt->id != FDS_EVT_DEL_RECORD)
+    {
+        NRF_LOG_RAW_INFO(LOG_WARN " Trama de la cola solo en RAM: 0x%X", p_evt->result);
+    }
+    if (m_flash_dirty[slot])
+    {
+        (void)entry_sync(slot);
+    }
+}
+
+uint16_t relay_queue_count(void)
+{
+    return m_count;
+}
+
+uint32_t relay_queue_dropped_count(void)
+{
+    return m_dropped;
+}
@@ -0,0 +1,52 @@
+#ifndef RELAY_QUEUE_H
+#define RELAY_QUEUE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "fds.h"
+#include "sdk_errors.h"
+
+// Cola persistente (FDS) de tramas del emisor que no se pudieron entregar al
+// celular. Se vacia sola cuando el celular se conecta y habilita las
+// notificaciones (BLE_NUS_EVT_COMM_STARTED / BLE_NUS_EVT_TX_RDY).
+//
+// Cada entrada ocupa un registro RELAY_QUEUE_RECORD_KEY + slot y tiene una
+// prioridad y una fecha de vencimiento. Si la cola esta llena se descarta la
+// entrada vencida o de menor prioridad mas antigua. Los valores instantaneos
+// (0x96) se reemplazan en cada ciclo y quedan solo en RAM, para no reescribir
+// la flash; un reinicio los pierde, pero el emisor los vuelve a mandar.
+
+#define RELAY_QUEUE_CAPACITY     24
+#define RELAY_QUEUE_MAX_FRAME    48 // Cabe la respuesta 0x08 (44 bytes)
+#define RELAY_QUEUE_DRAIN_BURST  4  // Tramas por llamada a relay_queue_drain()
+
+#define RELAY_QUEUE_TTL_HISTORY  (7UL * 24 * 3600) // Historial 0x08: 7 dias
+#define RELAY_QUEUE_TTL_VALUES   (3600UL)          // Valores 0x96: 1 hora
+#define RELAY_QUEUE_TTL_DEFAULT  (24UL * 3600)
+
+typedef enum
+{
+    RELAY_QUEUE_PRIO_LOW    = 0,
+    RELAY_QUEUE_PRIO_NORMAL = 1,
+    RELAY_QUEUE_PRIO_HIGH   = 2
+} relay_queue_prio_t;
+
+/**@brief Reconstruye la cola desde flash. Llamar despues de fds_initialize(). */
+void       relay_queue_init(void);
+
+/**@brief Encola una trama del emisor. La prioridad y el vencimiento se
+ *        deducen de la etiqueta (primer byte) de la trama.
+ */
+ret_code_t relay_queue_push(uint8_t const *p_data, uint16_t length);
+
+/**@brief Envia al celular las tramas pendientes, de mayor prioridad primero. */
+void       relay_queue_drain(void);
+
+/**@brief Fin de una escritura o borrado de FDS (lo reenvia filesystem.c). */
+void       relay_queue_on_fds_evt(fds_evt_t const *p_evt);
+
+uint16_t   relay_queue_count(void);
+uint32_t   relay_queue_dropped_count(void);
+
+#endif // RELAY_QUEUE_H
@@ -0,0 +1,162 @@
+#include "rendezvous.h"
+
+#include "filesystem.h"
+#include "nordic_common.h"
+#include "nrf_log.h"
+#include "rtc_timer.h"
+#include "variables.h"
+
+static bool     m_has_contact        = false;
+static bool     m_contact_this_cycle = false;
+static bool     m_locked             = false;
+static uint64_t m_last_contact       = 0; // Tick del ultimo contacto
+static uint32_t m_period             = 0; // Periodo del emisor (ticks)
+static uint32_t m_jitter             = 0; // Desvio medio respecto de lo previsto (ticks)
+static uint8_t  m_misses             = 0;
+
+static uint32_t nominal_ticks(void)
+{
+    return (uint32_t)RTC_TIMER_MS_TO_TICKS(
+        read_time_from_flash(TIEMPO_ENCENDIDO, DEFAULT_DEVICE_ON_TIME_MS) +
+        read_time_from_flash(TIEMPO_SLEEP, DEFAULT_DEVICE_SLEEP_TIME_MS));
+}
+
+static uint32_t guard_ms(void)
+{
+    uint32_t guard = RDV_GUARD_MIN_MS + (uint32_t)RTC_TIMER_TICKS_TO_MS(2 * m_jitter);
+    uint32_t on    = read_time_from_flash(TIEMPO_ENCENDIDO, DEFAULT_DEVICE_ON_TIME_MS);
+
+    guard <<= m_misses;
+    guard   = MIN(guard, RDV_GUARD_MAX_MS);
+    // El contacto tiene que caer dentro de la ventana ON
+    if (on > 1)
+    {
+        guard = MIN(guard, on / 2);
+    }
+    return guard;
+}
+
+static int32_t drift_ppm(void)
+{
+    uint32_t nominal = nominal_ticks();
+
+    if (!m_locked || nominal == 0)
+    {
+        return 0;
+    }
+    return (int32_t)(((int64_t)m_period - (int64_t)nominal) * 1000000 / (int64_t)nominal);
+}
+
+static void unlock(void)
+{
+    m_locked = false;
+    m_misses = 0;
+    m_jitter = 0;
+}
+
+void rendezvous_init(void)
+{
+    m_has_contact        = false;
+    m_contact_this_cycle = false;
+    m_period             = 0;
+    unlock();
+}
+
+void rendezvous_on_contact(void)
+{
+    uint64_t now = rtc_timer_ticks();
+
+    if (m_contact_this_cycle)
+    {
+        return;
+    }
+    m_contact_this_cycle = true;
+
+    if (m_has_contact)
+    {
+        uint64_t elapsed = now - m_last_contact;
+        uint64_t ref     = m_locked ? m_period : nominal_ticks();
+        uint64_t cycles  = (ref > 0) ? (elapsed + ref / 2) / ref : 0;
+
+        if (cycles > 0)
+        {
+            uint32_t sample = (uint32_t)(elapsed / cycles);
+
+            if (m_locked)
+            {
+                uint64_t predicted = cycles * m_period;
+                uint32_t error     = (uint32_t)((elapsed > predicted) ? elapsed - predicted
+                                                                      : predicted - elapsed);
+                if (error > m_period / 4)
+                {
+                    // Fuera de fase: se toma la nueva fase sin tocar el periodo
+                    NRF_LOG_RAW_INFO(LOG_WARN " Contacto fuera de lo previsto (%u ms)",
+                                     (uint32_t)RTC_TIMER_TICKS_TO_MS(error));
+                }
+                else
+                {
+                    // Promedios moviles con peso 1/4
+                    m_jitter = (uint32_t)((int32_t)m_jitter +
+                                          ((int32_t)error - (int32_t)m_jitter) / 4);
+                    m_period = (uint32_t)((int32_t)m_period +
+                                          ((int32_t)sample - (int32_t)m_period) / 4);
+                }
+                m_misses = 0;
+            }
+            else if (sample > ref - ref / 8 && sample < ref + ref / 8)
+            {
+                // Con el nominal solo se acepta si el emisor usa el mismo ciclo
+                m_period = sample;
+                m_locked = true;
+                m_misses = 0;
+                NRF_LOG_RAW_INFO(LOG_OK " Cita con el emisor: periodo %u ms, deriva %d ppm",
+                                 (uint32_t)RTC_TIMER_TICKS_TO_MS(m_period),
+                                 drift_ppm());
+            }
+        }
+    }
+
+    m_has_contact  = true;
+    m_last_contact = now;
+}
+
+void rendezvous_on_cycle_end(void)
+{
+    if (!m_contact_this_cycle && m_locked && ++m_misses > RDV_MAX_MISSES)
+    {
+        NRF_LOG_RAW_INFO(LOG_WARN " Sin contacto con el emisor, vuelve el sleep configurado");
+        unlock();
+    }
+    m_contact_this_cycle = false;
+}
+
+uint32_t rendezvous_sleep_ms(uint32_t default_ms)
+{
+    if (!m_locked || m_period == 0)
+    {
+        return default_ms;
+    }
+
+    uint32_t guard   = guard_ms();
+    uint64_t elapsed = rtc_timer_ticks() - m_last_contact;
+    uint64_t lead    = RTC_TIMER_MS_TO_TICKS(guard);
+
+    // Primer contacto previsto que deja al menos RDV_MIN_SLEEP_MS de sleep
+    uint64_t cycles = (elapsed + lead + RTC_TIMER_MS_TO_TICKS(RDV_MIN_SLEEP_MS)) / m_period + 1;
+    uint32_t sleep  = (uint32_t)RTC_TIMER_TICKS_TO_MS(cycles * m_period - lead - elapsed);
+
+    NRF_LOG_RAW_INFO(LOG_INFO " Despertar antes del emisor: sleep %u ms, guarda %u ms",
+                     sleep,
+                     guard);
+    return sleep;
+}
+
+void rendezvous_stats_get(rendezvous_stats_t *p_stats)
+{
+    p_stats->locked    = m_locked;
+    p_stats->period_ms = m_locked ? (uint32_t)RTC_TIMER_TICKS_TO_MS(m_period) : 0;
+    p_stats->drift_ppm = drift_ppm();
+    p_stats->jitter_ms = (uint32_t)RTC_TIMER_TICKS_TO_MS(m_jitter);
+    p_stats->guard_ms  = guard_ms();
+    p_stats->misses    = m_misses;
+}
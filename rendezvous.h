@@ -0,0 +1,54 @@
+#ifndef RENDEZVOUS_H
+#define RENDEZVOUS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Planificacion del despertar segun el contacto real con el emisor principal.
+//
+// Se guarda el tick de rtc_timer (1/1024 s) del primer contacto de cada
+// ciclo (conexion o ADV reconocido). Entre dos contactos pasan k ciclos del emisor;
+// k se obtiene redondeando con el periodo conocido (o con ON+SLEEP
+// configurado mientras no lo hay) y el periodo se ajusta con un promedio movil.
+// La diferencia contra el periodo nominal es la deriva del reloj del emisor.
+//
+// Con el periodo aprendido, el sleep no dura lo configurado: RTC_TIMER_SLEEP
+// vence una guarda antes del proximo contacto previsto. La guarda es
+// un minimo mas dos veces el jitter observado y se duplica por cada ciclo sin
+// contacto; despues de RDV_MAX_MISSES se vuelve al sleep configurado hasta
+// aprender de nuevo.
+
+#define RDV_GUARD_MIN_MS     1000  // Arranque del scan y advertising
+#define RDV_GUARD_MAX_MS     10000
+#define RDV_MIN_SLEEP_MS     1000
+#define RDV_MAX_MISSES       3
+
+typedef struct
+{
+    bool     locked;
+    uint32_t period_ms;  // Periodo estimado del emisor
+    int32_t  drift_ppm;  // Respecto de ON+SLEEP configurado
+    uint32_t jitter_ms;
+    uint32_t guard_ms;
+    uint8_t  misses;
+} rendezvous_stats_t;
+
+void     rendezvous_init(void);
+
+/**@brief Contacto con el emisor principal. Solo cuenta el primero del ciclo. */
+void     rendezvous_on_contact(void);
+
+/**@brief Fin de la ventana ON (transicion a sleep). Un ciclo sin contacto
+ *        ensancha la guarda.
+ */
+void     rendezvous_on_cycle_end(void);
+
+/**@brief Milisegundos de sleep hasta el proximo despertar.
+ *
+ * @param[in] default_ms  Sleep configurado, usado sin periodo aprendido.
+ */
+uint32_t rendezvous_sleep_ms(uint32_t default_ms);
+
+void     rendezvous_stats_get(rendezvous_stats_t *p_stats);
+
+#endif // RENDEZVOUS_H
@@ -0,0 +1,192 @@
+#include "rtc_timer.h"
+
+#include "app_error.h"
+#include "app_util.h"
+#include "app_util_platform.h"
+#include "nordic_common.h"
+#include "nrf_rtc.h"
+#include "nrfx_rtc.h"
+
+#define COUNTER_BITS   24
+#define COUNTER_MASK   ((1UL << COUNTER_BITS) - 1)
+#define MIN_SPAN       3                        // CC debe quedar 2+ ticks adelante
+#define MAX_SPAN       (1UL << (COUNTER_BITS - 1)) // Plazos mas lejanos: despertar intermedio
+#define CC_CHANNEL     0
+
+static const nrfx_rtc_t    m_rtc = NRFX_RTC_INSTANCE(2);
+static rtc_timer_handler_t m_handler;
+static volatile uint32_t   m_overflows = 0;
+static uint64_t            m_deadline[RTC_TIMER_COUNT];
+static uint32_t            m_period[RTC_TIMER_COUNT]; // 0: unico
+static uint8_t             m_running = 0;             // Un bit por slot
+
+STATIC_ASSERT(RTC_TIMER_COUNT <= 8);
+
+// Llamar con las interrupciones de la aplicacion bloqueadas
+static uint64_t ticks_get_locked(void)
+{
+    uint32_t overflows = m_overflows;
+    uint32_t counter   = nrf_rtc_counter_get(m_rtc.p_reg);
+
+    // Desborde ocurrido pero todavia no atendido
+    if (nrf_rtc_event_pending(m_rtc.p_reg, NRF_RTC_EVENT_OVERFLOW))
+    {
+        overflows++;
+        counter = nrf_rtc_counter_get(m_rtc.p_reg);
+    }
+    return ((uint64_t)overflows << COUNTER_BITS) | counter;
+}
+
+// Atiende los vencidos y programa CC0 con el proximo. Devuelve los slots
+// vencidos para avisar fuera de la seccion critica.
+static uint8_t wheel_update_locked(void)
+{
+    uint64_t now     = ticks_get_locked();
+    uint64_t next    = UINT64_MAX;
+    uint8_t  expired = 0;
+
+    for (uint8_t id = 0; id < RTC_TIMER_COUNT; id++)
+    {
+        if (!(m_running & (1 << id)))
+        {
+            continue;
+        }
+        if (m_deadline[id] <= now)
+        {
+            expired |= (uint8_t)(1 << id);
+            if (m_period[id] == 0)
+            {
+                m_running &= (uint8_t)~(1 << id);
+                continue;
+            }
+            while (m_deadline[id] <= now)
+            {
+                m_deadline[id] += m_period[id];
+            }
+        }
+        next = MIN(next, m_deadline[id]);
+    }
+
+    if (next == UINT64_MAX)
+    {
+        nrfx_rtc_cc_disable(&m_rtc, CC_CHANNEL);
+        return expired;
+    }
+
+    next = MIN(next, now + MAX_SPAN);
+    next = MAX(next, now + MIN_SPAN);
+    nrfx_rtc_cc_set(&m_rtc, CC_CHANNEL, (uint32_t)(next & COUNTER_MASK), true);
+    return expired;
+}
+
+static void wheel_update(void)
+{
+    uint8_t expired;
+
+    CRITICAL_REGION_ENTER();
+    expired = wheel_update_locked();
+    CRITICAL_REGION_EXIT();
+
+    for (uint8_t id = 0; id < RTC_TIMER_COUNT; id++)
+    {
+        if (expired & (1 << id))
+        {
+            m_handler((rtc_timer_id_t)id);
+        }
+    }
+}
+
+static void rtc_handler(nrfx_rtc_int_type_t int_type)
+{
+    if (int_type == NRFX_RTC_INT_OVERFLOW)
+    {
+        m_overflows++;
+    }
+    else if (int_type == NRFX_RTC_INT_COMPARE0)
+    {
+        wheel_update();
+    }
+}
+
+static void timer_start(rtc_timer_id_t id, uint32_t ms, uint32_t period_ms)
+{
+    uint32_t ticks = (uint32_t)RTC_TIMER_MS_TO_TICKS(ms);
+
+    CRITICAL_REGION_ENTER();
+    m_deadline[id] = ticks_get_locked() + MAX(ticks, 1);
+    m_period[id]   = (uint32_t)RTC_TIMER_MS_TO_TICKS(period_ms);
+    m_running     |= (uint8_t)(1 << id);
+    CRITICAL_REGION_EXIT();
+
+    wheel_update();
+}
+
+void rtc_timer_init(rtc_timer_handler_t handler)
+{
+    nrfx_rtc_config_t config = NRFX_RTC_DEFAULT_CONFIG;
+    ret_code_t        err_code;
+
+    m_handler         = handler;
+    config.prescaler  = RTC_TIMER_PRESCALER;
+
+    err_code = nrfx_rtc_init(&m_rtc, &config, rtc_handler);
+    APP_ERROR_CHECK(err_code);
+
+    nrfx_rtc_counter_clear(&m_rtc);
+    nrfx_rtc_overflow_enable(&m_rtc, true);
+    nrfx_rtc_enable(&m_rtc);
+}
+
+void rtc_timer_start(rtc_timer_id_t id, uint32_t ms)
+{
+    timer_start(id, ms, 0);
+}
+
+void rtc_timer_start_periodic(rtc_timer_id_t id, uint32_t first_ms, uint32_t period_ms)
+{
+    timer_start(id, first_ms, period_ms);
+}
+
+void rtc_timer_stop(rtc_timer_id_t id)
+{
+    CRITICAL_REGION_ENTER();
+    m_running &= (uint8_t)~(1 << id);
+    CRITICAL_REGION_EXIT();
+
+    wheel_update();
+}
+
+bool rtc_timer_is_running(rtc_timer_id_t id)
+{
+    return (m_running & (1 << id)) != 0;
+}
+
+uint32_t rtc_timer_remaining_ms(rtc_timer_id_t id)
+{
+    uint64_t now;
+    uint64_t deadline;
+    bool     running;
+
+    CRITICAL_REGION_ENTER();
+    now      = ticks_get_locked();
+    deadline = m_deadline[id];
+    running  = (m_running & (1 << id)) != 0;
+    CRITICAL_REGION_EXIT();
+
+    if (!running || deadline <= now)
+    {
+        return 0;
+    }
+    return (uint32_t)RTC_TIMER_TICKS_TO_MS(deadline - now);
+}
+
+uint64_t rtc_timer_ticks(void)
+{
+    uint64_t ticks;
+
+    CRITICAL_REGION_ENTER();
+    ticks = ticks_get_locked();
+    CRITICAL_REGION_EXIT();
+
+    return ticks;
+}
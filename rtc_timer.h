@@ -0,0 +1,53 @@
+#ifndef RTC_TIMER_H
+#define RTC_TIMER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Base de tiempo del ciclo de encendido sobre el RTC2.
+//
+// El RTC corre a 1024 Hz (prescaler 31, ~1 ms) y el desborde de su contador
+// de 24 bits (cada 16384 s) se cuenta por software, asi que
+// rtc_timer_ticks() es monotono en 64 bits. Sobre esa base hay una rueda de
+// temporizadores con un slot por plazo; el comparador CC0 se programa con el
+// vencimiento mas cercano y al dispararse se atienden todos los vencidos.
+// Los periodicos se reprograman sobre el plazo anterior, sin acumular error.
+//
+// El manejador corre en la interrupcion del RTC2: solo debe publicar
+// eventos o levantar banderas.
+
+#define RTC_TIMER_FREQ_HZ          1024
+#define RTC_TIMER_PRESCALER        (32768 / RTC_TIMER_FREQ_HZ - 1)
+#define RTC_TIMER_MS_TO_TICKS(ms)  ((uint64_t)(ms) * RTC_TIMER_FREQ_HZ / 1000)
+#define RTC_TIMER_TICKS_TO_MS(t)   ((uint64_t)(t) * 1000 / RTC_TIMER_FREQ_HZ)
+
+typedef enum
+{
+    RTC_TIMER_ON = 0,  // Fin de la ventana ON
+    RTC_TIMER_SLEEP,   // Fin del sleep
+    RTC_TIMER_SEARCH,  // Inicio y fin de la busqueda extendida
+    RTC_TIMER_SECOND,  // Tick de 1 Hz del calendario, solo a pedido
+    RTC_TIMER_COUNT
+} rtc_timer_id_t;
+
+typedef void (*rtc_timer_handler_t)(rtc_timer_id_t id);
+
+/**@brief Inicia el RTC2 (requiere el LFCLK andando). */
+void     rtc_timer_init(rtc_timer_handler_t handler);
+
+/**@brief Programa un vencimiento unico dentro de @p ms (reemplaza el anterior). */
+void     rtc_timer_start(rtc_timer_id_t id, uint32_t ms);
+
+/**@brief Programa un vencimiento periodico; el primero dentro de @p first_ms. */
+void     rtc_timer_start_periodic(rtc_timer_id_t id, uint32_t first_ms, uint32_t period_ms);
+
+void     rtc_timer_stop(rtc_timer_id_t id);
+bool     rtc_timer_is_running(rtc_timer_id_t id);
+
+/**@brief Milisegundos hasta el vencimiento, 0 si no esta programado. */
+uint32_t rtc_timer_remaining_ms(rtc_timer_id_t id);
+
+/**@brief Ticks de 1/1024 s desde el arranque. */
+uint64_t rtc_timer_ticks(void);
+
+#endif // RTC_TIMER_H
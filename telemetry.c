@@ -0,0 +1,228 @@
+#include "telemetry.h"
+
+#include "app_error.h"
+#include "app_nus_server.h"
+#include "app_timer.h"
+#include "calendar.h"
+#include "cmd_sequencer.h"
+#include "nrf_log.h"
+#include "relay.h"
+#include "variables.h"
+
+APP_TIMER_DEF(m_telemetry_timer);
+
+typedef struct
+{
+    uint16_t v1;
+    uint16_t v2;
+    uint32_t contador;
+    uint32_t timestamp; // Momento en que llego la muestra (segundos desde 2000)
+} telemetry_sample_t;
+
+static telemetry_mode_t   m_mode            = TELEMETRY_MODE_OFF;
+static uint16_t           m_period_s        = TELEMETRY_DEFAULT_PERIOD_S;
+static telemetry_sample_t m_latest          = {0};
+static telemetry_sample_t m_published       = {0};
+static bool               m_has_sample      = false; // Hay al menos una muestra
+static bool               m_sample_pending  = false; // Muestra aun no publicada
+static bool               m_has_published   = false;
+static bool               m_poll_pending    = false; // "96" pedido por nosotros
+static uint8_t            m_seq             = 0;
+static uint32_t           m_dropped         = 0;
+
+static const uint8_t      m_poll_command[]  = {'9', '6'};
+
+static uint32_t telemetry_now(void)
+{
+    return calendar_get_timestamp(NULL);
+}
+
+static bool sample_changed(void)
+{
+    return !m_has_published || m_latest.v1 != m_published.v1 ||
+           m_latest.v2 != m_published.v2 ||
+           m_latest.contador != m_published.contador;
+}
+
+// true si la trama salio hacia el celular
+static bool telemetry_publish(void)
+{
+    uint8_t  frame[TELEMETRY_FRAME_SIZE];
+    uint16_t pos = 0;
+    uint32_t age = telemetry_now() - m_latest.timestamp;
+
+    frame[pos++] = TELEMETRY_FRAME_TAG;
+    frame[pos++] = m_seq;
+    frame[pos++] = MSB_16(m_latest.v1);
+    frame[pos++] = LSB_16(m_latest.v1);
+    frame[pos++] = MSB_16(m_latest.v2);
+    frame[pos++] = LSB_16(m_latest.v2);
+    frame[pos++] = (m_latest.contador >> 24) & 0xFF;
+    frame[pos++] = (m_latest.contador >> 16) & 0xFF;
+    frame[pos++] = (m_latest.contador >> 8) & 0xFF;
+    frame[pos++] = (m_latest.contador & 0xFF);
+    frame[pos++] = (age > UINT8_MAX) ? UINT8_MAX : (uint8_t)age;
+
+    ret_code_t err_code = app_nus_server_send_data(frame, pos);
+    if (err_code == NRF_SUCCESS)
+    {
+        m_seq++;
+        m_published      = m_latest;
+        m_has_published  = true;
+        m_sample_pending = false;
+        return true;
+    }
+    else if (err_code == NRF_ERROR_RESOURCES || err_code == NRF_ERROR_BUSY)
+    {
+        // Sin buffers: se descarta esta trama. La muestra queda pendiente y
+        // sera reemplazada por la siguiente que llegue del emisor.
+        m_dropped++;
+    }
+    else
+    {
+        NRF_LOG_RAW_INFO(LOG_WARN " Telemetria no enviada: 0x%X", err_code);
+    }
+    return false;
+}
+
+static void telemetry_timer_handler(void *p_context)
+{
+    UNUSED_PARAMETER(p_context);
+
+    // Publicar una muestra que llego entre ticks (ej. la consulta inicial
+    // del ciclo) o que quedo pendiente por falta de buffers
+    if (m_sample_pending &&
+        (m_mode == TELEMETRY_MODE_PERIODIC || sample_changed()))
+    {
+        (void)telemetry_publish();
+    }
+
+    // Una consulta propia que ya no esta en la cola se perdio (sin respuesta
+    // o emisor desconectado)
+    if (m_poll_pending && !cmd_seq_is_pending(0x96))
+    {
+        m_poll_pending = false;
+    }
+
+    // Pedir valores nuevos a traves del secuenciador (no pisar un "96" que ya
+    // este en curso: su respuesta tambien actualiza la muestra). Si el celular
+    // no alcanza a consumir no se genera mas trafico; la muestra actual se
+    // publica cuando se descargue.
+    if (cmd_seq_is_pending(0x96) || relay_is_throttled(RELAY_DIR_TO_PHONE))
+    {
+        return;
+    }
+
+    // Solo queda en la cola si el secuenciador pudo enviarla o la va a
+    // reintentar; sin enlace con el emisor no hay muestra nueva en este periodo
+    if (cmd_seq_push(m_poll_command,
+                     sizeof(m_poll_command),
+                     0x96,
+                     CMD_SEQ_DEFAULT_TIMEOUT_MS,
+                     0) == NRF_SUCCESS &&
+        cmd_seq_is_pending(0x96))
+    {
+        m_poll_pending = true;
+    }
+}
+
+void telemetry_init(void)
+{
+    ret_code_t err_code = app_timer_create(&m_telemetry_timer,
+                                           APP_TIMER_MODE_REPEATED,
+                                           telemetry_timer_handler);
+    APP_ERROR_CHECK(err_code);
+}
+
+void telemetry_subscribe(telemetry_mode_t mode, uint16_t period_s)
+{
+    ret_code_t err_code;
+
+    if (mode == TELEMETRY_MODE_OFF)
+    {
+        telemetry_unsubscribe();
+        return;
+    }
+
+    if (period_s < TELEMETRY_MIN_PERIOD_S)
+    {
+        period_s = TELEMETRY_MIN_PERIOD_S;
+    }
+    if (period_s > TELEMETRY_MAX_PERIOD_S)
+    {
+        period_s = TELEMETRY_MAX_PERIOD_S;
+    }
+
+    (void)app_timer_stop(m_telemetry_timer);
+
+    m_mode          = mode;
+    m_period_s      = period_s;
+    m_seq           = 0;
+    m_dropped       = 0;
+    m_has_published = false;
+    m_poll_pending  = false;
+    // La ultima muestra conocida se publica en el primer tick
+    m_sample_pending = m_has_sample;
+
+    err_code = app_timer_start(m_telemetry_timer,
+                               APP_TIMER_TICKS((uint32_t)period_s * 1000),
+                               NULL);
+    APP_ERROR_CHECK(err_code);
+
+    NRF_LOG_RAW_INFO(LOG_OK " Telemetria %s cada %u s",
+                     (mode == TELEMETRY_MODE_PERIODIC) ? "periodica" : "por cambio",
+                     period_s);
+}
+
+void telemetry_unsubscribe(void)
+{
+    if (m_mode == TELEMETRY_MODE_OFF)
+    {
+        return;
+    }
+
+    (void)app_timer_stop(m_telemetry_timer);
+    m_mode         = TELEMETRY_MODE_OFF;
+    m_poll_pending = false;
+
+    NRF_LOG_RAW_INFO(LOG_INFO " Telemetria detenida (descartadas: %u)", m_dropped);
+}
+
+telemetry_mode_t telemetry_mode_get(void)
+{
+    return m_mode;
+}
+
+uint32_t telemetry_dropped_count(void)
+{
+    return m_dropped;
+}
+
+bool telemetry_on_emisor_values(uint16_t v1, uint16_t v2, uint32_t contador)
+{
+    bool requested     = m_poll_pending;
+
+    // Siempre se conserva solo la muestra mas reciente
+    m_latest.v1        = v1;
+    m_latest.v2        = v2;
+    m_latest.contador  = contador;
+    m_latest.timestamp = telemetry_now();
+    m_has_sample       = true;
+    m_sample_pending   = true;
+    m_poll_pending     = false;
+
+    if (m_mode == TELEMETRY_MODE_OFF)
+    {
+        return false;
+    }
+
+    if (m_mode == TELEMETRY_MODE_PERIODIC || sample_changed())
+    {
+        // Si la 0x97 no salio, el celular recibe al menos la respuesta cruda
+        return telemetry_publish() && requested;
+    }
+
+    // Sin cambios: nada que publicar
+    m_sample_pending = false;
+    return requested;
+}
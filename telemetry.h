@@ -0,0 +1,41 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Telemetria en vivo del emisor hacia el celular (comando 23).
+//
+// El repetidor consulta al emisor ("96") con su propio periodo, guarda solo la
+// ultima muestra y la publica al celular como trama binaria:
+//   [0x97][seq][V1 MSB][V1 LSB][V2 MSB][V2 LSB][contador (4, BE)][edad (s)]
+// Si el enlace con el celular no tiene buffers libres la trama se descarta
+// (se cuenta) y se publica la siguiente muestra, nunca una vieja.
+
+#define TELEMETRY_FRAME_TAG         0x97
+#define TELEMETRY_FRAME_SIZE        11
+#define TELEMETRY_DEFAULT_PERIOD_S  5
+#define TELEMETRY_MIN_PERIOD_S      1
+#define TELEMETRY_MAX_PERIOD_S      3600
+
+typedef enum
+{
+    TELEMETRY_MODE_OFF       = 0, // Sin suscripcion
+    TELEMETRY_MODE_PERIODIC  = 1, // Publica la ultima muestra cada periodo
+    TELEMETRY_MODE_ON_CHANGE = 2  // Publica solo cuando cambian los valores
+} telemetry_mode_t;
+
+void             telemetry_init(void);
+void             telemetry_subscribe(telemetry_mode_t mode, uint16_t period_s);
+void             telemetry_unsubscribe(void);
+telemetry_mode_t telemetry_mode_get(void);
+uint32_t         telemetry_dropped_count(void);
+
+/**@brief Entrega una respuesta 0x96 del emisor al modulo de telemetria.
+ *
+ * @return true si la respuesta fue pedida por la suscripcion y ya se publico
+ *         (no hace falta reenviarla cruda al celular).
+ */
+bool             telemetry_on_emisor_values(uint16_t v1, uint16_t v2, uint32_t contador);
+
+#endif // TELEMETRY_H
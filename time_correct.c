@@ -0,0 +1,39 @@
+#include "time_correct.h"
+
+#include "timestamp.h"
+
+#define EIGHTHS TIME_CORRECT_EIGHTHS_PER_SECOND
+
+uint32_t time_correct_apply(time_correct_t const *p_model, uint32_t emisor_timestamp)
+{
+    int64_t stamp = (int64_t)emisor_timestamp * EIGHTHS;
+    int64_t base; // Hora del emisor en el punto de referencia del tramo, en octavos
+    int64_t offset;
+
+    if (p_model->last_sync == 0 || emisor_timestamp == TIMESTAMP_INVALID)
+    {
+        return emisor_timestamp;
+    }
+
+    // Offset que tenia el emisor cuando genero el registro: el del tramo al
+    // que pertenece, menos lo que derivo desde la referencia de ese tramo.
+    // Todo en la hora del emisor, que es con la que se marco el registro.
+    base = (int64_t)p_model->last_adjust * EIGHTHS + p_model->adjust_offset;
+    if (p_model->last_adjust != 0 && stamp < base)
+    {
+        offset = p_model->adjust_offset;
+    }
+    else
+    {
+        base   = (int64_t)p_model->last_sync * EIGHTHS + p_model->residual;
+        offset = p_model->residual;
+    }
+    // Deriva en ppm sobre el tiempo transcurrido: octavos = ppm * s / 125000
+    offset -= (int64_t)p_model->drift_ppm * ((base - stamp) / EIGHTHS) / 125000;
+
+    // Redondeo a segundos
+    offset = (offset >= 0) ? (offset + EIGHTHS / 2) / EIGHTHS
+                           : (offset - EIGHTHS / 2) / EIGHTHS;
+
+    return (uint32_t)((int64_t)emisor_timestamp - offset);
+}
@@ -0,0 +1,36 @@
+#ifndef TIME_CORRECT_H
+#define TIME_CORRECT_H
+
+#include <stdint.h>
+
+// Correccion de la hora de los registros del emisor (ver time_sync.h).
+//
+// Este modulo no depende del SDK para poder probarse en el host
+// (tools/time_correct_test.c).
+//
+// El reloj del emisor tiene dos tramos: antes del ultimo ajuste ("062") iba
+// corrido adjust_offset; despues quedo con residual, que se mide en cada
+// sincronizacion. En los dos deriva drift_ppm. El limite entre tramos es la
+// hora del emisor al momento del ajuste (last_adjust + adjust_offset). Con
+// offset positivo, los registros de la primera parte del tramo nuevo
+// (adjust_offset segundos) no se distinguen de los ultimos del anterior y se
+// corrigen como anteriores.
+
+#define TIME_CORRECT_EIGHTHS_PER_SECOND 8
+
+typedef struct
+{
+    int32_t  residual;      // Offset despues del ajuste, en octavos (emisor - repetidor)
+    int32_t  adjust_offset; // Offset que corrigio el ultimo ajuste, en octavos
+    int32_t  drift_ppm;
+    uint32_t last_sync;     // Segundos desde 2000 (repetidor), 0 = nunca
+    uint32_t last_adjust;   // Segundos desde 2000 (repetidor), 0 = nunca
+} time_correct_t;
+
+/**@brief Lleva una hora del emisor (segundos desde 2000) al reloj del
+ *        repetidor. Sin sincronizacion o con TIMESTAMP_INVALID la devuelve
+ *        igual.
+ */
+uint32_t time_correct_apply(time_correct_t const *p_model, uint32_t emisor_timestamp);
+
+#endif // TIME_CORRECT_H
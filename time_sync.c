@@ -0,0 +1,171 @@
+#include "time_sync.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "app_nus_client.h"
+#include "calendar.h"
+#include "cmd_sequencer.h"
+#include "emisor_table.h"
+#include "nordic_common.h"
+#include "nrf_log.h"
+#include "time_correct.h"
+#include "variables.h"
+
+#define EIGHTHS_PER_SECOND 8
+
+// Hora del repetidor en octavos de segundo desde 2000
+static int64_t now_eighths(void)
+{
+    uint8_t  eighths;
+    uint32_t seconds = calendar_get_timestamp(&eighths);
+
+    return (int64_t)seconds * EIGHTHS_PER_SECOND + eighths;
+}
+
+static void stamp_pack(uint8_t *p_out, int64_t eighths)
+{
+    uint32_t seconds = (uint32_t)(eighths / EIGHTHS_PER_SECOND);
+
+    p_out[0]         = (seconds >> 24) & 0xFF;
+    p_out[1]         = (seconds >> 16) & 0xFF;
+    p_out[2]         = (seconds >> 8) & 0xFF;
+    p_out[3]         = seconds & 0xFF;
+    p_out[4]         = (uint8_t)(eighths % EIGHTHS_PER_SECOND);
+}
+
+static int64_t stamp_unpack(uint8_t const *p_in)
+{
+    uint32_t seconds = ((uint32_t)p_in[0] << 24) | ((uint32_t)p_in[1] << 16) |
+                       ((uint32_t)p_in[2] << 8) | p_in[3];
+
+    return (int64_t)seconds * EIGHTHS_PER_SECOND + (p_in[4] % EIGHTHS_PER_SECOND);
+}
+
+// Emisor con firmware anterior: hora en texto, resolucion de 1 s
+static void time_sync_send_legacy(void)
+{
+    char       cmd[CMD_SEQ_MAX_CMD_LEN] = {0};
+    datetime_t now;
+
+    (void)calendar_get_time(&now);
+    snprintf(cmd,
+             sizeof(cmd),
+             "060%04u.%02u.%02u %02u.%02u.%02u",
+             now.year,
+             now.month,
+             now.day,
+             now.hour,
+             now.minute,
+             now.second);
+    if (cmd_seq_push((uint8_t *)cmd, strlen(cmd), CMD_SEQ_NO_RESPONSE, 0, 0) != NRF_SUCCESS)
+    {
+        NRF_LOG_RAW_INFO(LOG_FAIL " Fallo al encolar la hora para el emisor");
+    }
+}
+
+static void time_sync_fail_handler(uint16_t context)
+{
+    UNUSED_PARAMETER(context);
+
+    NRF_LOG_RAW_INFO(LOG_WARN " Emisor sin sincronizacion binaria, enviando hora en texto");
+    time_sync_send_legacy();
+}
+
+// Ajusta el reloj del emisor compensando la mitad del tiempo de ida y vuelta.
+// Se envia directo (no por la cola) para que la marca salga en el momento.
+static void time_sync_send_adjust(uint16_t rtt)
+{
+    uint8_t cmd[3 + TIME_SYNC_STAMP_SIZE] = {'0', '6', '2'};
+
+    stamp_pack(&cmd[3], now_eighths() + rtt / 2);
+    if (app_nus_client_send_data(cmd, sizeof(cmd)) != NRF_SUCCESS)
+    {
+        // Stack ocupado: por la cola, con la marca un poco atrasada
+        (void)cmd_seq_push(cmd, sizeof(cmd), CMD_SEQ_NO_RESPONSE, 0, 0);
+    }
+}
+
+void time_sync_start(void)
+{
+    uint8_t cmd[3 + TIME_SYNC_STAMP_SIZE] = {'0', '6', '1'};
+
+    // Se encola primero en la conexion, por lo que sale enseguida y t1 no
+    // queda atrasado respecto del envio real
+    stamp_pack(&cmd[3], now_eighths());
+    if (cmd_seq_push_with_handler(cmd,
+                                  sizeof(cmd),
+                                  TIME_SYNC_REQUEST_TAG,
+                                  TIME_SYNC_TIMEOUT_MS,
+                                  0,
+                                  time_sync_fail_handler,
+                                  0) != NRF_SUCCESS)
+    {
+        NRF_LOG_RAW_INFO(LOG_FAIL " Fallo al encolar la sincronizacion de hora");
+    }
+}
+
+void time_sync_on_reply(uint8_t const *p_data, uint16_t length)
+{
+    emisor_entry_t *p_emisor = emisor_table_current();
+    int64_t         t1, t2, t3, t4;
+    int64_t         rtt, offset;
+    uint32_t        now_s;
+
+    if (length < TIME_SYNC_REPLY_SIZE || p_data[0] != TIME_SYNC_REQUEST_TAG)
+    {
+        return;
+    }
+
+    t4     = now_eighths();
+    t1     = stamp_unpack(&p_data[1]);
+    t2     = stamp_unpack(&p_data[1 + TIME_SYNC_STAMP_SIZE]);
+    t3     = stamp_unpack(&p_data[1 + 2 * TIME_SYNC_STAMP_SIZE]);
+    rtt    = (t4 - t1) - (t3 - t2);
+    offset = ((t2 - t1) + (t3 - t4)) / 2;
+    now_s  = (uint32_t)(t4 / EIGHTHS_PER_SECOND);
+
+    if (rtt < 0)
+    {
+        rtt = 0;
+    }
+
+    // Deriva: cuanto se movio el offset desde el ultimo ajuste
+    if (p_emisor->last_sync != 0 && now_s > p_emisor->last_sync)
+    {
+        p_emisor->drift_ppm = (int32_t)((offset - p_emisor->clock_residual) * 125000 /
+                                        (int64_t)(now_s - p_emisor->last_sync));
+    }
+    p_emisor->clock_offset = (int32_t)offset;
+    p_emisor->rtt          = (uint16_t)MIN(rtt, UINT16_MAX);
+    p_emisor->last_sync    = now_s;
+
+    NRF_LOG_RAW_INFO(LOG_INFO " Hora del emisor: offset %d/8 s, ida y vuelta %u/8 s, deriva %d ppm",
+                     p_emisor->clock_offset,
+                     p_emisor->rtt,
+                     p_emisor->drift_ppm);
+
+    if (offset > TIME_SYNC_MAX_OFFSET || offset < -TIME_SYNC_MAX_OFFSET)
+    {
+        time_sync_send_adjust(p_emisor->rtt);
+        p_emisor->clock_residual = 0;
+        p_emisor->adjust_offset  = (int32_t)offset;
+        p_emisor->last_adjust    = now_s;
+    }
+    else
+    {
+        p_emisor->clock_residual = (int32_t)offset;
+    }
+}
+
+uint32_t time_sync_correct(uint32_t emisor_timestamp)
+{
+    emisor_entry_t const *p_emisor = emisor_table_current();
+    time_correct_t const  model    = {.residual      = p_emisor->clock_residual,
+                                      .adjust_offset = p_emisor->adjust_offset,
+                                      .drift_ppm     = p_emisor->drift_ppm,
+                                      .last_sync     = p_emisor->last_sync,
+                                      .last_adjust   = p_emisor->last_adjust};
+
+    return time_correct_apply(&model, emisor_timestamp);
+}
@@ -0,0 +1,45 @@
+#ifndef TIME_SYNC_H
+#define TIME_SYNC_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Sincronizacion binaria de hora repetidor -> emisor.
+//
+// Intercambio tipo NTP con resolucion de 1/8 s. Cada marca de tiempo viaja
+// como [segundos desde 2000 (4, BE)][octavos (1)]:
+//
+//   Pedido:    "061" + t1                 (t1 = envio del repetidor)
+//   Respuesta: [0x61][t1][t2][t3]         (t2 = recepcion, t3 = envio del emisor)
+//   Ajuste:    "062" + t                  (sin respuesta)
+//
+// Con t4 = recepcion en el repetidor:
+//   ida y vuelta = (t4 - t1) - (t3 - t2)
+//   offset       = ((t2 - t1) + (t3 - t4)) / 2   (emisor - repetidor)
+//
+// Si el offset supera TIME_SYNC_MAX_OFFSET se envia el ajuste con la hora
+// actual mas la mitad del tiempo de ida y vuelta. El offset y la deriva se
+// guardan por emisor (emisor_table.h) y se usan para corregir la hora de los
+// historiales que llegan del emisor: los marcados antes del ultimo ajuste
+// con el offset que este corrigio, los posteriores con el que quedo
+// (time_correct.h). Si el emisor no responde al pedido (firmware anterior)
+// se usa el comando de texto "060".
+
+#define TIME_SYNC_REQUEST_TAG  0x61
+#define TIME_SYNC_REPLY_SIZE   16
+#define TIME_SYNC_STAMP_SIZE   5
+#define TIME_SYNC_MAX_OFFSET   1 // En octavos de segundo
+#define TIME_SYNC_TIMEOUT_MS   500
+
+/**@brief Encola el pedido de sincronizacion para el emisor conectado. */
+void     time_sync_start(void);
+
+/**@brief Procesa una respuesta 0x61 del emisor. */
+void     time_sync_on_reply(uint8_t const *p_data, uint16_t length);
+
+/**@brief Convierte una hora del emisor actual (segundos desde 2000) a la
+ *        hora del repetidor con el offset y la deriva estimados.
+ */
+uint32_t time_sync_correct(uint32_t emisor_timestamp);
+
+#endif // TIME_SYNC_H
@@ -0,0 +1,85 @@
+#include "timestamp.h"
+
+#include <stddef.h>
+
+#define SECONDS_PER_DAY 86400UL
+
+// Las conversiones cuentan los años desde marzo (H. Hinnant, "chrono-
+// compatible low-level date algorithms"): asi el 29 de febrero cae al final
+// del año y la longitud de los meses sale de (153 * mes + 2) / 5. Se trabaja en
+// eras de 400 años (146097 dias) desde el 01/03/0000.
+#define DAYS_PER_ERA    146097UL
+#define DAYS_TO_EPOCH   730425UL // Del 01/03/0000 al 01/01/2000
+
+uint32_t timestamp_days_from_civil(uint16_t year, uint8_t month, uint8_t day)
+{
+    uint32_t y   = (uint32_t)year - (month <= 2);
+    uint32_t mp  = ((uint32_t)month + 9) % 12; // Marzo = 0
+    uint32_t era = y / 400;
+    uint32_t yoe = y - era * 400;
+    uint32_t doy = (153 * mp + 2) / 5 + day - 1;
+    uint32_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+
+    return era * DAYS_PER_ERA + doe - DAYS_TO_EPOCH;
+}
+
+void timestamp_civil_from_days(uint32_t days, uint16_t *p_year, uint8_t *p_month,
+                               uint8_t *p_day)
+{
+    uint32_t z   = days + DAYS_TO_EPOCH;
+    uint32_t era = z / DAYS_PER_ERA;
+    uint32_t doe = z - era * DAYS_PER_ERA;
+    uint32_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    uint32_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    uint32_t mp  = (5 * doy + 2) / 153;
+    uint32_t m   = mp + 3 - 12 * (mp >= 10);
+
+    *p_day   = (uint8_t)(doy - (153 * mp + 2) / 5 + 1);
+    *p_month = (uint8_t)m;
+    *p_year  = (uint16_t)(yoe + era * 400 + (m <= 2));
+}
+
+bool timestamp_is_valid(const datetime_t *p_dt)
+{
+    if (p_dt == NULL || p_dt->year < TIMESTAMP_EPOCH_YEAR || p_dt->year > TIMESTAMP_MAX_YEAR ||
+        p_dt->month < 1 || p_dt->month > 12 || p_dt->day < 1 || p_dt->hour > 23 ||
+        p_dt->minute > 59 || p_dt->second > 59)
+    {
+        return false;
+    }
+
+    // El dia existe en el mes si la fecha sobrevive la ida y vuelta
+    uint16_t year;
+    uint8_t  month;
+    uint8_t  day;
+
+    timestamp_civil_from_days(timestamp_days_from_civil(p_dt->year, p_dt->month, p_dt->day),
+                              &year, &month, &day);
+    return month == p_dt->month && day == p_dt->day;
+}
+
+uint32_t timestamp_from_datetime(const datetime_t *p_dt)
+{
+    if (!timestamp_is_valid(p_dt))
+    {
+        return TIMESTAMP_INVALID;
+    }
+
+    return timestamp_days_from_civil(p_dt->year, p_dt->month, p_dt->day) * SECONDS_PER_DAY +
+           (uint32_t)p_dt->hour * 3600 + (uint32_t)p_dt->minute * 60 + p_dt->second;
+}
+
+void timestamp_to_datetime(uint32_t timestamp, datetime_t *p_dt)
+{
+    if (p_dt == NULL)
+    {
+        return;
+    }
+
+    uint32_t secs = timestamp % SECONDS_PER_DAY;
+
+    p_dt->hour   = secs / 3600;
+    p_dt->minute = (secs % 3600) / 60;
+    p_dt->second = secs % 60;
+    timestamp_civil_from_days(timestamp / SECONDS_PER_DAY, &p_dt->year, &p_dt->month, &p_dt->day);
+}
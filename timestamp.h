@@ -0,0 +1,51 @@
+#ifndef TIMESTAMP_H
+#define TIMESTAMP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Este modulo no depende del SDK para poder compilarse tambien en el host
+// (decodificadores de referencia en tools/).
+//
+// Los registros guardados en flash llevan la fecha como segundos desde el
+// 01/01/2000 (uint32_t); el desglose en datetime_t queda para mostrarla y para
+// los formatos de BLE que la piden asi. Las conversiones de dias a fecha son
+// aritmeticas, sin tablas ni lazos por año o mes.
+
+#define TIMESTAMP_EPOCH_YEAR 2000 // Epoca: 01/01/2000 00:00:00
+#define TIMESTAMP_MAX_YEAR   2099
+#define TIMESTAMP_INVALID    0xFFFFFFFF
+
+typedef struct {
+  uint16_t year;
+  uint8_t month;
+  uint8_t day;
+  uint8_t hour;
+  uint8_t minute;
+  uint8_t second;
+} datetime_t;
+
+/**@brief Dias desde el 01/01/2000 hasta la fecha indicada.
+ *
+ * No valida: el resultado solo tiene sentido para fechas desde la epoca.
+ */
+uint32_t timestamp_days_from_civil(uint16_t year, uint8_t month, uint8_t day);
+
+/**@brief Fecha correspondiente a @p days dias desde el 01/01/2000. */
+void     timestamp_civil_from_days(uint32_t days, uint16_t *p_year, uint8_t *p_month,
+                                   uint8_t *p_day);
+
+/**@brief true si la fecha existe y esta dentro del rango 2000-2099. */
+bool     timestamp_is_valid(const datetime_t *p_dt);
+
+/**@brief Convierte una fecha/hora a segundos desde el 01/01/2000.
+ *
+ * @return Segundos desde la epoca, o TIMESTAMP_INVALID si la fecha no es
+ *         valida (ver timestamp_is_valid).
+ */
+uint32_t timestamp_from_datetime(const datetime_t *p_dt);
+
+/**@brief Convierte segundos desde el 01/01/2000 a fecha/hora. */
+void     timestamp_to_datetime(uint32_t timestamp, datetime_t *p_dt);
+
+#endif // TIMESTAMP_H
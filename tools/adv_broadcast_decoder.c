@@ -0,0 +1,248 @@
+// Decodificador de referencia (host) para la difusion de historiales por
+// advertising (comando 28, adv_broadcast.h).
+//
+// Compilar desde la raiz del repositorio:
+//   cc -I. -o adv_broadcast_decoder tools/adv_broadcast_decoder.c timestamp.c
+//
+// Uso: el campo del fabricante de cada ADV recibido, una linea por ADV, en
+// hexadecimal (con o sin espacios), con o sin el company ID delante (3322).
+//   ./adv_broadcast_decoder < captura.txt
+//
+// Los ADV repetidos se ignoran. Imprime un registro por linea en formato CSV
+// cuando llegaron sus dos partes; las tramas de estado y los saltos de
+// secuencia se informan por stderr.
+
+#include <ctype.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "timestamp.h"
+
+#define LINE_MAX_LEN   256
+#define PAYLOAD_SIZE   24   // ADV_PAYLOAD_SIZE
+#define FRAME_TAG      0xB8 // ADV_BROADCAST_FRAME_TAG
+#define STATUS_TAG     0x30
+#define COMPANY_ID_LO  0x33
+#define COMPANY_ID_HI  0x22
+#define PART_BIT       0x80
+#define SLOT_SHIFT     4
+#define SLOT_MASK      0x70
+#define COUNT_MASK     0x0F
+#define PENDING_MAX    16
+#define PRINTED_MAX    64
+
+typedef struct
+{
+    uint32_t timestamp;
+    uint32_t contador;
+    uint16_t v[8];
+    uint8_t  temp;
+    uint8_t  battery;
+    uint8_t  parts; // Bit 0 parte 0, bit 1 parte 1
+} record_t;
+
+static record_t m_pending[PENDING_MAX];
+static int      m_pending_count = 0;
+static uint32_t m_printed[PRINTED_MAX]; // Fechas ya impresas (anillo)
+static int      m_printed_count = 0;
+static int      m_printed_head  = 0;
+
+static int hex_nibble(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    c = (char)tolower((unsigned char)c);
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    return -1;
+}
+
+static int parse_hex_line(const char *p_line, uint8_t *p_out, int max_len)
+{
+    int len = 0;
+    int hi  = -1;
+
+    for (; *p_line != '\0'; p_line++)
+    {
+        int nibble = hex_nibble(*p_line);
+        if (nibble < 0)
+            continue;
+        if (hi < 0)
+        {
+            hi = nibble;
+        }
+        else
+        {
+            if (len >= max_len)
+                return -1;
+            p_out[len++] = (uint8_t)((hi << 4) | nibble);
+            hi           = -1;
+        }
+    }
+    return len;
+}
+
+static uint16_t get_u16(uint8_t const *p_buf)
+{
+    return (uint16_t)((p_buf[0] << 8) | p_buf[1]);
+}
+
+static uint32_t get_u32(uint8_t const *p_buf)
+{
+    return ((uint32_t)p_buf[0] << 24) | ((uint32_t)p_buf[1] << 16) |
+           ((uint32_t)p_buf[2] << 8) | p_buf[3];
+}
+
+static bool already_printed(uint32_t timestamp)
+{
+    for (int i = 0; i < m_printed_count; i++)
+    {
+        if (m_printed[i] == timestamp)
+            return true;
+    }
+    return false;
+}
+
+static void mark_printed(uint32_t timestamp)
+{
+    m_printed[m_printed_head] = timestamp;
+    m_printed_head            = (m_printed_head + 1) % PRINTED_MAX;
+    if (m_printed_count < PRINTED_MAX)
+        m_printed_count++;
+}
+
+static record_t *pending_get(uint32_t timestamp)
+{
+    for (int i = 0; i < m_pending_count; i++)
+    {
+        if (m_pending[i].timestamp == timestamp)
+            return &m_pending[i];
+    }
+    if (m_pending_count == PENDING_MAX)
+    {
+        // Se descarta el mas viejo de los incompletos
+        memmove(&m_pending[0], &m_pending[1], (PENDING_MAX - 1) * sizeof(record_t));
+        m_pending_count--;
+    }
+    memset(&m_pending[m_pending_count], 0, sizeof(record_t));
+    m_pending[m_pending_count].timestamp = timestamp;
+    return &m_pending[m_pending_count++];
+}
+
+static void pending_remove(record_t *p_record)
+{
+    int index = (int)(p_record - m_pending);
+
+    memmove(&m_pending[index], &m_pending[index + 1],
+            (size_t)(m_pending_count - index - 1) * sizeof(record_t));
+    m_pending_count--;
+}
+
+static void print_record(record_t const *p_record)
+{
+    datetime_t dt;
+    timestamp_to_datetime(p_record->timestamp, &dt);
+
+    printf("%04u-%02u-%02u %02u:%02u:%02u,%u",
+           dt.year, dt.month, dt.day, dt.hour, dt.minute, dt.second,
+           (unsigned)p_record->contador);
+    for (int i = 0; i < 8; i++)
+        printf(",%u", p_record->v[i]);
+    printf(",%u,%u\n", p_record->temp, p_record->battery);
+}
+
+static void decode_frame(uint8_t const *p_frame)
+{
+    uint8_t   info      = p_frame[2];
+    uint32_t  timestamp = get_u32(&p_frame[3]);
+    record_t *p_record;
+
+    if (already_printed(timestamp))
+        return;
+
+    p_record = pending_get(timestamp);
+    if (info & PART_BIT)
+    {
+        for (int i = 0; i < 4; i++)
+            p_record->v[4 + i] = get_u16(&p_frame[7 + 2 * i]);
+        p_record->parts |= 0x02;
+    }
+    else
+    {
+        p_record->contador = get_u32(&p_frame[7]);
+        for (int i = 0; i < 4; i++)
+            p_record->v[i] = get_u16(&p_frame[11 + 2 * i]);
+        p_record->temp    = p_frame[19];
+        p_record->battery = p_frame[20];
+        p_record->parts  |= 0x01;
+    }
+
+    if (p_record->parts == 0x03)
+    {
+        print_record(p_record);
+        mark_printed(timestamp);
+        pending_remove(p_record);
+    }
+}
+
+int main(void)
+{
+    char    line[LINE_MAX_LEN];
+    uint8_t data[LINE_MAX_LEN / 2];
+    uint8_t last[PAYLOAD_SIZE];
+    bool    have_last = false;
+    bool    have_seq  = false;
+    uint8_t last_seq  = 0;
+
+    printf("fecha,contador,V1,V2,V3,V4,V5,V6,V7,V8,temp,bateria\n");
+
+    while (fgets(line, sizeof(line), stdin) != NULL)
+    {
+        int            len     = parse_hex_line(line, data, sizeof(data));
+        uint8_t const *p_frame = data;
+
+        if (len == PAYLOAD_SIZE + 2 && data[0] == COMPANY_ID_LO && data[1] == COMPANY_ID_HI)
+        {
+            p_frame = &data[2];
+            len    -= 2;
+        }
+        if (len != PAYLOAD_SIZE)
+        {
+            if (len > 0)
+                fprintf(stderr, "# Largo inesperado (%d bytes)\n", len);
+            continue;
+        }
+
+        // El mismo payload se repite en cada evento de advertising
+        if (have_last && memcmp(last, p_frame, PAYLOAD_SIZE) == 0)
+            continue;
+        memcpy(last, p_frame, PAYLOAD_SIZE);
+        have_last = true;
+
+        switch (p_frame[0])
+        {
+        case FRAME_TAG:
+            if (have_seq && p_frame[1] != (uint8_t)(last_seq + 1))
+                fprintf(stderr, "# Salto de secuencia %u -> %u\n", last_seq, p_frame[1]);
+            last_seq = p_frame[1];
+            have_seq = true;
+            decode_frame(p_frame);
+            break;
+
+        case STATUS_TAG:
+            fprintf(stderr, "# Estado: historiales=%u enlaces=0x%02X\n",
+                    get_u16(&p_frame[7]), p_frame[14]);
+            break;
+
+        default:
+            fprintf(stderr, "# Trama desconocida 0x%02X\n", p_frame[0]);
+            break;
+        }
+    }
+
+    for (int i = 0; i < m_pending_count; i++)
+        fprintf(stderr, "# Registro incompleto (partes 0x%X)\n", m_pending[i].parts);
+
+    return 0;
+}
@@ -0,0 +1,124 @@
+// Decodificador de referencia (host) para la exportacion comprimida de
+// historiales (comando 21 + comando 15).
+//
+// Compilar desde la raiz del repositorio:
+//   cc -I. -o history_decoder tools/history_decoder.c history_codec.c timestamp.c
+//
+// Uso: una trama NUS por linea en hexadecimal (con o sin espacios) por stdin.
+//   ./history_decoder < captura.txt
+//
+// Imprime un registro por linea en formato CSV.
+
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "history_codec.h"
+#include "timestamp.h"
+
+#define LINE_MAX_LEN 1024
+
+static int hex_nibble(char c)
+{
+    if (c >= '0' && c <= '9')
+        return c - '0';
+    c = (char)tolower((unsigned char)c);
+    if (c >= 'a' && c <= 'f')
+        return c - 'a' + 10;
+    return -1;
+}
+
+static int parse_hex_line(const char *p_line, uint8_t *p_out, int max_len)
+{
+    int len = 0;
+    int hi  = -1;
+
+    for (; *p_line != '\0'; p_line++)
+    {
+        int nibble = hex_nibble(*p_line);
+        if (nibble < 0)
+            continue;
+        if (hi < 0)
+        {
+            hi = nibble;
+        }
+        else
+        {
+            if (len >= max_len)
+                return -1;
+            p_out[len++] = (uint8_t)((hi << 4) | nibble);
+            hi           = -1;
+        }
+    }
+    return len;
+}
+
+static void print_record(history_codec_record_t const *p_record)
+{
+    datetime_t dt;
+    timestamp_to_datetime(p_record->timestamp, &dt);
+
+    printf("%04u-%02u-%02u %02u:%02u:%02u,%u",
+           dt.year, dt.month, dt.day, dt.hour, dt.minute, dt.second,
+           (unsigned)p_record->contador);
+    for (int i = 0; i < 8; i++)
+        printf(",%u", p_record->v[i]);
+    printf(",%u,%u\n", p_record->temp, p_record->battery);
+}
+
+int main(void)
+{
+    char                   line[LINE_MAX_LEN];
+    uint8_t                frame[LINE_MAX_LEN / 2];
+    history_codec_record_t records[UINT8_MAX];
+    unsigned               total_decoded = 0;
+
+    printf("fecha,contador,V1,V2,V3,V4,V5,V6,V7,V8,temp,bateria\n");
+
+    while (fgets(line, sizeof(line), stdin) != NULL)
+    {
+        int len = parse_hex_line(line, frame, sizeof(frame));
+        if (len <= 0)
+            continue;
+
+        switch (frame[0])
+        {
+        case HISTORY_CODEC_TAG_ACK:
+            if (len >= 3)
+                fprintf(stderr, "# ACK version=%u habilitado=%u\n", frame[1], frame[2]);
+            break;
+
+        case HISTORY_CODEC_TAG_HEADER:
+            if (len >= 4)
+                fprintf(stderr, "# HEADER version=%u total=%u\n",
+                        frame[1], (frame[2] << 8) | frame[3]);
+            break;
+
+        case HISTORY_CODEC_TAG_BLOCK: {
+            int32_t n = history_codec_block_decode(frame, (uint16_t)len, records, UINT8_MAX);
+            if (n < 0)
+            {
+                fprintf(stderr, "# Bloque seq=%u corrupto\n", frame[1]);
+                break;
+            }
+            for (int32_t i = 0; i < n; i++)
+                print_record(&records[i]);
+            total_decoded += (unsigned)n;
+        }
+        break;
+
+        case HISTORY_CODEC_TAG_END:
+            if (len >= 5)
+                fprintf(stderr, "# END enviados=%u fallos=%u decodificados=%u\n",
+                        (frame[1] << 8) | frame[2], (frame[3] << 8) | frame[4],
+                        total_decoded);
+            break;
+
+        default:
+            fprintf(stderr, "# Trama desconocida 0x%02X (%d bytes)\n", frame[0], len);
+            break;
+        }
+    }
+
+    return 0;
+}
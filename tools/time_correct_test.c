@@ -0,0 +1,112 @@
+// Prueba de host para time_correct.c: registros marcados antes y despues de
+// un ajuste del reloj del emisor, con offset positivo y negativo, con y sin
+// deriva.
+//
+// Compilar y correr desde la raiz del repositorio:
+//   cc -I. -o time_correct_test tools/time_correct_test.c time_correct.c
+//   ./time_correct_test
+//
+// Devuelve 0 si todo coincide; si no, imprime cada diferencia y devuelve 1.
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "time_correct.h"
+#include "timestamp.h"
+
+#define ADJUST_TIME 700000000UL // Hora del ajuste en el repetidor
+#define HOUR        3600L
+
+static int m_failures = 0;
+
+static void check(const char *p_what, time_correct_t const *p_model, uint32_t emisor,
+                  uint32_t expected)
+{
+    uint32_t got = time_correct_apply(p_model, emisor);
+
+    if (got != expected)
+    {
+        printf("FALLA %s: emisor %u -> %u, esperado %u (%+ld s)\n",
+               p_what,
+               emisor,
+               got,
+               expected,
+               (long)got - (long)expected);
+        m_failures++;
+    }
+}
+
+// El emisor iba offset_s adelantado hasta el ajuste, sincronizado en la
+// misma conexion (last_sync == last_adjust), sin deriva
+static void test_adjust(long offset_s)
+{
+    time_correct_t model = {
+        .residual      = 0,
+        .adjust_offset = (int32_t)(offset_s * TIME_CORRECT_EIGHTHS_PER_SECOND),
+        .drift_ppm     = 0,
+        .last_sync     = ADJUST_TIME,
+        .last_adjust   = ADJUST_TIME,
+    };
+
+    // Antes del ajuste: el emisor marco la hora del repetidor mas el offset
+    check("10 min antes del ajuste", &model, ADJUST_TIME - 600 + offset_s, ADJUST_TIME - 600);
+    check("1 s antes del ajuste", &model, ADJUST_TIME - 1 + offset_s, ADJUST_TIME - 1);
+    check("1 dia antes del ajuste", &model, ADJUST_TIME - 86400 + offset_s, ADJUST_TIME - 86400);
+
+    // Despues del ajuste (pasado el tramo ambiguo): ya sin offset
+    check("despues del ajuste", &model, ADJUST_TIME + labs(offset_s) + 10,
+          ADJUST_TIME + labs(offset_s) + 10);
+
+    // Un ciclo despues, con otra sincronizacion sin ajuste (residual 2 s)
+    model.last_sync = ADJUST_TIME + 2 * HOUR + 7200;
+    model.residual  = 2 * TIME_CORRECT_EIGHTHS_PER_SECOND;
+    check("antes del ajuste, sincronizado despues", &model, ADJUST_TIME - 600 + offset_s,
+          ADJUST_TIME - 600);
+    check("despues del ajuste, con residual", &model, ADJUST_TIME + 2 * HOUR + 2,
+          ADJUST_TIME + 2 * HOUR);
+}
+
+// Deriva de +100 ppm: el residual medido en last_sync crecio desde el ajuste
+static void test_drift(void)
+{
+    time_correct_t model = {
+        .residual      = 80, // 10 s en 100000 s
+        .adjust_offset = HOUR * TIME_CORRECT_EIGHTHS_PER_SECOND,
+        .drift_ppm     = 100,
+        .last_sync     = ADJUST_TIME + 100000,
+        .last_adjust   = ADJUST_TIME,
+    };
+
+    // A mitad de camino el emisor iba 5 s adelantado
+    check("deriva, mitad del tramo", &model, ADJUST_TIME + 50000 + 5, ADJUST_TIME + 50000);
+    // 100000 s antes del ajuste iba 10 s menos que el offset corregido
+    check("deriva, antes del ajuste", &model, ADJUST_TIME - 100000 + HOUR - 10,
+          ADJUST_TIME - 100000);
+}
+
+static void test_unsynced(void)
+{
+    time_correct_t model = {0};
+
+    check("sin sincronizar", &model, ADJUST_TIME, ADJUST_TIME);
+    model.last_sync = ADJUST_TIME;
+    check("TIMESTAMP_INVALID", &model, TIMESTAMP_INVALID, TIMESTAMP_INVALID);
+}
+
+int main(void)
+{
+    test_adjust(HOUR);  // Emisor adelantado
+    test_adjust(-HOUR); // Emisor atrasado
+    test_adjust(3);
+    test_adjust(-3);
+    test_drift();
+    test_unsynced();
+
+    if (m_failures != 0)
+    {
+        printf("%d fallas\n", m_failures);
+        return 1;
+    }
+    printf("OK\n");
+    return 0;
+}
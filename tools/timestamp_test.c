@@ -0,0 +1,132 @@
+// Prueba de host para timestamp.c: compara cada dia de 2000 a 2099 contra
+// timegm/gmtime de la libc (ida y vuelta) y verifica que las fechas
+// invalidas se rechacen.
+//
+// Compilar y correr desde la raiz del repositorio:
+//   cc -I. -o timestamp_test tools/timestamp_test.c timestamp.c
+//   ./timestamp_test
+//
+// Devuelve 0 si todo coincide; si no, imprime cada diferencia y devuelve 1.
+
+#define _DEFAULT_SOURCE // timegm
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "timestamp.h"
+
+static int m_failures = 0;
+
+static void fail_datetime(const char *p_what, const datetime_t *p_dt)
+{
+    printf("FALLA %s: %04u-%02u-%02u %02u:%02u:%02u\n",
+           p_what,
+           p_dt->year,
+           p_dt->month,
+           p_dt->day,
+           p_dt->hour,
+           p_dt->minute,
+           p_dt->second);
+    m_failures++;
+}
+
+// Recorre todos los dias del rango con gmtime como referencia. La hora varia
+// con el dia para cubrir tambien la parte de segundos.
+static void test_round_trip(void)
+{
+    struct tm epoch_tm = {0};
+    struct tm last_tm  = {0};
+    time_t    epoch;
+    time_t    last;
+    uint32_t  days = 0;
+
+    epoch_tm.tm_year = TIMESTAMP_EPOCH_YEAR - 1900;
+    epoch_tm.tm_mday = 1;
+    epoch            = timegm(&epoch_tm);
+
+    last_tm.tm_year  = TIMESTAMP_MAX_YEAR - 1900;
+    last_tm.tm_mon   = 11;
+    last_tm.tm_mday  = 31;
+    last             = timegm(&last_tm);
+
+    for (time_t day = epoch; day <= last; day += 86400, days++)
+    {
+        time_t     t    = day + (days % 24) * 3600 + (days % 60) * 60 + (days * 7) % 60;
+        struct tm *p_tm = gmtime(&t);
+        datetime_t dt   = {
+              .year   = (uint16_t)(p_tm->tm_year + 1900),
+              .month  = (uint8_t)(p_tm->tm_mon + 1),
+              .day    = (uint8_t)p_tm->tm_mday,
+              .hour   = (uint8_t)p_tm->tm_hour,
+              .minute = (uint8_t)p_tm->tm_min,
+              .second = (uint8_t)p_tm->tm_sec,
+        };
+        datetime_t back;
+        uint32_t   ts = timestamp_from_datetime(&dt);
+
+        if (!timestamp_is_valid(&dt))
+            fail_datetime("fecha valida rechazada", &dt);
+        if (ts != (uint32_t)(t - epoch))
+            fail_datetime("timestamp_from_datetime", &dt);
+        if (timestamp_days_from_civil(dt.year, dt.month, dt.day) != days)
+            fail_datetime("timestamp_days_from_civil", &dt);
+
+        timestamp_to_datetime((uint32_t)(t - epoch), &back);
+        if (memcmp(&back, &dt, sizeof(dt)) != 0)
+            fail_datetime("timestamp_to_datetime", &dt);
+    }
+
+    printf("Ida y vuelta: %u dias\n", days);
+}
+
+static void test_invalid(void)
+{
+    static const datetime_t invalid[] = {
+        {1999, 12, 31, 23, 59, 59}, // Antes de la epoca
+        {2100, 1, 1, 0, 0, 0},      // Despues de TIMESTAMP_MAX_YEAR
+        {2001, 2, 29, 0, 0, 0},     // No bisiesto
+        {2100, 2, 29, 0, 0, 0},
+        {2024, 2, 30, 0, 0, 0},
+        {2023, 4, 31, 0, 0, 0},
+        {2023, 6, 31, 0, 0, 0},
+        {2023, 9, 31, 0, 0, 0},
+        {2023, 11, 31, 0, 0, 0},
+        {2023, 1, 32, 0, 0, 0},
+        {2023, 0, 1, 0, 0, 0},
+        {2023, 13, 1, 0, 0, 0},
+        {2023, 1, 0, 0, 0, 0},
+        {2023, 1, 1, 24, 0, 0},
+        {2023, 1, 1, 0, 60, 0},
+        {2023, 1, 1, 0, 0, 60},
+    };
+
+    for (size_t i = 0; i < sizeof(invalid) / sizeof(invalid[0]); i++)
+    {
+        if (timestamp_is_valid(&invalid[i]))
+            fail_datetime("fecha invalida aceptada", &invalid[i]);
+        if (timestamp_from_datetime(&invalid[i]) != TIMESTAMP_INVALID)
+            fail_datetime("timestamp_from_datetime sin TIMESTAMP_INVALID", &invalid[i]);
+    }
+    if (timestamp_from_datetime(NULL) != TIMESTAMP_INVALID)
+    {
+        printf("FALLA timestamp_from_datetime(NULL)\n");
+        m_failures++;
+    }
+
+    printf("Fechas invalidas: %zu\n", sizeof(invalid) / sizeof(invalid[0]));
+}
+
+int main(void)
+{
+    test_round_trip();
+    test_invalid();
+
+    if (m_failures != 0)
+    {
+        printf("%d fallas\n", m_failures);
+        return 1;
+    }
+    printf("OK\n");
+    return 0;
+}
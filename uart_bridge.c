@@ -0,0 +1,381 @@
+#include "uart_bridge.h"
+
+#include <string.h>
+
+#include "app_error.h"
+#include "app_timer.h"
+#include "app_util_platform.h"
+#include "boards.h"
+#include "energy.h"
+#include "nrf_drv_gpiote.h"
+#include "nrf_libuarte_async.h"
+#include "nrf_log.h"
+#include "variables.h"
+
+NRF_LIBUARTE_ASYNC_DEFINE(m_libuarte,
+                          0,
+                          1,
+                          NRF_LIBUARTE_PERIPHERAL_NOT_USED,
+                          2,
+                          UART_BRIDGE_RX_BUF_SIZE,
+                          UART_BRIDGE_RX_BUF_COUNT);
+
+APP_TIMER_DEF(m_idle_timer);
+
+static uart_bridge_rx_handler_t m_rx_handler    = NULL;
+static bool                     m_armed         = false; // Puerto habilitado (ventana activa)
+static bool                     m_active        = false; // UARTE abierto
+static bool                     m_timer_created = false;
+static bool                     m_in_preamble   = false; // Abierto por RX, sin datos aun
+static uint32_t                 m_last_activity = 0;     // Contador de app_timer
+
+// Anillo de transmision. Los m_tx_inflight bytes desde m_tx_tail los esta
+// leyendo el DMA y no se pueden tocar hasta TX_DONE.
+static uint8_t                  m_tx_ring[UART_BRIDGE_TX_RING_SIZE];
+static uint16_t                 m_tx_head     = 0;
+static uint16_t                 m_tx_tail     = 0;
+static uint16_t                 m_tx_used     = 0;
+static uint16_t                 m_tx_inflight = 0;
+static uint32_t                 m_tx_dropped  = 0;
+
+static void tx_ring_reset(void)
+{
+    m_tx_head     = 0;
+    m_tx_tail     = 0;
+    m_tx_used     = 0;
+    m_tx_inflight = 0;
+}
+
+// Inicia el DMA con el tramo contiguo siguiente del anillo
+static void tx_start(void)
+{
+    if (m_tx_inflight > 0 || m_tx_used == 0)
+    {
+        return;
+    }
+
+    uint16_t length = MIN(m_tx_used, UART_BRIDGE_TX_RING_SIZE - m_tx_tail);
+    if (nrf_libuarte_async_tx(&m_libuarte, &m_tx_ring[m_tx_tail], length) == NRF_SUCCESS)
+    {
+        m_tx_inflight = length;
+    }
+}
+
+static void tx_ring_write(uint8_t const *p_data, uint16_t length)
+{
+    for (uint16_t i = 0; i < length; i++)
+    {
+        m_tx_ring[m_tx_head] = p_data[i];
+        m_tx_head            = (m_tx_head + 1) % UART_BRIDGE_TX_RING_SIZE;
+    }
+    m_tx_used += length;
+}
+
+static void uart_bridge_evt_handler(void *p_context, nrf_libuarte_async_evt_t *p_evt)
+{
+    UNUSED_PARAMETER(p_context);
+
+    switch (p_evt->type)
+    {
+    case NRF_LIBUARTE_ASYNC_EVT_RX_DATA:
+    {
+        uint8_t const *p_data = p_evt->data.rxtx.p_data;
+        uint16_t       length = (uint16_t)p_evt->data.rxtx.length;
+
+        m_last_activity = app_timer_cnt_get();
+
+        // Resto del preambulo de despertar
+        while (m_in_preamble && length > 0 && *p_data == UART_BRIDGE_WAKE_PREAMBLE)
+        {
+            p_data++;
+            length--;
+        }
+        if (length > 0)
+        {
+            m_in_preamble = false;
+        }
+
+        if (m_rx_handler != NULL && length > 0)
+        {
+            m_rx_handler(p_data, length);
+        }
+        // El bloque ya se proceso: devolver el buffer al DMA
+        nrf_libuarte_async_rx_free(&m_libuarte,
+                                   p_evt->data.rxtx.p_data,
+                                   p_evt->data.rxtx.length);
+        break;
+    }
+
+    case NRF_LIBUARTE_ASYNC_EVT_TX_DONE:
+        m_tx_tail     = (m_tx_tail + m_tx_inflight) % UART_BRIDGE_TX_RING_SIZE;
+        m_tx_used    -= m_tx_inflight;
+        m_tx_inflight = 0;
+        tx_start();
+        break;
+
+    case NRF_LIBUARTE_ASYNC_EVT_ERROR:
+        // No hacer crash, solo loggear el error
+        NRF_LOG_ERROR("UART error: 0x%X", p_evt->data.errorsrc);
+        break;
+
+    case NRF_LIBUARTE_ASYNC_EVT_OVERRUN_ERROR:
+        NRF_LOG_ERROR("UART overrun: %u bytes perdidos",
+                      p_evt->data.overrun_err.overrun_length);
+        break;
+
+    default:
+        break;
+    }
+}
+
+static void rx_sense_handler(nrf_drv_gpiote_pin_t pin, nrf_gpiote_polarity_t action);
+
+// Deteccion de actividad en RX con el UARTE cerrado: evento PORT de GPIOTE
+// (SENSE del pin, sin HFCLK). El pull-up evita despertares con el pin al aire.
+static void rx_sense_arm(void)
+{
+    nrf_drv_gpiote_in_config_t config = GPIOTE_CONFIG_IN_SENSE_HITOLO(false);
+    ret_code_t                 err_code;
+
+    config.pull = NRF_GPIO_PIN_PULLUP;
+    err_code    = nrf_drv_gpiote_in_init(RX_PIN_NUMBER, &config, rx_sense_handler);
+    APP_ERROR_CHECK(err_code);
+    nrf_drv_gpiote_in_event_enable(RX_PIN_NUMBER, true);
+}
+
+static void rx_sense_disarm(void)
+{
+    nrf_drv_gpiote_in_event_disable(RX_PIN_NUMBER);
+    nrf_drv_gpiote_in_uninit(RX_PIN_NUMBER);
+}
+
+static ret_code_t uarte_open(void)
+{
+    ret_code_t err_code;
+
+    if (m_active)
+    {
+        return NRF_SUCCESS;
+    }
+
+    nrf_libuarte_async_config_t const config = {
+        .tx_pin     = TX_PIN_NUMBER,
+        .rx_pin     = RX_PIN_NUMBER,
+        .cts_pin    = CTS_PIN_NUMBER,
+        .rts_pin    = RTS_PIN_NUMBER,
+        .baudrate   = NRF_UARTE_BAUDRATE_115200,
+        .parity     = NRF_UARTE_PARITY_EXCLUDED,
+        .hwfc       = NRF_UARTE_HWFC_DISABLED,
+        .timeout_us = UART_BRIDGE_RX_TIMEOUT_US,
+        // Misma prioridad que los eventos BLE: el reenvio no necesita locks
+        .int_prio   = APP_IRQ_PRIORITY_LOW};
+
+    err_code = nrf_libuarte_async_init(&m_libuarte, &config, uart_bridge_evt_handler, NULL);
+    if (err_code != NRF_SUCCESS)
+    {
+        return err_code;
+    }
+
+    nrf_libuarte_async_enable(&m_libuarte);
+    m_active        = true;
+    m_last_activity = app_timer_cnt_get();
+    tx_ring_reset();
+    energy_uart_on();
+
+    err_code = app_timer_start(m_idle_timer, APP_TIMER_TICKS(UART_BRIDGE_IDLE_TIMEOUT_MS), NULL);
+    APP_ERROR_CHECK(err_code);
+
+    return NRF_SUCCESS;
+}
+
+static void uarte_close(void)
+{
+    if (!m_active)
+    {
+        return;
+    }
+
+    (void)app_timer_stop(m_idle_timer);
+    nrf_libuarte_async_uninit(&m_libuarte);
+    m_active      = false;
+    m_in_preamble = false;
+    energy_uart_off();
+
+    // Lo que no salio se pierde con el UARTE apagado
+    m_tx_dropped += m_tx_used;
+    tx_ring_reset();
+}
+
+// Flanco de bajada en RX (bit de inicio): se abre el UARTE. Lo que llega
+// mientras tanto se pierde (ver UART_BRIDGE_WAKE_PREAMBLE_LEN en el .h).
+static void rx_sense_handler(nrf_drv_gpiote_pin_t pin, nrf_gpiote_polarity_t action)
+{
+    UNUSED_PARAMETER(pin);
+    UNUSED_PARAMETER(action);
+
+    if (!m_armed || m_active)
+    {
+        return;
+    }
+    rx_sense_disarm();
+    if (uarte_open() != NRF_SUCCESS)
+    {
+        rx_sense_arm();
+        return;
+    }
+    m_in_preamble = true;
+}
+
+// El timer no se reinicia con cada bloque: al vencer se mira cuanto paso
+// desde la ultima actividad y, si hace falta, se reprograma por lo que falta
+static void idle_timer_handler(void *p_context)
+{
+    uint32_t   idle_ticks;
+    uint32_t   timeout_ticks = APP_TIMER_TICKS(UART_BRIDGE_IDLE_TIMEOUT_MS);
+    ret_code_t err_code;
+
+    UNUSED_PARAMETER(p_context);
+
+    if (!m_active)
+    {
+        return;
+    }
+
+    idle_ticks = app_timer_cnt_diff_compute(app_timer_cnt_get(), m_last_activity);
+    if (idle_ticks < timeout_ticks || m_tx_used > 0)
+    {
+        uint32_t remaining = (idle_ticks < timeout_ticks) ? timeout_ticks - idle_ticks
+                                                          : timeout_ticks;
+
+        err_code = app_timer_start(m_idle_timer, MAX(remaining, APP_TIMER_MIN_TIMEOUT_TICKS), NULL);
+        APP_ERROR_CHECK(err_code);
+        return;
+    }
+
+    uarte_close();
+    rx_sense_arm();
+}
+
+ret_code_t uart_bridge_init(uart_bridge_rx_handler_t rx_handler)
+{
+    ret_code_t err_code;
+
+    if (m_armed)
+    {
+        return NRF_SUCCESS;
+    }
+
+    if (!m_timer_created)
+    {
+        err_code = app_timer_create(&m_idle_timer, APP_TIMER_MODE_SINGLE_SHOT, idle_timer_handler);
+        if (err_code != NRF_SUCCESS)
+        {
+            return err_code;
+        }
+        m_timer_created = true;
+    }
+    if (!nrf_drv_gpiote_is_init())
+    {
+        err_code = nrf_drv_gpiote_init();
+        if (err_code != NRF_SUCCESS)
+        {
+            return err_code;
+        }
+    }
+
+    // El UARTE queda cerrado hasta que haya actividad en RX o algo que enviar
+    m_rx_handler = rx_handler;
+    m_armed      = true;
+    rx_sense_arm();
+
+    return NRF_SUCCESS;
+}
+
+void uart_bridge_uninit(void)
+{
+    if (!m_armed)
+    {
+        return;
+    }
+
+    if (m_active)
+    {
+        uarte_close();
+    }
+    else
+    {
+        rx_sense_disarm();
+    }
+    m_armed = false;
+}
+
+ret_code_t uart_bridge_send(uint8_t const *p_data, uint16_t length)
+{
+    ret_code_t err_code = NRF_SUCCESS;
+    uint16_t   free_space;
+
+    if (!m_armed)
+    {
+        return NRF_ERROR_INVALID_STATE;
+    }
+    if (length == 0)
+    {
+        return NRF_SUCCESS;
+    }
+    if (!m_active)
+    {
+        // Hay algo para enviar: se abre el puerto sin esperar actividad en RX
+        rx_sense_disarm();
+        err_code = uarte_open();
+        if (err_code != NRF_SUCCESS)
+        {
+            rx_sense_arm();
+            return err_code;
+        }
+    }
+    m_last_activity = app_timer_cnt_get();
+
+    free_space = UART_BRIDGE_TX_RING_SIZE - m_tx_used;
+    if (length > free_space)
+    {
+#if UART_BRIDGE_TX_DROP_POLICY == UART_BRIDGE_TX_DROP_OLD
+        // Liberar todo lo pendiente salvo el tramo que esta en el DMA
+        m_tx_dropped += m_tx_used - m_tx_inflight;
+        m_tx_head     = (m_tx_tail + m_tx_inflight) % UART_BRIDGE_TX_RING_SIZE;
+        m_tx_used     = m_tx_inflight;
+        free_space    = UART_BRIDGE_TX_RING_SIZE - m_tx_used;
+        if (length > free_space)
+        {
+            m_tx_dropped += length - free_space;
+            length        = free_space;
+        }
+#elif UART_BRIDGE_TX_DROP_POLICY == UART_BRIDGE_TX_DROP_TRUNCATE
+        m_tx_dropped += length - free_space;
+        length        = free_space;
+#else
+        m_tx_dropped += length;
+        length        = 0;
+#endif
+        err_code = NRF_ERROR_NO_MEM;
+    }
+
+    tx_ring_write(p_data, length);
+    tx_start();
+
+    return err_code;
+}
+
+uint32_t uart_bridge_tx_dropped_count(void)
+{
+    return m_tx_dropped;
+}
+
+bool uart_bridge_is_active(void)
+{
+    return m_active;
+}
+
+bool uart_bridge_is_enabled(void)
+{
+    return m_armed;
+}
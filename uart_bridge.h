@@ -0,0 +1,95 @@
+#ifndef UART_BRIDGE_H
+#define UART_BRIDGE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "sdk_errors.h"
+
+// Puente UART por DMA (libuarte sobre UARTE0).
+//
+// La recepcion usa buffers dobles: el UARTE escribe por DMA en uno mientras
+// el otro se procesa, y un TIMER cuenta los bytes por PPI. Cuando la linea
+// queda en silencio UART_BRIDGE_RX_TIMEOUT_US se entrega lo recibido como un
+// solo bloque, aunque no termine en '\n'. El timeout de linea lo mide otro
+// TIMER que cada byte reinicia por PPI: la CPU no despierta por cada byte ni
+// por un sondeo periodico, solo una vez por bloque. (Con app_timer libuarte
+// sondea el contador cada timeout mientras el puerto esta abierto.)
+//
+// La transmision no bloquea: los datos se copian a un anillo y el DMA lo
+// vacia en tramos contiguos, encadenando el siguiente en el evento TX_DONE.
+// Si el anillo no alcanza se aplica UART_BRIDGE_TX_DROP_POLICY y se cuentan
+// los bytes descartados.
+//
+// Con el puerto habilitado el UARTE queda cerrado (sin HFCLK) mientras no hay
+// actividad: el pin RX se vigila con un evento PORT de GPIOTE y el flanco del
+// primer bit de inicio abre el UARTE. Enviar tambien lo abre. Se cierra
+// despues de UART_BRIDGE_IDLE_TIMEOUT_MS sin recibir ni enviar, y el tiempo
+// abierto se suma en energy.h.
+//
+// Lo que llega mientras se abre se pierde. Del flanco a la recepcion
+// habilitada pasan: la interrupcion de GPIOTE (prioridad 6; hasta ~250 us si
+// la SoftDevice esta atendiendo la radio, y el escaneo corre toda la ventana
+// activa), nrf_libuarte_async_init y enable (UARTE, dos TIMER, canales PPI y
+// el primer buffer, ~100 us a 64 MHz) y el arranque del HFINT (unos us). Un
+// byte a 115200 baudios dura 87 us: se pierden hasta 4 bytes completos mas el
+// que estaba a medias. Por eso el equipo conectado, si la linea estuvo quieta
+// mas de UART_BRIDGE_IDLE_TIMEOUT_MS, debe anteponer al menos
+// UART_BRIDGE_WAKE_PREAMBLE_LEN (5 mas uno de margen) bytes
+// UART_BRIDGE_WAKE_PREAMBLE. Con 0xFF
+// el UARTE se sincroniza bien aunque abra en medio de un byte (solo el bit
+// de inicio esta en bajo), y los 0xFF que alcanzan a llegar al principio del
+// primer bloque se descartan (un 0xFF como primer dato tambien). Si no se
+// puede agregar el preambulo, sirve enviar un solo 0xFF y esperar 1 ms.
+//
+// Recursos: UARTE0, TIMER1 (conteo de bytes), TIMER2 (timeout de linea), un
+// canal PORT de GPIOTE y un app_timer para el timeout de inactividad. Los
+// TIMER corren con el HFCLK que el UARTE ya pide mientras esta abierto.
+
+#define UART_BRIDGE_RX_BUF_SIZE   64  // Bytes por buffer de recepcion
+#define UART_BRIDGE_RX_BUF_COUNT  3
+#define UART_BRIDGE_RX_TIMEOUT_US 300 // ~3 caracteres a 115200 baudios (TIMER2)
+#define UART_BRIDGE_TX_RING_SIZE  512
+
+#define UART_BRIDGE_WAKE_PREAMBLE     0xFF
+#define UART_BRIDGE_WAKE_PREAMBLE_LEN 6 // Bytes que se pueden perder al abrir
+
+#ifndef UART_BRIDGE_IDLE_TIMEOUT_MS
+#define UART_BRIDGE_IDLE_TIMEOUT_MS 2000 // Sin actividad antes de cerrar el UARTE
+#endif
+
+// Politicas ante anillo de transmision lleno
+#define UART_BRIDGE_TX_DROP_NEW      0 // Descartar el bloque nuevo completo
+#define UART_BRIDGE_TX_DROP_OLD      1 // Descartar lo pendiente que no salio aun
+#define UART_BRIDGE_TX_DROP_TRUNCATE 2 // Encolar lo que entre del bloque nuevo
+
+#ifndef UART_BRIDGE_TX_DROP_POLICY
+#define UART_BRIDGE_TX_DROP_POLICY   UART_BRIDGE_TX_DROP_NEW
+#endif
+
+typedef void (*uart_bridge_rx_handler_t)(uint8_t const *p_data, uint16_t length);
+
+/**@brief Habilita el puerto: vigila RX y abre el UARTE con la primera
+ *        actividad. Cada bloque recibido se entrega al handler en el contexto
+ *        de interrupcion del UARTE (misma prioridad que los eventos BLE, el
+ *        GPIOTE y app_timer).
+ */
+ret_code_t uart_bridge_init(uart_bridge_rx_handler_t rx_handler);
+
+/**@brief Cierra el UARTE si esta abierto y deja de vigilar RX (modo sleep). */
+void       uart_bridge_uninit(void);
+
+/**@brief Encola un bloque para transmitir por DMA y abre el UARTE si estaba
+ *        cerrado. No bloquea; llamar desde el contexto de eventos BLE o del
+ *        UARTE.
+ *
+ * @retval NRF_ERROR_NO_MEM Anillo lleno, se descarto todo o parte del bloque
+ *                          segun UART_BRIDGE_TX_DROP_POLICY.
+ */
+ret_code_t uart_bridge_send(uint8_t const *p_data, uint16_t length);
+
+bool       uart_bridge_is_active(void);  // UARTE abierto
+bool       uart_bridge_is_enabled(void); // Puerto habilitado, abierto o vigilando RX
+uint32_t   uart_bridge_tx_dropped_count(void);
+
+#endif // UART_BRIDGE_H
@@ -1,7 +1,6 @@
 #ifndef VARIABLES_H
 #define VARIABLES_H
 
-#define RTC_PRESCALER                         4095
 #define MAGIC_PASSWORD                        0xABCD /** MAGIC */
 #define APP_BLE_CONN_CFG_TAG                  1      /** NORDIC VARS */
 #define APP_BLE_OBSERVER_PRIO                 3
@@ -42,11 +41,38 @@
 #define HISTORY_RECORD_KEY                    0x1000 // Dirección inicial de los historiales
 #define HISTORY_BUFFER_SIZE                   500 // Cantidad de historiales
 #define HISTORY_RECORD_KEY_START              HISTORY_RECORD_KEY // Renombre para comodidad
+#define HISTORY_BATCH_SIZE                    8   // Registros en cola de escritura en lote
+#define HISTORY_BATCH_RETRIES                 2   // Reintentos ante un error de FDS
+
+// RECUPERACION DE HISTORIALES FALTANTES (catch-up)
+// Supuesto: el emisor responde "11" + ID (decimal) con la misma trama 0x08
+// que el comando "08", para el historial de esa posicion.
+#define EMISOR_CMD_HISTORY_BY_ID              "11"
+#define HISTORY_SYNC_MAX_PER_CYCLE            16  // Registros pedidos como maximo por ciclo
+#define HISTORY_SYNC_IN_FLIGHT                4   // Pedidos encolados a la vez
+#define HISTORY_SYNC_MAX_BACKLOG              248 // Sin historiales locales, no ir mas atras
 
 // ADV HISTORY (Extended Search Mode)
 #define ADV_HISTORY_FILE_ID                   0x000F // Dirección FILE_ID Historiales de ADV
 #define ADV_HISTORY_RECORD_KEY                0x2000 // Dirección inicial de los historiales ADV
 #define EXTENDED_SEARCH_DURATION_SECONDS      5      // Duración de búsqueda extendida antes de dormir
+#define EXTENDED_SEARCH_MS                    (EXTENDED_SEARCH_DURATION_SECONDS * 1000)
+#define EMISOR_ADV_COMPANY_ID                 0x2233 // Company ID del ADV del emisor
+#define EMISOR_ADV_MANUF_OFFSET               3      // Inicio del campo 0xFF (despues de flags)
+
+// COLA DE REENVIO (tramas del emisor sin celular conectado)
+#define RELAY_QUEUE_FILE_ID                   0x0010
+#define RELAY_QUEUE_RECORD_KEY                0x3000 // Dirección inicial de las entradas de la cola
+
+// CACHE GATT (handles NUS del emisor)
+#define GATT_CACHE_FILE_ID                    0x0011
+#define GATT_CACHE_RECORD_KEY                 0x0012
+
+// TABLA DE EMISORES (multi-emisor)
+#define EMISOR_TABLE_FILE_ID                  0x0012
+#define EMISOR_TABLE_RECORD_KEY               0x0013
+#define EMISOR_HISTORY_FILE_ID_BASE           0x0020 // FILE_ID de historiales de emisores secundarios
+#define EMISOR_CONNECT_TIMEOUT_MS             3000   // Busqueda de cada emisor antes de pasar al siguiente
 
 // HELPERS
 #define MSB_16(a)                             (((a) & 0xFF00) >> 8) // Parte de arriba de un uint32_t
@@ -62,23 +88,12 @@
 // Estructura para historiales de ADV
 typedef struct
 {
-    uint16_t year;
-    uint8_t  month;
-    uint8_t  day;
-    uint8_t  hour;
-    uint8_t  minute;
-    uint8_t  second;
+    uint32_t timestamp; // Segundos desde 2000 (timestamp.h)
     uint32_t contador;
     uint16_t V1;
     uint16_t V2;
 } store_adv_history;
 
-extern bool m_device_active;
-extern bool m_connected_this_cycle; // Nueva variable para controlar el modo de
-                                    // reconexión
-extern bool m_extended_mode_on;
-extern bool m_extended_search_active; // Indica si la búsqueda extendida está activa
-extern uint8_t m_extended_search_seconds_remaining; // Segundos restantes de búsqueda extendida
 extern bool m_emisor_adv_detected; // Indica si se detectó ADV del emisor
 
 #endif // VARIABLES_H